@@ -0,0 +1,471 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <cstdio>
+#include <cstdlib>
+#include "../core/util/spsc_ring.h"
+#include "../core/util/telemetry.h"
+#include "../core/encode/mjpeg.h"
+#include "../core/encode/color_convert.h"
+#include "../core/encode/delta_tiles.h"
+#include "../core/encode/image_scaler.h"
+#include "../core/encode/lossless_codec.h"
+#include "../core/io/muxer.h"
+#include "../core/capture/synthetic_source.h"
+#include "../core/capture/frame_fingerprint.h"
+
+// Microbenchmarks for the pipeline hot paths. Every result is one JSON object per line
+// (stdout or --out), so runs from different builds can be diffed or loaded into a script:
+//   {"bench":"mjpeg/1080p/q75","iterations":...,"seconds":...,"ns_per_op":...,
+//    "ops_per_s":...,"bytes_per_op":...,"bytes_per_s":...,"p50_ns":...,"p99_ns":...}
+
+struct BenchResult {
+    std::string name;
+    uint64_t iterations;
+    double seconds;
+    double bytesPerOp;        // output (or transferred) bytes per operation, 0 if not meaningful
+    HistogramSnapshot perOp;  // per-operation time in ns (count 0 when not sampled)
+};
+
+struct BenchOptions {
+    double minSeconds = 1.0;
+    std::string filter;
+    std::string tempDir = ".";
+    bool quick = false;
+};
+
+static std::ostream* resultStream = &std::cout;
+
+static void report(const BenchResult& r) {
+    double nsPerOp = r.iterations ? r.seconds * 1e9 / (double)r.iterations : 0.0;
+    double opsPerSec = r.seconds > 0 ? (double)r.iterations / r.seconds : 0.0;
+    char buf[512];
+    snprintf(buf, sizeof(buf),
+             "{\"bench\":\"%s\",\"iterations\":%llu,\"seconds\":%.4f,\"ns_per_op\":%.1f,\"ops_per_s\":%.1f,"
+             "\"bytes_per_op\":%.1f,\"bytes_per_s\":%.1f,\"p50_ns\":%llu,\"p90_ns\":%llu,\"p99_ns\":%llu,\"max_ns\":%llu}",
+             r.name.c_str(), (unsigned long long)r.iterations, r.seconds, nsPerOp, opsPerSec,
+             r.bytesPerOp, r.bytesPerOp * opsPerSec,
+             (unsigned long long)r.perOp.p50, (unsigned long long)r.perOp.p90,
+             (unsigned long long)r.perOp.p99, (unsigned long long)r.perOp.max);
+    *resultStream << buf << std::endl;
+    std::cerr << "  " << r.name << ": " << nsPerOp / 1000.0 << " us/op" << std::endl;
+}
+
+static bool selected(const BenchOptions& opt, const std::string& name) {
+    return opt.filter.empty() || name.find(opt.filter) != std::string::npos;
+}
+
+static uint64_t now_ns() {
+    using namespace std::chrono;
+    return (uint64_t)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Run op() (returning bytes produced) until minSeconds have passed, after a short warm-up
+template<typename Op>
+static BenchResult runTimed(const std::string& name, const BenchOptions& opt, Op op) {
+    for (int i = 0; i < 3; ++i) op();
+
+    LatencyHistogram perOp;
+    BenchResult r;
+    r.name = name;
+    r.iterations = 0;
+    uint64_t bytes = 0;
+    uint64_t begin = now_ns();
+    uint64_t deadline = begin + (uint64_t)(opt.minSeconds * 1e9);
+    uint64_t t = begin;
+    while (t < deadline || r.iterations < 5) {
+        bytes += op();
+        uint64_t after = now_ns();
+        perOp.record(after - t);
+        t = after;
+        r.iterations++;
+    }
+    r.seconds = (double)(t - begin) / 1e9;
+    r.bytesPerOp = (double)bytes / (double)r.iterations;
+    r.perOp = perOp.snapshot();
+    return r;
+}
+
+// ---- SPSC_Ring ----------------------------------------------------------------------
+
+template<typename Wait>
+static void benchRingThroughput(const std::string& name, const BenchOptions& opt) {
+    if (!selected(opt, name)) return;
+    const uint64_t items = opt.quick ? 1000000 : 20000000;
+    SPSC_Ring<uint64_t, Wait> ring(1024);
+
+    uint64_t begin = now_ns();
+    std::thread consumer([&ring, items]() {
+        uint64_t v = 0, expected = 0;
+        while (expected < items) {
+            if (ring.pop_wait(v, std::chrono::milliseconds(100))) {
+                if (v != expected) std::abort();
+                ++expected;
+            }
+        }
+    });
+    for (uint64_t i = 0; i < items; ++i) {
+        while (!ring.push_wait(i, std::chrono::milliseconds(100))) {}
+    }
+    consumer.join();
+
+    BenchResult r = BenchResult();
+    r.name = name;
+    r.iterations = items;
+    r.seconds = (double)(now_ns() - begin) / 1e9;
+    r.bytesPerOp = sizeof(uint64_t);
+    report(r);
+}
+
+// One-way hand-off latency: ping-pong between two rings, half the round trip per sample
+template<typename Wait>
+static void benchRingLatency(const std::string& name, const BenchOptions& opt) {
+    if (!selected(opt, name)) return;
+    const uint64_t rounds = opt.quick ? 20000 : 200000;
+    SPSC_Ring<uint64_t, Wait> ping(64), pong(64);
+
+    std::thread echo([&]() {
+        uint64_t v;
+        for (uint64_t i = 0; i < rounds; ++i) {
+            while (!ping.pop_wait(v, std::chrono::milliseconds(100))) {}
+            while (!pong.push_wait(v, std::chrono::milliseconds(100))) {}
+        }
+    });
+
+    LatencyHistogram oneWay;
+    uint64_t begin = now_ns();
+    for (uint64_t i = 0; i < rounds; ++i) {
+        uint64_t sent = now_ns(), back;
+        while (!ping.push_wait(sent, std::chrono::milliseconds(100))) {}
+        while (!pong.pop_wait(back, std::chrono::milliseconds(100))) {}
+        oneWay.record((now_ns() - sent) / 2);
+    }
+    echo.join();
+
+    BenchResult r = BenchResult();
+    r.name = name;
+    r.iterations = rounds;
+    r.seconds = (double)(now_ns() - begin) / 1e9;
+    r.perOp = oneWay.snapshot();
+    report(r);
+}
+
+// ---- frames ---------------------------------------------------------------------------
+
+// Exposes SyntheticSource's renderer so frames can be generated without a capture thread
+class BenchFrames : public SyntheticSource {
+public:
+    BenchFrames(int width, int height, SyntheticPattern pattern)
+        : SyntheticSource(width, height, 30, 1, pattern, 7) {
+        Initialize();
+    }
+    ~BenchFrames() { Stop(); }
+
+    std::vector<uint8_t> next() {
+        std::vector<uint8_t> frame(getFrameSize());
+        CaptureFrame(frame.data());
+        return frame;
+    }
+};
+
+struct Resolution {
+    const char* name;
+    int width;
+    int height;
+};
+
+static const Resolution resolutions[] = {
+    {"720p", 1280, 720},
+    {"1080p", 1920, 1080},
+    {"1440p", 2560, 1440},
+};
+
+// ---- MJPEGEncoder -----------------------------------------------------------------------
+
+static void benchMjpeg(const BenchOptions& opt) {
+    const int qualities[] = {50, 75, 90};
+    const int sliceCounts[] = {2, 4}; // slice-parallel encodes, at q75
+    for (const Resolution& res : resolutions) {
+        bool any = false;
+        for (int q : qualities) any = any || selected(opt, std::string("mjpeg/") + res.name + "/q" + std::to_string(q));
+        for (int s : sliceCounts) any = any || selected(opt, std::string("mjpeg/") + res.name + "/q75/slices" + std::to_string(s));
+        if (!any) continue;
+
+        // a few frames of game-like content so the timings are not one lucky image
+        BenchFrames frames(res.width, res.height, SyntheticPattern::GameMotion);
+        std::vector<std::vector<uint8_t>> input;
+        for (int i = 0; i < 4; ++i) input.push_back(frames.next());
+
+        for (int q : qualities) {
+            std::string name = std::string("mjpeg/") + res.name + "/q" + std::to_string(q);
+            if (!selected(opt, name)) continue;
+            MJPEGEncoder encoder(res.width, res.height);
+            encoder.setQuality(q);
+            PacketBuffer out;
+            size_t i = 0;
+            report(runTimed(name, opt, [&]() {
+                return (uint64_t)encoder.encodeFrame(input[i++ % input.size()].data(), out);
+            }));
+        }
+
+        for (int s : sliceCounts) {
+            std::string name = std::string("mjpeg/") + res.name + "/q75/slices" + std::to_string(s);
+            if (!selected(opt, name)) continue;
+            MJPEGEncoder encoder(res.width, res.height);
+            encoder.setQuality(75);
+            encoder.setSlices(s);
+            PacketBuffer out;
+            size_t i = 0;
+            report(runTimed(name, opt, [&]() {
+                return (uint64_t)encoder.encodeFrame(input[i++ % input.size()].data(), out);
+            }));
+        }
+    }
+}
+
+// ---- colour conversion ------------------------------------------------------------------
+
+static void benchColorConvert(const BenchOptions& opt) {
+    const SimdLevel levels[] = {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2};
+    for (const Resolution& res : resolutions) {
+        std::vector<uint8_t> frame;
+        for (SimdLevel level : levels) {
+            if ((int)level > (int)detectSimdLevel()) continue;
+            std::string name = std::string("yuv420/") + res.name + "/" + simdLevelName(level);
+            if (!selected(opt, name)) continue;
+            if (frame.empty()) frame = BenchFrames(res.width, res.height, SyntheticPattern::GameMotion).next();
+
+            YUV420Planes planes;
+            planes.allocate(res.width, res.height);
+            report(runTimed(name, opt, [&]() {
+                convertBGRAToYUV420(frame.data(), res.width * 4, planes, level);
+                return (uint64_t)frame.size();
+            }));
+        }
+    }
+}
+
+// ---- frame fingerprint -------------------------------------------------------------------
+
+static void benchFingerprint(const BenchOptions& opt) {
+    const SimdLevel levels[] = {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2};
+    for (const Resolution& res : resolutions) {
+        std::vector<uint8_t> frame;
+        for (SimdLevel level : levels) {
+            if ((int)level > (int)detectSimdLevel()) continue;
+            std::string name = std::string("fingerprint/") + res.name + "/" + simdLevelName(level);
+            if (!selected(opt, name)) continue;
+            if (frame.empty()) frame = BenchFrames(res.width, res.height, SyntheticPattern::GameMotion).next();
+
+            report(runTimed(name, opt, [&]() {
+                frameFingerprint(frame.data(), frame.size(), level);
+                return (uint64_t)frame.size();
+            }));
+        }
+    }
+}
+
+// ---- lossless codec ---------------------------------------------------------------------
+
+static void benchLossless(const BenchOptions& opt) {
+    const SimdLevel levels[] = {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2};
+    for (const Resolution& res : resolutions) {
+        std::vector<uint8_t> frame;
+        PacketBuffer out;
+        for (SimdLevel level : levels) {
+            if ((int)level > (int)detectSimdLevel()) continue;
+            std::string name = std::string("lossless/") + res.name + "/" + simdLevelName(level);
+            if (!selected(opt, name)) continue;
+            if (frame.empty()) frame = BenchFrames(res.width, res.height, SyntheticPattern::GameMotion).next();
+
+            LosslessEncoder encoder(res.width, res.height, level);
+            report(runTimed(name, opt, [&]() {
+                return (uint64_t)encoder.encodeFrame(frame.data(), out);
+            }));
+        }
+        std::string name = std::string("lossless/") + res.name + "/decode";
+        if (!selected(opt, name)) continue;
+        if (frame.empty()) frame = BenchFrames(res.width, res.height, SyntheticPattern::GameMotion).next();
+        LosslessEncoder encoder(res.width, res.height);
+        size_t length = encoder.encodeFrame(frame.data(), out);
+        LosslessDecoder decoder;
+        report(runTimed(name, opt, [&]() {
+            decoder.decodeFrame(out.data(), length);
+            return (uint64_t)frame.size();
+        }));
+    }
+}
+
+// ---- image scaler -----------------------------------------------------------------------
+
+static void benchScaler(const BenchOptions& opt) {
+    struct Case { const char* name; int sw, sh, dw, dh; };
+    const Case cases[] = {
+        {"2160pto1080p", 3840, 2160, 1920, 1080},
+        {"2160pto720p", 3840, 2160, 1280, 720},
+        {"1440pto720p", 2560, 1440, 1280, 720},
+        {"1080pto720p", 1920, 1080, 1280, 720},
+    };
+    struct Filter { const char* name; ScaleFilter filter; };
+    const Filter filters[] = {{"area", ScaleFilter::Area}, {"bilinear", ScaleFilter::Bilinear}, {"box", ScaleFilter::Box}};
+    const SimdLevel levels[] = {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2};
+    for (const Case& c : cases) {
+        std::vector<uint8_t> frame;
+        std::vector<uint8_t> out((size_t)c.dw * c.dh * 4);
+        for (const Filter& f : filters) {
+            for (SimdLevel level : levels) {
+                if ((int)level > (int)detectSimdLevel()) continue;
+                std::string name = std::string("scale/") + c.name + "/" + f.name + "/" + simdLevelName(level);
+                if (!selected(opt, name)) continue;
+                if (frame.empty()) frame = BenchFrames(c.sw, c.sh, SyntheticPattern::GameMotion).next();
+
+                ImageScaler scaler;
+                scaler.configure(c.sw, c.sh, c.dw, c.dh, f.filter, level);
+                report(runTimed(name, opt, [&]() {
+                    scaler.scale(frame.data(), c.sw * 4, out.data(), c.dw * 4);
+                    return (uint64_t)out.size();
+                }));
+            }
+        }
+    }
+}
+
+// ---- Muxers ---------------------------------------------------------------------------
+
+static void benchMuxers(const BenchOptions& opt) {
+    struct Format { const char* name; ContainerFormat format; };
+    const Format formats[] = {{"avimux", ContainerFormat::Avi}, {"mkvmux", ContainerFormat::Matroska}};
+    const size_t chunkSizes[] = {4 * 1024, 64 * 1024, 256 * 1024};
+    for (const Format& f : formats) {
+        for (size_t chunk : chunkSizes) {
+            std::string name = std::string(f.name) + "/write/" + std::to_string(chunk / 1024) + "k";
+            if (!selected(opt, name)) continue;
+
+            std::string path = opt.tempDir + "/recorder_bench." + containerExtension(f.format);
+            std::vector<uint8_t> payload(chunk);
+            for (size_t i = 0; i < chunk; ++i) payload[i] = (uint8_t)(i * 31 + 7);
+
+            std::unique_ptr<Muxer> mux(createMuxer(f.format, path));
+            mux->setVideoParameters(1920, 1080, 60, "MJPG");
+            if (!mux->open()) {
+                std::cerr << "cannot open " << path << std::endl;
+                return;
+            }
+            report(runTimed(name, opt, [&]() {
+                mux->writeVideoFrame(payload.data(), payload.size());
+                return (uint64_t)payload.size();
+            }));
+
+            // AVI writes its indexes for everything above here; Matroska only flushes
+            uint64_t begin = now_ns();
+            mux->close();
+            BenchResult r = BenchResult();
+            r.name = name + "/close";
+            r.iterations = 1;
+            r.seconds = (double)(now_ns() - begin) / 1e9;
+            report(r);
+            std::remove(path.c_str());
+        }
+    }
+}
+
+// ---- DeltaTilesEncoder ----------------------------------------------------------------
+
+static void benchDeltaTiles(const BenchOptions& opt) {
+    struct Case { const char* name; SyntheticPattern pattern; };
+    const Case cases[] = {
+        {"static", SyntheticPattern::Static},
+        {"game", SyntheticPattern::GameMotion},
+        {"scroll", SyntheticPattern::Scroll},
+    };
+    struct Mode { const char* name; DeltaTileMode mode; };
+    const Mode modes[] = {
+        {"jpeg", DeltaTileMode::Jpeg},
+        {"raw", DeltaTileMode::Raw},
+    };
+    for (const Resolution& res : resolutions) {
+        for (const Case& c : cases) {
+            for (const Mode& m : modes) {
+                std::string name = std::string("delta_tiles/") + res.name + "/" + c.name + "/" + m.name;
+                if (!selected(opt, name)) continue;
+
+                BenchFrames frames(res.width, res.height, c.pattern);
+                std::vector<std::vector<uint8_t>> seq;
+                for (int i = 0; i < 5; ++i) seq.push_back(frames.next());
+
+                DeltaTilesEncoder encoder(res.width, res.height);
+                encoder.setTileMode(m.mode);
+                size_t i = 0;
+                report(runTimed(name, opt, [&]() {
+                    const std::vector<uint8_t>& prev = seq[i % (seq.size() - 1)];
+                    const std::vector<uint8_t>& cur = seq[i % (seq.size() - 1) + 1];
+                    ++i;
+                    encoder.encodeFrame(cur.data(), prev.data());
+                    return (uint64_t)encoder.getEncodedData().size();
+                }));
+            }
+        }
+    }
+}
+
+static void printUsage() {
+    std::cout << "Usage: recorder_bench [options]\n"
+              << "  --filter <text>     only run benchmarks whose name contains text\n"
+              << "                      (ring/, yuv420/, fingerprint/, scale/, mjpeg/,\n"
+              << "                      lossless/, avimux/, mkvmux/, delta_tiles/)\n"
+              << "  --min-time <s>      minimum time per benchmark (default 1)\n"
+              << "  --quick             short runs, for smoke testing\n"
+              << "  --tmp <dir>         directory for the muxer output file (default .)\n"
+              << "  --out <file>        write JSON lines to file instead of stdout\n";
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions opt;
+    std::string outFile;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc) {
+            opt.filter = argv[++i];
+        } else if (arg == "--min-time" && i + 1 < argc) {
+            opt.minSeconds = std::atof(argv[++i]);
+        } else if (arg == "--quick") {
+            opt.quick = true;
+            opt.minSeconds = 0.1;
+        } else if (arg == "--tmp" && i + 1 < argc) {
+            opt.tempDir = argv[++i];
+        } else if (arg == "--out" && i + 1 < argc) {
+            outFile = argv[++i];
+        } else {
+            printUsage();
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    std::ofstream out;
+    if (!outFile.empty()) {
+        out.open(outFile);
+        if (!out) {
+            std::cerr << "cannot write " << outFile << std::endl;
+            return 1;
+        }
+        resultStream = &out;
+    }
+
+    benchRingThroughput<BlockingWait>("ring/throughput/blocking", opt);
+    benchRingThroughput<SpinYieldWait>("ring/throughput/spin", opt);
+    benchRingLatency<BlockingWait>("ring/latency/blocking", opt);
+    benchRingLatency<SpinYieldWait>("ring/latency/spin", opt);
+    benchColorConvert(opt);
+    benchFingerprint(opt);
+    benchScaler(opt);
+    benchMjpeg(opt);
+    benchLossless(opt);
+    benchMuxers(opt);
+    benchDeltaTiles(opt);
+    return 0;
+}
@@ -0,0 +1,285 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <sys/stat.h>
+#include "../core/core.h"
+#include "../core/capture/synthetic_source.h"
+#include "../core/capture/raw_replay_source.h"
+
+// Headless driver: runs the Core pipeline from a synthetic or raw-replay frame source
+// so capture -> encode -> mux throughput can be measured without a desktop.
+
+static void printUsage() {
+    std::cout << "Usage: recorder_headless [options]\n"
+              << "  --source synthetic:<scroll|noise|static|game>   generated frames (default synthetic:game)\n"
+              << "  --source raw:<file>                            replay raw BGRA frames\n"
+              << "  --res 720p|1080p|1440p|2160p|<W>x<H>           captured frame size (default 720p)\n"
+              << "  --scale 720p|1080p|1440p|2160p|<W>x<H>         record at this size, resampling the frames\n"
+              << "  --scale-filter area|bilinear|box               resampling filter (default area)\n"
+              << "  --fps <n>                                      capture rate (default 30)\n"
+              << "  --codec mjpeg|lossless                         video codec (default mjpeg; lossless: see recorder_transcode)\n"
+              << "  --bitrate <mbps>                               MJPEG rate control target in Mbit/s (default: fixed quality)\n"
+              << "  --quality-range <min>:<max>                    quality bounds for rate control (default 20:95)\n"
+              << "  --avi1                                         abbreviated MJPEG frames without Huffman tables\n"
+              << "  --container avi|mkv                            output format (default avi; mkv: fragmented Matroska)\n"
+              << "  --writer thread|direct|mmap|stdio              disk writer backend (default thread)\n"
+              << "  --write-buffers <n>                            buffers in flight for thread/direct (default 3)\n"
+              << "  --checkpoint-ms <n>                            header checkpoint interval (default 2000, 0: off)\n"
+              << "  --segment-mb <n>                               AVI RIFF segment size (default 1024)\n"
+              << "  --encoders <n>                                 MJPEG encoder threads (default: half the cores)\n"
+              << "  --slices <n>                                   stripes per frame encoded in parallel (default 1)\n"
+              << "  --frame-budget-mb <n>                          memory for captured frames (default 64)\n"
+              << "  --overflow drop-newest|drop-oldest|block       capture behaviour when all frame slots are busy\n"
+              << "  --no-degrade                                   keep fps, capture size and encoders fixed\n"
+              << "  --encode-repeats                               encode unchanged frames instead of repeating\n"
+              << "  --seconds <n>                                  run time (default 10)\n"
+              << "  --no-loop                                      stop a raw replay at end of file\n"
+              << "  --seed <n>                                     synthetic generator seed\n"
+              << "  --out <file>                                   output file (default headless.avi / .mkv)\n"
+              << "  --stats-json <file>                            append pipeline stats as JSON lines\n"
+              << "  --stats-interval <ms>                          stats line interval (default 1000)\n"
+              << "  --print-stats                                  print final pipeline stats JSON\n";
+}
+
+static bool parseResolution(const std::string& res, int& width, int& height) {
+    if (res == "720p") { width = 1280; height = 720; return true; }
+    if (res == "1080p") { width = 1920; height = 1080; return true; }
+    if (res == "1440p") { width = 2560; height = 1440; return true; }
+    if (res == "2160p") { width = 3840; height = 2160; return true; }
+    size_t x = res.find('x');
+    if (x == std::string::npos) return false;
+    try {
+        width = std::stoi(res.substr(0, x));
+        height = std::stoi(res.substr(x + 1));
+    } catch (...) {
+        return false;
+    }
+    return width > 0 && height > 0;
+}
+
+int main(int argc, char* argv[]) {
+    std::string source = "synthetic:game";
+    std::string outFile;
+    int width = 1280;
+    int height = 720;
+    int scaleWidth = 0;
+    int scaleHeight = 0;
+    ScaleFilter scaleFilter = ScaleFilter::Area;
+    VideoCodec codec = VideoCodec::Mjpeg;
+    RateControlOptions rateControl;
+    int fps = 30;
+    int seconds = 10;
+    int encoders = 0;
+    int slices = 1;
+    size_t frameBudgetMb = 64;
+    OverflowPolicy overflow = OverflowPolicy::DropOldest;
+    bool loop = true;
+    uint32_t seed = 1;
+    std::string statsFile;
+    uint32_t statsIntervalMs = 1000;
+    bool printStats = false;
+    bool degrade = true;
+    bool skipRepeats = true;
+    bool avi1 = false;
+    ContainerFormat container = ContainerFormat::Avi;
+    WriterBackend writer = WriterBackend::Threaded;
+    int writeBuffers = 3;
+    uint32_t checkpointMs = 2000;
+    uint64_t segmentMb = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--source" && i + 1 < argc) {
+            source = argv[++i];
+        } else if (arg == "--res" && i + 1 < argc) {
+            if (!parseResolution(argv[++i], width, height)) {
+                std::cerr << "Invalid resolution " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--scale" && i + 1 < argc) {
+            if (!parseResolution(argv[++i], scaleWidth, scaleHeight)) {
+                std::cerr << "Invalid resolution " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--scale-filter" && i + 1 < argc) {
+            std::string filter = argv[++i];
+            if (filter == "area") scaleFilter = ScaleFilter::Area;
+            else if (filter == "bilinear") scaleFilter = ScaleFilter::Bilinear;
+            else if (filter == "box") scaleFilter = ScaleFilter::Box;
+            else {
+                std::cerr << "Unknown scale filter " << filter << std::endl;
+                return 1;
+            }
+        } else if (arg == "--fps" && i + 1 < argc) {
+            fps = std::stoi(argv[++i]);
+        } else if (arg == "--codec" && i + 1 < argc) {
+            std::string name = argv[++i];
+            if (name == "mjpeg") codec = VideoCodec::Mjpeg;
+            else if (name == "lossless") codec = VideoCodec::Lossless;
+            else {
+                std::cerr << "Unknown codec " << name << std::endl;
+                return 1;
+            }
+        } else if (arg == "--bitrate" && i + 1 < argc) {
+            rateControl.targetBytesPerSec = (uint64_t)(std::stod(argv[++i]) * 1e6 / 8.0);
+        } else if (arg == "--quality-range" && i + 1 < argc) {
+            std::string range = argv[++i];
+            size_t colon = range.find(':');
+            if (colon == std::string::npos) {
+                std::cerr << "Quality range must be <min>:<max>" << std::endl;
+                return 1;
+            }
+            rateControl.minQuality = std::stoi(range.substr(0, colon));
+            rateControl.maxQuality = std::stoi(range.substr(colon + 1));
+        } else if (arg == "--container" && i + 1 < argc) {
+            std::string name = argv[++i];
+            if (name == "avi") container = ContainerFormat::Avi;
+            else if (name == "mkv") container = ContainerFormat::Matroska;
+            else {
+                std::cerr << "Unknown container " << name << std::endl;
+                return 1;
+            }
+        } else if (arg == "--writer" && i + 1 < argc) {
+            std::string name = argv[++i];
+            if (name == "thread") writer = WriterBackend::Threaded;
+            else if (name == "direct") writer = WriterBackend::Direct;
+            else if (name == "mmap") writer = WriterBackend::Mmap;
+            else if (name == "stdio") writer = WriterBackend::Stdio;
+            else {
+                std::cerr << "Unknown writer backend " << name << std::endl;
+                return 1;
+            }
+        } else if (arg == "--write-buffers" && i + 1 < argc) {
+            writeBuffers = std::stoi(argv[++i]);
+        } else if (arg == "--checkpoint-ms" && i + 1 < argc) {
+            checkpointMs = (uint32_t)std::stoul(argv[++i]);
+        } else if (arg == "--segment-mb" && i + 1 < argc) {
+            segmentMb = std::stoull(argv[++i]);
+        } else if (arg == "--encoders" && i + 1 < argc) {
+            encoders = std::stoi(argv[++i]);
+        } else if (arg == "--slices" && i + 1 < argc) {
+            slices = std::stoi(argv[++i]);
+        } else if (arg == "--frame-budget-mb" && i + 1 < argc) {
+            frameBudgetMb = (size_t)std::stoul(argv[++i]);
+        } else if (arg == "--overflow" && i + 1 < argc) {
+            std::string policy = argv[++i];
+            if (policy == "drop-newest") overflow = OverflowPolicy::DropNewest;
+            else if (policy == "drop-oldest") overflow = OverflowPolicy::DropOldest;
+            else if (policy == "block") overflow = OverflowPolicy::Block;
+            else {
+                std::cerr << "Unknown overflow policy " << policy << std::endl;
+                return 1;
+            }
+        } else if (arg == "--seconds" && i + 1 < argc) {
+            seconds = std::stoi(argv[++i]);
+        } else if (arg == "--no-loop") {
+            loop = false;
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = (uint32_t)std::stoul(argv[++i]);
+        } else if (arg == "--out" && i + 1 < argc) {
+            outFile = argv[++i];
+        } else if (arg == "--stats-json" && i + 1 < argc) {
+            statsFile = argv[++i];
+        } else if (arg == "--stats-interval" && i + 1 < argc) {
+            statsIntervalMs = (uint32_t)std::stoul(argv[++i]);
+        } else if (arg == "--print-stats") {
+            printStats = true;
+        } else if (arg == "--no-degrade") {
+            degrade = false;
+        } else if (arg == "--avi1") {
+            avi1 = true;
+        } else if (arg == "--encode-repeats") {
+            skipRepeats = false;
+        } else {
+            printUsage();
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    if (outFile.empty()) outFile = std::string("headless.") + containerExtension(container);
+
+    FrameSource* frameSource = nullptr;
+    RawReplaySource* replay = nullptr;
+    if (source.compare(0, 10, "synthetic:") == 0) {
+        SyntheticPattern pattern;
+        if (!parseSyntheticPattern(source.substr(10), pattern)) {
+            std::cerr << "Unknown synthetic pattern " << source.substr(10) << std::endl;
+            return 1;
+        }
+        frameSource = new SyntheticSource(width, height, fps, 4, pattern, seed);
+    } else if (source.compare(0, 4, "raw:") == 0) {
+        replay = new RawReplaySource(source.substr(4), width, height, fps, 4, loop);
+        frameSource = replay;
+    } else {
+        printUsage();
+        return 1;
+    }
+
+    Core core;
+    core.setEncoderThreads(encoders);
+    core.setEncoderSlices(slices);
+    core.setSkipRepeatedFrames(skipRepeats);
+    core.setScaleFilter(scaleFilter);
+    core.setVideoCodec(codec);
+    core.setAbbreviatedJpeg(avi1);
+    core.setRateControl(rateControl);
+    core.setContainerFormat(container);
+    core.setDiskWriter(writer, writeBuffers);
+    core.setCheckpointInterval(checkpointMs);
+    core.setSegmentSize(segmentMb * 1024 * 1024);
+    core.setFrameMemoryBudget(frameBudgetMb * 1024 * 1024);
+    core.setOverflowPolicy(overflow);
+    if (!statsFile.empty()) core.setStatsDump(statsFile, statsIntervalMs);
+    if (!degrade) {
+        int threads = encoders > 0 ? encoders : EncoderPool::defaultThreadCount();
+        core.setDegradationLadder(std::vector<DegradationStep>(1, DegradationStep{fps, 1, threads}));
+    }
+    if (!core.initialize(scaleWidth, scaleHeight, fps, frameSource)) {
+        std::cerr << "Failed to initialize core." << std::endl;
+        return 1;
+    }
+
+    if (!core.start(outFile)) {
+        std::cerr << "Failed to start capture pipeline." << std::endl;
+        return 1;
+    }
+
+    std::cout << "Recording " << width << "x" << height;
+    if (scaleWidth > 0) std::cout << " scaled to " << scaleWidth << "x" << scaleHeight;
+    std::cout << "@" << fps << " from " << source
+              << " for " << seconds << "s..." << std::endl;
+    auto begin = std::chrono::steady_clock::now();
+    auto deadline = begin + std::chrono::seconds(seconds);
+    while (std::chrono::steady_clock::now() < deadline && !(replay && replay->isFinished()) &&
+           !core.hasFailed()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    // counters must be read before stop() releases the source
+    uint64_t captured = frameSource->getCapturedFrames();
+    uint64_t dropped = frameSource->getDroppedFrames();
+    PipelineStats stats = core.getStats();
+    bool writeFailed = core.hasFailed();
+    core.stop();
+
+    // only a regular file has a size; opening a FIFO here would wait for a writer forever
+    struct stat outStat;
+    bool regularFile = stat(outFile.c_str(), &outStat) == 0 && (outStat.st_mode & S_IFMT) == S_IFREG;
+
+    std::cout << "Elapsed " << elapsed << "s, captured " << captured << " frames ("
+              << (elapsed > 0 ? captured / elapsed : 0.0) << " fps), dropped " << dropped;
+    if (regularFile) std::cout << ", output " << (long long)outStat.st_size << " bytes";
+    std::cout << std::endl;
+    if (stats.targetBytesPerSec > 0) {
+        std::cout << "Video bitrate " << stats.achievedBytesPerSec * 8.0 / 1e6 << " Mbit/s (target "
+                  << (double)stats.targetBytesPerSec * 8.0 / 1e6 << "), quality now " << stats.videoQuality << std::endl;
+    }
+    if (stats.diskStalls > 0) {
+        std::cout << "Disk writer stalled " << stats.diskStalls << " times, "
+                  << stats.diskStallUs / 1000 << " ms in total" << std::endl;
+    }
+    if (printStats) std::cout << statsToJson(stats) << std::endl;
+    return writeFailed ? 1 : 0;
+}
@@ -33,6 +33,7 @@ int main(int argc, char* argv[]) {
     std::string serverUrl = "http://127.0.0.1:8000";
     bool noAuth = false;
     int autoRecordSeconds = 0;
+    int encoderThreads = 0;
 
     // Parse CLI
     for (int i = 1; i < argc; ++i) {
@@ -52,6 +53,8 @@ int main(int argc, char* argv[]) {
             serverUrl = argv[++i];
         } else if (arg == "--no-auth") {
             noAuth = true;
+        } else if (arg == "--encoders" && i + 1 < argc) {
+            try { encoderThreads = std::stoi(argv[++i]); } catch(...) { encoderThreads = 0; }
         } else if (arg == "--auto-record" && i + 1 < argc) {
             try { autoRecordSeconds = std::stoi(argv[++i]); } catch(...) { autoRecordSeconds = 0; }
         }
@@ -117,6 +120,7 @@ AUTH_DONE:
 
     // Initialize core and start capture pipeline
     Core core;
+    core.setEncoderThreads(encoderThreads);
     if (!core.initialize(width, height, fps)) {
         std::cerr << "Failed to initialize core." << std::endl;
         return 1;
@@ -0,0 +1,142 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <chrono>
+#include <cstring>
+#include "../core/io/avi_reader.h"
+#include "../core/io/avi_mux.h"
+#include "../core/encode/lossless_codec.h"
+#include "../core/encode/mjpeg.h"
+
+// Offline converter for recordings made with the lossless codec (--codec lossless): decodes
+// the LRLS frames and writes an MJPEG AVI players understand. Audio chunks and repeat
+// (empty) chunks are copied as they are; MJPEG input is copied unchanged (or only
+// abbreviated, with --avi1).
+
+static void printUsage() {
+    std::cout << "Usage: recorder_transcode <in.avi> <out.avi> [options]\n"
+              << "  --quality <q>       JPEG quality (default 90)\n"
+              << "  --slices <n>        stripes per frame encoded in parallel (default 1)\n"
+              << "  --avi1              write abbreviated MJPEG frames without Huffman tables\n";
+}
+
+int main(int argc, char* argv[]) {
+    std::string inFile;
+    std::string outFile;
+    int quality = 90;
+    int slices = 1;
+    bool avi1 = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--quality" && i + 1 < argc) {
+            quality = std::stoi(argv[++i]);
+        } else if (arg == "--slices" && i + 1 < argc) {
+            slices = std::stoi(argv[++i]);
+        } else if (arg == "--avi1") {
+            avi1 = true;
+        } else if (arg[0] != '-' && inFile.empty()) {
+            inFile = arg;
+        } else if (arg[0] != '-' && outFile.empty()) {
+            outFile = arg;
+        } else {
+            printUsage();
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+    if (inFile.empty() || outFile.empty()) {
+        printUsage();
+        return 1;
+    }
+
+    AVIReader reader(inFile);
+    if (!reader.open()) {
+        std::cerr << "Cannot read " << inFile << " as AVI" << std::endl;
+        return 1;
+    }
+    const AVIStreamInfo& info = reader.getInfo();
+    bool lossless = strcmp(info.videoFourCC, "LRLS") == 0;
+    if (!lossless && strcmp(info.videoFourCC, "MJPG") != 0) {
+        std::cerr << "Unsupported video codec '" << info.videoFourCC << "'" << std::endl;
+        return 1;
+    }
+    const uint32_t videoId = AVIReader::fourcc("00dc");
+    const uint32_t audioId = AVIReader::fourcc("01wb");
+    uint32_t fps = info.fpsDen ? (info.fpsNum + info.fpsDen / 2) / info.fpsDen : 30;
+
+    // The output is opened at the first video frame, whose size is authoritative for
+    // LRLS input; audio before it waits
+    AVIMux mux(outFile);
+    bool opened = false;
+    std::deque<std::vector<uint8_t>> pendingAudio;
+    LosslessDecoder decoder;
+    std::unique_ptr<MJPEGEncoder> encoder;
+    PacketBuffer jpeg;
+    uint64_t frames = 0, repeats = 0, audioChunks = 0, bytesIn = 0, bytesOut = 0;
+    auto begin = std::chrono::steady_clock::now();
+
+    uint32_t id;
+    std::vector<uint8_t> chunk;
+    while (reader.readChunk(id, chunk)) {
+        if (id == audioId) {
+            ++audioChunks;
+            if (!opened) pendingAudio.push_back(chunk);
+            else mux.writeAudioSamples(chunk.data(), chunk.size());
+            continue;
+        }
+        if (id != videoId) continue;
+        bytesIn += chunk.size();
+
+        const uint8_t* out = chunk.data();
+        size_t outSize = chunk.size();
+        if (chunk.empty()) {
+            ++repeats;
+        } else if (lossless) {
+            if (!decoder.decodeFrame(chunk.data(), chunk.size())) {
+                std::cerr << "Corrupt frame " << frames << ", stopping" << std::endl;
+                break;
+            }
+            if (!encoder) {
+                encoder.reset(new MJPEGEncoder(decoder.getWidth(), decoder.getHeight()));
+                encoder->setQuality(quality);
+                encoder->setSlices(slices);
+                encoder->setAbbreviated(avi1);
+            }
+            outSize = encoder->encodeFrame(decoder.getFrame().data(), jpeg);
+            out = jpeg.data();
+        } else if (avi1) {
+            outSize = abbreviateJpeg(chunk.data(), chunk.size());
+        }
+
+        if (!opened) {
+            uint32_t w = lossless && decoder.getWidth() ? (uint32_t)decoder.getWidth() : info.width;
+            uint32_t h = lossless && decoder.getHeight() ? (uint32_t)decoder.getHeight() : info.height;
+            mux.setVideoParameters(w, h, fps, "MJPG");
+            if (info.hasAudio) {
+                mux.setAudioParameters(info.sampleRate, info.channels, info.blockAlign, info.bitsPerSample);
+            }
+            if (!mux.open()) {
+                std::cerr << "Cannot write " << outFile << std::endl;
+                return 1;
+            }
+            opened = true;
+            for (auto& a : pendingAudio) mux.writeAudioSamples(a.data(), a.size());
+            pendingAudio.clear();
+        }
+        mux.writeVideoFrame(out, outSize);
+        bytesOut += outSize;
+        ++frames;
+    }
+    if (!opened) {
+        std::cerr << "No video frames in " << inFile << std::endl;
+        return 1;
+    }
+    if (!mux.close()) return 1; // AVIMux reports the failed write
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    std::cout << "Wrote " << frames << " frames (" << repeats << " repeats), " << audioChunks << " audio chunks: "
+              << bytesIn << " -> " << bytesOut << " video bytes in " << seconds << "s" << std::endl;
+    return 0;
+}
@@ -12,7 +12,7 @@ static uint64_t now_ms() {
     return (uint64_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
 }
 
-WASAPICapture::WASAPICapture() : waveFormat(nullptr), capturing(false), outRing(nullptr) {}
+WASAPICapture::WASAPICapture() : waveFormat(nullptr), capturing(false), outRing(nullptr), bufferPool(nullptr) {}
 
 WASAPICapture::~WASAPICapture() {
     Stop();
@@ -48,6 +48,10 @@ bool WASAPICapture::Initialize() {
     return true;
 }
 
+void WASAPICapture::setBufferPool(PacketBufferPool* pool) {
+    bufferPool = pool;
+}
+
 bool WASAPICapture::Start(SPSC_Ring<AudioPacket>* outRing) {
     if (!audioClient || !captureClient) return false;
     if (capturing.load()) return false;
@@ -91,11 +95,13 @@ void WASAPICapture::CaptureLoop() {
         size_t bytes = framesAvailable * bytesPerFrame;
         AudioPacket pkt;
         pkt.pts_ms = now_ms();
-        pkt.data.resize(bytes);
-        memcpy(pkt.data.data(), data, bytes);
+        if (bufferPool) pkt.data = bufferPool->acquire(bytes);
+        pkt.data.assign(data, data + bytes);
 
         // Push to ring (drop if full)
-        outRing->push(pkt);
+        if (!outRing->push(std::move(pkt)) && bufferPool) {
+            bufferPool->release(std::move(pkt.data));
+        }
 
         captureClient->ReleaseBuffer(framesAvailable);
     }
@@ -20,6 +20,9 @@ public:
     // Initialize COM and audio device
     bool Initialize();
 
+    // Recycle packet payloads from this pool (optional; call before Start)
+    void setBufferPool(PacketBufferPool* pool);
+
     // Start loopback capture and push AudioPacket into outRing
     bool Start(SPSC_Ring<AudioPacket>* outRing);
     void Stop();
@@ -37,6 +40,7 @@ private:
     std::atomic<bool> capturing;
     std::unique_ptr<std::thread> worker;
     SPSC_Ring<AudioPacket>* outRing;
+    PacketBufferPool* bufferPool;
 
     void CaptureLoop();
 };
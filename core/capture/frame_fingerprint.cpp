@@ -0,0 +1,150 @@
+#include "frame_fingerprint.h"
+#include <cstring>
+
+#ifdef RECORDER_X86
+#include <immintrin.h>
+#endif
+
+// Stripe s of a block uses keys [s, s + 4); the last four scramble the lanes per block
+static const int kStripeBytes = 32;
+static const int kBlockStripes = 16;
+static const size_t kBlockBytes = (size_t)kStripeBytes * kBlockStripes;
+alignas(32) static const uint64_t kKeys[24] = {
+    0xC0E16B163A85A4DCULL, 0x890ACD8DD443C47CULL, 0xB3889D8A6DC47761ULL, 0x6A0398E528F0AE6AULL,
+    0x048344ECE48A855EULL, 0xF175CFEA21871330ULL, 0x391CEEF02702C2FDULL, 0x4BAF8CAC4784CB12ULL,
+    0x3547744583A3F88EULL, 0xD9CF2B15C6B6C90EULL, 0x961FACC76D5FE21CULL, 0x0094AB49D50F11F9ULL,
+    0xE3211E37BDBEB6DCULL, 0x62FE6C274FF3511AULL, 0x5AC30B329FDF0574ULL, 0x1450582C6B65B406ULL,
+    0x7A30FCC7888EB791ULL, 0x5540F5BA6A15576EULL, 0x16CEF0559096D3E9ULL, 0x2CF8F14B06874899ULL,
+    0xC9C9263B6E2CE103ULL, 0xD6FF920B0A9FAA6DULL, 0x53192697DB998DC1ULL, 0x73EA9B9BC7CD18D7ULL,
+};
+static const uint64_t* const kScrambleKeys = kKeys + 20;
+static const uint32_t kPrime32 = 0x9E3779B1u;
+
+static uint64_t load64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+// Lane i takes the product of the two halves of (data ^ key) and the data of its neighbour
+// lane, so every input bit reaches the accumulators through both paths
+static void accumulateStripe(uint64_t acc[4], const uint8_t* p, const uint64_t* key) {
+    uint64_t d[4];
+    for (int i = 0; i < 4; ++i) d[i] = load64(p + i * 8);
+    for (int i = 0; i < 4; ++i) {
+        uint64_t dk = d[i] ^ key[i];
+        acc[i] += d[i ^ 1] + (uint64_t)(uint32_t)dk * (dk >> 32);
+    }
+}
+
+static void scramble(uint64_t acc[4]) {
+    for (int i = 0; i < 4; ++i) {
+        uint64_t a = acc[i];
+        a ^= a >> 47;
+        a ^= kScrambleKeys[i];
+        acc[i] = a * kPrime32;
+    }
+}
+
+static void accumulateBlocksScalar(uint64_t acc[4], const uint8_t* p, size_t blocks) {
+    for (size_t b = 0; b < blocks; ++b, p += kBlockBytes) {
+        for (int s = 0; s < kBlockStripes; ++s) accumulateStripe(acc, p + s * kStripeBytes, kKeys + s);
+        scramble(acc);
+    }
+}
+
+#ifdef RECORDER_X86
+RECORDER_TARGET_SSE41 static void accumulateBlocksSSE41(uint64_t acc[4], const uint8_t* p, size_t blocks) {
+    __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc));
+    __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + 2));
+    const __m128i prime = _mm_set1_epi32((int)kPrime32);
+    const __m128i skey0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(kScrambleKeys));
+    const __m128i skey1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(kScrambleKeys + 2));
+    for (size_t b = 0; b < blocks; ++b, p += kBlockBytes) {
+        for (int s = 0; s < kBlockStripes; ++s) {
+            const uint8_t* q = p + s * kStripeBytes;
+            __m128i d0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(q));
+            __m128i d1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(q + 16));
+            __m128i k0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(kKeys + s));
+            __m128i k1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(kKeys + s + 2));
+            __m128i dk0 = _mm_xor_si128(d0, k0);
+            __m128i dk1 = _mm_xor_si128(d1, k1);
+            __m128i p0 = _mm_mul_epu32(dk0, _mm_srli_epi64(dk0, 32));
+            __m128i p1 = _mm_mul_epu32(dk1, _mm_srli_epi64(dk1, 32));
+            a0 = _mm_add_epi64(a0, _mm_add_epi64(p0, _mm_shuffle_epi32(d0, _MM_SHUFFLE(1, 0, 3, 2))));
+            a1 = _mm_add_epi64(a1, _mm_add_epi64(p1, _mm_shuffle_epi32(d1, _MM_SHUFFLE(1, 0, 3, 2))));
+        }
+        // a * prime mod 2^64 = lo32(a) * prime + (hi32(a) * prime << 32)
+        a0 = _mm_xor_si128(_mm_xor_si128(a0, _mm_srli_epi64(a0, 47)), skey0);
+        a1 = _mm_xor_si128(_mm_xor_si128(a1, _mm_srli_epi64(a1, 47)), skey1);
+        a0 = _mm_add_epi64(_mm_mul_epu32(a0, prime), _mm_slli_epi64(_mm_mul_epu32(_mm_srli_epi64(a0, 32), prime), 32));
+        a1 = _mm_add_epi64(_mm_mul_epu32(a1, prime), _mm_slli_epi64(_mm_mul_epu32(_mm_srli_epi64(a1, 32), prime), 32));
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(acc), a0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + 2), a1);
+}
+
+RECORDER_TARGET_AVX2 static void accumulateBlocksAVX2(uint64_t acc[4], const uint8_t* p, size_t blocks) {
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc));
+    const __m256i prime = _mm256_set1_epi32((int)kPrime32);
+    const __m256i skey = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(kScrambleKeys));
+    for (size_t b = 0; b < blocks; ++b, p += kBlockBytes) {
+        for (int s = 0; s < kBlockStripes; ++s) {
+            __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + s * kStripeBytes));
+            __m256i k = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(kKeys + s));
+            __m256i dk = _mm256_xor_si256(d, k);
+            __m256i prod = _mm256_mul_epu32(dk, _mm256_srli_epi64(dk, 32));
+            a = _mm256_add_epi64(a, _mm256_add_epi64(prod, _mm256_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2))));
+        }
+        a = _mm256_xor_si256(_mm256_xor_si256(a, _mm256_srli_epi64(a, 47)), skey);
+        a = _mm256_add_epi64(_mm256_mul_epu32(a, prime),
+                             _mm256_slli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), prime), 32));
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc), a);
+}
+#endif
+
+static uint64_t avalanche(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+uint64_t frameFingerprint(const uint8_t* data, size_t bytes, SimdLevel level) {
+    uint64_t acc[4] = {kKeys[0], kKeys[1], kKeys[2], kKeys[3]};
+    size_t blocks = bytes / kBlockBytes;
+#ifdef RECORDER_X86
+    if (level == SimdLevel::AVX2) accumulateBlocksAVX2(acc, data, blocks);
+    else if (level == SimdLevel::SSE41) accumulateBlocksSSE41(acc, data, blocks);
+    else accumulateBlocksScalar(acc, data, blocks);
+#else
+    (void)level;
+    accumulateBlocksScalar(acc, data, blocks);
+#endif
+
+    // Partial last block: whole stripes, then the tail zero-padded to a stripe
+    const uint8_t* p = data + blocks * kBlockBytes;
+    size_t rest = bytes - blocks * kBlockBytes;
+    int s = 0;
+    for (; rest >= (size_t)kStripeBytes; ++s, p += kStripeBytes, rest -= kStripeBytes) {
+        accumulateStripe(acc, p, kKeys + s);
+    }
+    if (rest > 0) {
+        uint8_t last[kStripeBytes] = {};
+        memcpy(last, p, rest);
+        accumulateStripe(acc, last, kKeys + s);
+    }
+    scramble(acc);
+
+    uint64_t h = (uint64_t)bytes * 0x9E3779B185EBCA87ULL;
+    for (int i = 0; i < 4; ++i) h = avalanche(h ^ acc[i]) + kScrambleKeys[i];
+    h = avalanche(h);
+    return h ? h : 1;
+}
+
+uint64_t frameFingerprint(const uint8_t* data, size_t bytes) {
+    return frameFingerprint(data, bytes, simdLevel());
+}
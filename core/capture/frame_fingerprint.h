@@ -0,0 +1,17 @@
+#ifndef FRAME_FINGERPRINT_H
+#define FRAME_FINGERPRINT_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "../util/cpu_features.h"
+
+// 64-bit fingerprint of a whole frame, for spotting frames identical to the previous one
+// without keeping it around. Every byte is hashed (a cursor blink must count as a change),
+// 32 bytes per step in four multiply-accumulate lanes that are scrambled every 512 bytes,
+// so it runs at about memory speed. Not a cryptographic hash; results are the same for
+// every SimdLevel. Never returns 0, which callers can use for "not computed".
+uint64_t frameFingerprint(const uint8_t* data, size_t bytes, SimdLevel level);
+uint64_t frameFingerprint(const uint8_t* data, size_t bytes);
+
+#endif // FRAME_FINGERPRINT_H
@@ -0,0 +1,187 @@
+#include "frame_pool.h"
+#include <chrono>
+
+FramePool::FramePool()
+    : frameSize(0), policy(OverflowPolicy::DropNewest), nextSequence(0), interrupted(false), stats() {
+}
+
+bool FramePool::allocate(size_t frameSize, size_t slotCount) {
+    if (frameSize == 0 || slotCount == 0) return false;
+    std::lock_guard<std::mutex> lock(mutex);
+    this->frameSize = frameSize;
+    slots.clear();
+    slots.resize(slotCount);
+    for (auto& s : slots) {
+        s.data.resize(frameSize);
+        s.state = SlotState::Free;
+        s.refs = 0;
+        s.sequence = 0;
+    }
+    nextSequence = 0;
+    interrupted = false;
+    stats = FramePoolStats();
+    return true;
+}
+
+size_t FramePool::slotsForBudget(size_t frameSize, size_t budgetBytes, size_t minSlots, size_t maxSlots) {
+    size_t n = frameSize ? budgetBytes / frameSize : maxSlots;
+    if (n < minSlots) n = minSlots;
+    if (n > maxSlots) n = maxSlots;
+    return n;
+}
+
+void FramePool::setOverflowPolicy(OverflowPolicy newPolicy) {
+    std::lock_guard<std::mutex> lock(mutex);
+    policy = newPolicy;
+}
+
+OverflowPolicy FramePool::getOverflowPolicy() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return policy;
+}
+
+int FramePool::takeFreeLocked() {
+    for (size_t i = 0; i < slots.size(); ++i) {
+        if (slots[i].state == SlotState::Free) {
+            slots[i].state = SlotState::Writing;
+            slots[i].refs = 1;
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+int FramePool::acquireForWrite() {
+    std::unique_lock<std::mutex> lock(mutex);
+    int slot = takeFreeLocked();
+    if (slot >= 0) return slot;
+
+    switch (policy) {
+    case OverflowPolicy::DropNewest:
+        stats.droppedNewest++;
+        return -1;
+
+    case OverflowPolicy::DropOldest: {
+        // Oldest published frame nobody has claimed yet; its ticket in the ring goes stale
+        int oldest = -1;
+        for (size_t i = 0; i < slots.size(); ++i) {
+            if (slots[i].state != SlotState::Queued) continue;
+            if (oldest < 0 || (int32_t)(slots[i].sequence - slots[oldest].sequence) < 0) oldest = (int)i;
+        }
+        if (oldest < 0) {
+            // every slot is being read; nothing can be reclaimed
+            stats.droppedNewest++;
+            return -1;
+        }
+        stats.droppedOldest++;
+        slots[oldest].state = SlotState::Writing;
+        slots[oldest].refs = 1;
+        return oldest;
+    }
+
+    case OverflowPolicy::Block: {
+        stats.blockedWaits++;
+        auto waitStart = std::chrono::steady_clock::now();
+        while (slot < 0 && !interrupted) {
+            slotFreed.wait(lock);
+            slot = takeFreeLocked();
+        }
+        stats.blockedMicros += (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - waitStart).count();
+        interrupted = false;
+        return slot;
+    }
+    }
+    return -1;
+}
+
+uint8_t* FramePool::writableBuffer(int slot) {
+    if (slot < 0 || (size_t)slot >= slots.size()) return nullptr;
+    return slots[slot].data.data();
+}
+
+FrameTicket FramePool::publish(int slot, uint64_t captureUs) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Slot& s = slots[slot];
+    s.state = SlotState::Queued;
+    s.sequence = nextSequence++;
+    stats.published++;
+    FrameTicket t;
+    t.slot = (uint32_t)slot;
+    t.sequence = s.sequence;
+    t.pts_ms = captureUs / 1000;
+    t.capture_us = captureUs;
+    t.fingerprint = 0;
+    t.width = 0;
+    t.height = 0;
+    return t;
+}
+
+void FramePool::abandon(int slot) {
+    if (slot < 0 || (size_t)slot >= slots.size()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        slots[slot].state = SlotState::Free;
+        slots[slot].refs = 0;
+    }
+    slotFreed.notify_one();
+}
+
+const uint8_t* FramePool::acquireForRead(const FrameTicket& ticket) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (ticket.slot >= slots.size()) return nullptr;
+    Slot& s = slots[ticket.slot];
+    if (s.state != SlotState::Queued || s.sequence != ticket.sequence) return nullptr;
+    // the publish reference becomes the consumer's lease
+    s.state = SlotState::Leased;
+    return s.data.data();
+}
+
+void FramePool::addRef(uint32_t slot) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (slot < slots.size() && slots[slot].refs > 0) slots[slot].refs++;
+}
+
+void FramePool::release(uint32_t slot) {
+    bool freed = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (slot >= slots.size() || slots[slot].refs == 0) return;
+        if (--slots[slot].refs == 0) {
+            slots[slot].state = SlotState::Free;
+            freed = true;
+        }
+    }
+    if (freed) slotFreed.notify_one();
+}
+
+void FramePool::interrupt() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        interrupted = true;
+    }
+    slotFreed.notify_all();
+}
+
+size_t FramePool::getSlotCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return slots.size();
+}
+
+size_t FramePool::getFrameSize() const { return frameSize; }
+
+double FramePool::fillFactor() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t queued = 0, free = 0;
+    for (const auto& s : slots) {
+        if (s.state == SlotState::Queued) ++queued;
+        else if (s.state == SlotState::Free) ++free;
+    }
+    if (queued + free == 0) return slots.empty() ? 0.0 : 1.0;
+    return static_cast<double>(queued) / static_cast<double>(queued + free);
+}
+
+FramePoolStats FramePool::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
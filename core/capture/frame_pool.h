@@ -0,0 +1,103 @@
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+// What travels through the capture->encode ring: a pool slot plus the sequence number it
+// was published with. A ticket goes stale when DropOldest reclaims its slot for a newer frame.
+struct FrameTicket {
+    uint32_t slot;
+    uint32_t sequence;
+    uint64_t pts_ms;     // capture timestamp (steady clock ms)
+    uint64_t capture_us; // same instant in steady clock us, for latency telemetry
+    uint64_t fingerprint; // frameFingerprint() of the pixels, 0 if not computed
+    uint32_t width;       // size of the frame in the slot; smaller than the source size
+    uint32_t height;      // when it was captured downscaled
+};
+
+// What the producer does when every slot is in use
+enum class OverflowPolicy {
+    DropNewest, // skip capturing this frame
+    DropOldest, // reclaim the oldest frame no consumer has claimed yet
+    Block       // wait for a consumer to release a slot
+};
+
+struct FramePoolStats {
+    uint64_t published;     // frames handed to consumers
+    uint64_t droppedNewest; // captures skipped for lack of a slot
+    uint64_t droppedOldest; // queued frames reclaimed before a consumer claimed them
+    uint64_t blockedWaits;  // times the producer had to wait for a slot
+    uint64_t blockedMicros; // total time spent waiting
+};
+
+// Fixed set of frame buffers shared by one producer (the capture thread) and any number
+// of consumers. A slot is only rewritten once every lease on it has been released, so a
+// frame can never change underneath the encoder reading it.
+class FramePool {
+public:
+    FramePool();
+
+    // Allocate slotCount buffers of frameSize bytes; drops any previous allocation
+    bool allocate(size_t frameSize, size_t slotCount);
+
+    // Number of slots that fit in budgetBytes, clamped to [minSlots, maxSlots]
+    static size_t slotsForBudget(size_t frameSize, size_t budgetBytes, size_t minSlots, size_t maxSlots);
+
+    void setOverflowPolicy(OverflowPolicy policy);
+    OverflowPolicy getOverflowPolicy() const;
+
+    // Producer: claim a slot to write into, applying the overflow policy.
+    // Returns -1 when the frame must be skipped (DropNewest, or interrupt() while blocked).
+    int acquireForWrite();
+    uint8_t* writableBuffer(int slot);
+    // Producer: hand a written slot to consumers; the returned ticket goes into the ring.
+    // captureUs is the steady clock capture time in microseconds (pts_ms is derived from it).
+    FrameTicket publish(int slot, uint64_t captureUs);
+    // Producer: give back a slot that was not (or could not be) published
+    void abandon(int slot);
+
+    // Consumer: lease the frame a ticket refers to. Returns nullptr for a stale ticket.
+    // On success the caller must release(ticket.slot) once done reading.
+    const uint8_t* acquireForRead(const FrameTicket& ticket);
+    // Take an additional lease on a slot the caller already holds
+    void addRef(uint32_t slot);
+    void release(uint32_t slot);
+
+    // Wake a producer blocked in acquireForWrite() (used on shutdown)
+    void interrupt();
+
+    size_t getSlotCount() const;
+    size_t getFrameSize() const;
+
+    // Backlog pressure: queued frames / (queued + free slots). 0 when nothing is waiting,
+    // 1 when the producer has no free slot left and the overflow policy kicks in.
+    double fillFactor() const;
+    FramePoolStats getStats() const;
+
+private:
+    enum class SlotState : uint8_t { Free, Writing, Queued, Leased };
+
+    struct Slot {
+        std::vector<uint8_t> data;
+        SlotState state;
+        uint32_t refs;
+        uint32_t sequence;
+    };
+
+    int takeFreeLocked();
+
+    mutable std::mutex mutex;
+    std::condition_variable slotFreed;
+    std::vector<Slot> slots;
+    size_t frameSize;
+    OverflowPolicy policy;
+    uint32_t nextSequence;
+    bool interrupted;
+    FramePoolStats stats;
+};
+
+#endif // FRAME_POOL_H
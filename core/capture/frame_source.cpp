@@ -0,0 +1,168 @@
+#include "frame_source.h"
+#include "frame_fingerprint.h"
+#include "../util/timing.h"
+#include <chrono>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <timeapi.h>
+#pragma comment(lib, "winmm.lib")
+#endif
+
+FrameSource::FrameSource(int width, int height, int fps, size_t bufferCount)
+    : width(width), height(height), fps(fps), captureDownscale(1), fingerprinting(false), bufferCount(bufferCount), outRing(nullptr),
+      capturedFrames(0), ringFullDrops(0), missedTicks(0), running(false) {
+    frameSize = static_cast<size_t>(width) * static_cast<size_t>(height) * 4; // BGRA
+}
+
+FrameSource::~FrameSource() {
+    // Derived destructors must call Stop() themselves: CaptureFrame() is pure virtual
+    // and cannot be reached once the derived part has been destroyed.
+    Stop();
+}
+
+bool FrameSource::Initialize() {
+    if (width <= 0 || height <= 0 || bufferCount == 0) return false;
+    return pool.allocate(frameSize, bufferCount);
+}
+
+void FrameSource::setBufferCount(size_t count) {
+    if (count > 0) bufferCount = count;
+}
+
+void FrameSource::setOverflowPolicy(OverflowPolicy policy) {
+    pool.setOverflowPolicy(policy);
+}
+
+size_t FrameSource::getBufferCount() const { return bufferCount; }
+
+bool FrameSource::Start(SPSC_Ring<FrameTicket>* outRing) {
+    if (pool.getSlotCount() == 0) return false;
+    if (running.load()) return false;
+    this->outRing = outRing;
+    running.store(true);
+    worker.reset(new std::thread(&FrameSource::CaptureLoop, this));
+    return true;
+}
+
+void FrameSource::Stop() {
+    if (!running.load()) return;
+    running.store(false);
+    pool.interrupt();
+    if (worker && worker->joinable()) worker->join();
+}
+
+FramePool& FrameSource::getFramePool() { return pool; }
+
+size_t FrameSource::getFrameSize() const { return frameSize; }
+
+int FrameSource::getWidth() const { return width; }
+
+int FrameSource::getHeight() const { return height; }
+
+void FrameSource::setFps(int newFps) {
+    if (newFps < 1) newFps = 1;
+    fps.store(newFps);
+}
+
+int FrameSource::getFps() const { return fps.load(); }
+
+void FrameSource::setCaptureDownscale(int factor) {
+    if (factor < 1) factor = 1;
+    captureDownscale.store(factor);
+}
+
+int FrameSource::getCaptureDownscale() const { return captureDownscale.load(); }
+
+bool FrameSource::CaptureFrameScaled(uint8_t* dst, int dstWidth, int dstHeight, int factor) {
+    if (!CaptureFrame(dst)) return false;
+    // Average factor x factor blocks front to back: output pixel (x, y) only reads input
+    // rows from y * factor on, which lie at or after it, so nothing is read after it has
+    // been overwritten
+    const int count = factor * factor;
+    const size_t srcStride = static_cast<size_t>(width) * 4;
+    for (int y = 0; y < dstHeight; ++y) {
+        const uint8_t* src = dst + static_cast<size_t>(y) * factor * srcStride;
+        uint8_t* out = dst + static_cast<size_t>(y) * dstWidth * 4;
+        for (int x = 0; x < dstWidth; ++x) {
+            int sum[4] = {0, 0, 0, 0};
+            for (int dy = 0; dy < factor; ++dy) {
+                const uint8_t* p = src + dy * srcStride + static_cast<size_t>(x) * factor * 4;
+                for (int dx = 0; dx < factor; ++dx, p += 4) {
+                    sum[0] += p[0]; sum[1] += p[1]; sum[2] += p[2]; sum[3] += p[3];
+                }
+            }
+            for (int c = 0; c < 4; ++c) out[x * 4 + c] = (uint8_t)((sum[c] + count / 2) / count);
+        }
+    }
+    return true;
+}
+
+void FrameSource::setFingerprinting(bool enabled) { fingerprinting.store(enabled); }
+
+bool FrameSource::getFingerprinting() const { return fingerprinting.load(); }
+
+uint64_t FrameSource::getCapturedFrames() const { return capturedFrames.load(std::memory_order_relaxed); }
+
+uint64_t FrameSource::getDroppedFrames() const {
+    FramePoolStats ps = pool.getStats();
+    return ps.droppedNewest + ps.droppedOldest + ringFullDrops.load(std::memory_order_relaxed);
+}
+
+uint64_t FrameSource::getMissedTicks() const { return missedTicks.load(std::memory_order_relaxed); }
+
+const LatencyHistogram& FrameSource::getCaptureTimeHistogram() const { return captureTime; }
+
+void FrameSource::CaptureLoop() {
+#ifdef _WIN32
+    // 1 ms scheduler resolution so the pacer's sleeps end close to where it asked
+    timeBeginPeriod(1);
+#endif
+    FramePacer pacer(fps.load());
+    pacer.start();
+
+    while (running.load()) {
+        int currentFps = fps.load();
+        pacer.setRate(currentFps < 1 ? 1 : currentFps);
+        uint64_t missed = pacer.wait();
+        if (missed) missedTicks.fetch_add(missed, std::memory_order_relaxed);
+        if (!running.load()) break;
+
+        // Only ever write into a slot no consumer holds; the pool applies the overflow policy
+        int slot = pool.acquireForWrite();
+        if (slot >= 0) {
+            int factor = captureDownscale.load();
+            int frameWidth = width / factor;
+            int frameHeight = height / factor;
+            if (frameWidth < 1 || frameHeight < 1) { factor = 1; frameWidth = width; frameHeight = height; }
+            uint64_t startUs = telemetry_now_us();
+            bool captured = factor == 1 ? CaptureFrame(pool.writableBuffer(slot))
+                                        : CaptureFrameScaled(pool.writableBuffer(slot), frameWidth, frameHeight, factor);
+            // the frame is stamped once complete, so queue latency excludes capture time
+            uint64_t capturedUs = telemetry_now_us();
+            captureTime.record(capturedUs - startUs);
+            if (captured) {
+                uint64_t fingerprint = 0;
+                if (fingerprinting.load(std::memory_order_relaxed)) {
+                    fingerprint = frameFingerprint(pool.writableBuffer(slot), (size_t)frameWidth * (size_t)frameHeight * 4);
+                }
+                FrameTicket ticket = pool.publish(slot, capturedUs);
+                ticket.fingerprint = fingerprint;
+                ticket.width = (uint32_t)frameWidth;
+                ticket.height = (uint32_t)frameHeight;
+                if (outRing && outRing->push(ticket)) {
+                    capturedFrames.fetch_add(1, std::memory_order_relaxed);
+                } else {
+                    // ring full (stale DropOldest tickets can outnumber slots): give the slot back
+                    ringFullDrops.fetch_add(1, std::memory_order_relaxed);
+                    pool.release((uint32_t)slot);
+                }
+            } else {
+                pool.abandon(slot);
+            }
+        }
+    }
+#ifdef _WIN32
+    timeEndPeriod(1);
+#endif
+}
@@ -0,0 +1,100 @@
+#ifndef FRAME_SOURCE_H
+#define FRAME_SOURCE_H
+
+#include <cstdint>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "frame_pool.h"
+#include "../util/spsc_ring.h"
+#include "../util/telemetry.h"
+
+// Base class for everything that produces BGRA frames for the encoder.
+// Owns the frame pool, the capture thread and its pacing; derived classes only
+// implement CaptureFrame() to fill one buffer.
+class FrameSource {
+public:
+    // width/height in pixels, fps default 30, bufferCount default 4
+    FrameSource(int width, int height, int fps = 30, size_t bufferCount = 4);
+    virtual ~FrameSource();
+
+    // Initialize resources; derived classes must call FrameSource::Initialize() to allocate buffers
+    virtual bool Initialize();
+
+    // Pool sizing and overflow behaviour; call before Initialize()
+    void setBufferCount(size_t count);
+    void setOverflowPolicy(OverflowPolicy policy);
+    size_t getBufferCount() const;
+
+    // Start capture thread; outRing receives tickets for published frames.
+    // Consumers lease them via getFramePool().acquireForRead() and release when done.
+    bool Start(SPSC_Ring<FrameTicket>* outRing);
+
+    // Stop capture thread and return when complete
+    void Stop();
+
+    FramePool& getFramePool();
+    size_t getFrameSize() const;
+    int getWidth() const;
+    int getHeight() const;
+
+    // Runtime FPS control (safe to call from other threads)
+    void setFps(int newFps);
+    int getFps() const;
+
+    // Capture at 1/factor of getWidth() x getHeight() (1 = full size); safe to call while
+    // running. Each ticket carries the size its frame was captured at.
+    void setCaptureDownscale(int factor);
+    int getCaptureDownscale() const;
+
+    // Fingerprint every frame on the capture thread (FrameTicket::fingerprint), while the
+    // pixels are still in cache, so consumers can spot repeated frames. Default off.
+    void setFingerprinting(bool enabled);
+    bool getFingerprinting() const;
+
+    // Frames handed to the ring / frames dropped (no free slot, reclaimed, or ring full)
+    uint64_t getCapturedFrames() const;
+    uint64_t getDroppedFrames() const;
+    // Capture ticks skipped because a capture overran one or more whole frame periods
+    uint64_t getMissedTicks() const;
+
+    // Time spent inside CaptureFrame() per frame, in microseconds
+    const LatencyHistogram& getCaptureTimeHistogram() const;
+
+protected:
+    // Fill dst with one top-down BGRA frame of getFrameSize() bytes.
+    // Return false if no frame is available this tick (nothing is pushed).
+    virtual bool CaptureFrame(uint8_t* dst) = 0;
+
+    // Fill dst with one frame of dstWidth x dstHeight, 1/factor of the source size. The
+    // default captures full size with CaptureFrame() and box-filters it down in place;
+    // sources that can capture smaller directly override it.
+    virtual bool CaptureFrameScaled(uint8_t* dst, int dstWidth, int dstHeight, int factor);
+
+    int width;
+    int height;
+    size_t frameSize;
+
+private:
+    void CaptureLoop();
+
+    std::atomic<int> fps;
+    std::atomic<int> captureDownscale;
+    std::atomic<bool> fingerprinting;
+    size_t bufferCount;
+
+    FramePool pool;
+    SPSC_Ring<FrameTicket>* outRing;
+
+    std::atomic<uint64_t> capturedFrames;
+    std::atomic<uint64_t> ringFullDrops;
+    std::atomic<uint64_t> missedTicks;
+    LatencyHistogram captureTime;
+
+    std::atomic<bool> running;
+    std::unique_ptr<std::thread> worker;
+};
+
+#endif // FRAME_SOURCE_H
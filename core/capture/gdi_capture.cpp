@@ -1,15 +1,21 @@
 #include "gdi_capture.h"
 #include <windows.h>
-#include <chrono>
-#include <iostream>
 
 GDICapture::GDICapture(int width, int height, int fps, size_t bufferCount)
-    : hdcScreen(NULL), hdcMem(NULL), hBitmap(NULL), width(width), height(height), fps(fps), bufferCount(bufferCount), outRing(nullptr), running(false) {
-    frameSize = static_cast<size_t>(width) * static_cast<size_t>(height) * 4; // BGRA
+    : FrameSource(width, height, fps, bufferCount), hdcScreen(NULL), hdcMem(NULL), hBitmap(NULL),
+      hdcScaled(NULL), hBitmapScaled(NULL), scaledWidth(0), scaledHeight(0) {
+}
+
+bool GDICapture::getScreenSize(int& width, int& height) {
+    width = GetSystemMetrics(SM_CXSCREEN);
+    height = GetSystemMetrics(SM_CYSCREEN);
+    return width > 0 && height > 0;
 }
 
 GDICapture::~GDICapture() {
     Stop();
+    if (hdcScaled) DeleteDC(hdcScaled);
+    if (hBitmapScaled) DeleteObject(hBitmapScaled);
     if (hBitmap) DeleteObject(hBitmap);
     if (hdcMem) DeleteDC(hdcMem);
     if (hdcScreen) ReleaseDC(NULL, hdcScreen);
@@ -24,80 +30,48 @@ bool GDICapture::Initialize() {
     if (!hBitmap) return false;
     SelectObject(hdcMem, hBitmap);
 
-    buffers.resize(bufferCount);
-    for (size_t i = 0; i < bufferCount; ++i) buffers[i].resize(frameSize);
-
-    return true;
-}
-
-bool GDICapture::Start(SPSC_Ring<int>* outRing) {
-    if (!hdcScreen || !hdcMem || !hBitmap) return false;
-    if (running.load()) return false;
-    this->outRing = outRing;
-    running.store(true);
-    worker.reset(new std::thread(&GDICapture::CaptureLoop, this));
-    return true;
+    return FrameSource::Initialize();
 }
 
-void GDICapture::Stop() {
-    if (!running.load()) return;
-    running.store(false);
-    if (worker && worker->joinable()) worker->join();
+bool GDICapture::CaptureFrame(uint8_t* dst) {
+    HDC hdcTarget = GetDC(NULL);
+    BitBlt(hdcMem, 0, 0, width, height, hdcTarget, 0, 0, SRCCOPY | CAPTUREBLT);
+    ReleaseDC(NULL, hdcTarget);
+    return copyBits(hBitmap, width, height, dst);
 }
 
-const uint8_t* GDICapture::getFrameBuffer(size_t index) const {
-    if (index >= buffers.size()) return nullptr;
-    return buffers[index].data();
+bool GDICapture::CaptureFrameScaled(uint8_t* dst, int dstWidth, int dstHeight, int factor) {
+    if (!hBitmapScaled || dstWidth != scaledWidth || dstHeight != scaledHeight) {
+        if (hdcScaled) { DeleteDC(hdcScaled); hdcScaled = NULL; }
+        if (hBitmapScaled) { DeleteObject(hBitmapScaled); hBitmapScaled = NULL; }
+        hdcScaled = CreateCompatibleDC(hdcScreen);
+        hBitmapScaled = hdcScaled ? CreateCompatibleBitmap(hdcScreen, dstWidth, dstHeight) : NULL;
+        if (!hBitmapScaled) return FrameSource::CaptureFrameScaled(dst, dstWidth, dstHeight, factor);
+        SelectObject(hdcScaled, hBitmapScaled);
+        // COLORONCOLOR drops pixels instead of averaging them: the cheapest stretch, which
+        // is what this rung of the ladder is for
+        SetStretchBltMode(hdcScaled, COLORONCOLOR);
+        scaledWidth = dstWidth;
+        scaledHeight = dstHeight;
+    }
+    HDC hdcTarget = GetDC(NULL);
+    StretchBlt(hdcScaled, 0, 0, dstWidth, dstHeight, hdcTarget, 0, 0, dstWidth * factor, dstHeight * factor,
+               SRCCOPY | CAPTUREBLT);
+    ReleaseDC(NULL, hdcTarget);
+    return copyBits(hBitmapScaled, dstWidth, dstHeight, dst);
 }
 
-size_t GDICapture::getFrameSize() const { return frameSize; }
-
-void GDICapture::setFps(int newFps) {
-    if (newFps < 1) newFps = 1;
-    fps.store(newFps);
+// Copy bits from HBITMAP to buffer as top-down BGRA
+bool GDICapture::copyBits(HBITMAP bitmap, int w, int h, uint8_t* dst) {
+    BITMAPINFO bmi;
+    ZeroMemory(&bmi, sizeof(bmi));
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = w;
+    bmi.bmiHeader.biHeight = -h; // top-down
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    int lines = GetDIBits(hdcMem, bitmap, 0, h, dst, &bmi, DIB_RGB_COLORS);
+    return lines != 0;
 }
-
-int GDICapture::getFps() const { return fps.load(); }
-
-void GDICapture::CaptureLoop() {
-    using namespace std::chrono;
-    size_t writeIndex = 0;
-
-    while (running.load()) {
-        auto start = std::chrono::high_resolution_clock::now();
-
-        int currentFps = fps.load();
-        int safeFps = (currentFps < 1) ? 1 : currentFps;
-        auto frameInterval = milliseconds(1000 / safeFps);
-
-        HDC hdcTarget = GetDC(NULL);
-        BitBlt(hdcMem, 0, 0, width, height, hdcTarget, 0, 0, SRCCOPY | CAPTUREBLT);
-        // Copy bits from HBITMAP to buffer
-        BITMAPINFO bmi;
-        ZeroMemory(&bmi, sizeof(bmi));
-        bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
-        bmi.bmiHeader.biWidth = width;
-        bmi.bmiHeader.biHeight = -height; // top-down
-        bmi.bmiHeader.biPlanes = 1;
-        bmi.bmiHeader.biBitCount = 32;
-        bmi.bmiHeader.biCompression = BI_RGB;
-
-        if (!GetDIBits(hdcMem, hBitmap, 0, height, buffers[writeIndex].data(), &bmi, DIB_RGB_COLORS)) {
-            // failed to read bits
-        }
-
-        ReleaseDC(NULL, hdcTarget);
-
-        // Push index to ring; if ring full drop this frame (advance writeIndex)
-        if (outRing) {
-            if (!outRing->push((int)writeIndex)) {
-                // buffer full: drop oldest behavior handled by consumer; here we just skip pushing
-            }
-        }
-
-        writeIndex = (writeIndex + 1) % bufferCount;
-
-        auto elapsed = std::chrono::high_resolution_clock::now() - start;
-        if (elapsed < frameInterval) std::this_thread::sleep_for(frameInterval - elapsed);
-    }
-}
\ No newline at end of file
@@ -3,54 +3,40 @@
 
 #include <windows.h>
 #include <cstdint>
-#include <vector>
-#include <atomic>
-#include <memory>
-#include <thread>
 
-#include "../util/spsc_ring.h"
+#include "frame_source.h"
 
-class GDICapture {
+// Low-end desktop capture path (BitBlt from the screen DC). Frames are the top-left
+// width x height of the primary screen, normally its full size (getScreenSize); scaling to
+// the recorded size happens in the encoder workers (see ImageScaler).
+class GDICapture : public FrameSource {
 public:
     // width/height in pixels, fps default 30, bufferCount default 4 (power of two recommended)
     GDICapture(int width, int height, int fps = 30, size_t bufferCount = 4);
     ~GDICapture();
 
-    // Initialize resources (DCs, bitmaps)
-    bool Initialize();
+    // Size of the primary screen in pixels; false if it cannot be queried
+    static bool getScreenSize(int& width, int& height);
 
-    // Start capture thread; outRing receives indices of filled buffers (indices are 0..bufferCount-1)
-    bool Start(SPSC_Ring<int>* outRing);
+    // Initialize resources (DCs, bitmaps, frame buffers)
+    bool Initialize() override;
 
-    // Stop capture thread and return when complete
-    void Stop();
-
-    // Access buffer by index (read-only consumer view)
-    const uint8_t* getFrameBuffer(size_t index) const;
-    size_t getFrameSize() const;
-
-    // Runtime FPS control (safe to call from other threads)
-    void setFps(int newFps);
-    int getFps() const;
+protected:
+    bool CaptureFrame(uint8_t* dst) override;
+    // StretchBlt straight from the screen into a smaller bitmap
+    bool CaptureFrameScaled(uint8_t* dst, int dstWidth, int dstHeight, int factor) override;
 
 private:
-    void CaptureLoop();
+    bool copyBits(HBITMAP bitmap, int w, int h, uint8_t* dst);
 
     HDC hdcScreen;
     HDC hdcMem;
     HBITMAP hBitmap;
-
-    int width;
-    int height;
-    std::atomic<int> fps;
-    size_t bufferCount;
-    size_t frameSize;
-
-    std::vector<std::vector<uint8_t>> buffers;
-    SPSC_Ring<int>* outRing;
-
-    std::atomic<bool> running;
-    std::unique_ptr<std::thread> worker;
+    // reduced-size target, (re)created when the downscale factor changes
+    HDC hdcScaled;
+    HBITMAP hBitmapScaled;
+    int scaledWidth;
+    int scaledHeight;
 };
 
-#endif // GDI_CAPTURE_H
\ No newline at end of file
+#endif // GDI_CAPTURE_H
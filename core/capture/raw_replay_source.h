@@ -0,0 +1,39 @@
+#ifndef RAW_REPLAY_SOURCE_H
+#define RAW_REPLAY_SOURCE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "frame_source.h"
+
+// Replays a raw BGRA dump (frames of width * height * 4 bytes, top-down, back to back).
+// Lets a recorded capture be fed through the pipeline at a fixed rate on any machine.
+class RawReplaySource : public FrameSource {
+public:
+    // loop: rewind at end of file; otherwise the source stops producing frames
+    RawReplaySource(const std::string& filename, int width, int height, int fps = 30,
+                    size_t bufferCount = 4, bool loop = true);
+    ~RawReplaySource();
+
+    // Opens the file and checks that it holds at least one whole frame
+    bool Initialize() override;
+
+    uint64_t getFileFrameCount() const;
+
+    // True once a non-looping replay has delivered its last frame
+    bool isFinished() const;
+
+protected:
+    bool CaptureFrame(uint8_t* dst) override;
+
+private:
+    std::string filename;
+    FILE* file;
+    bool loop;
+    uint64_t fileFrameCount;
+    uint64_t nextFrame;
+    std::atomic<bool> finished;
+};
+
+#endif // RAW_REPLAY_SOURCE_H
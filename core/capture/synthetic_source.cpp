@@ -0,0 +1,150 @@
+#include "synthetic_source.h"
+#include <cstring>
+#include <algorithm>
+
+bool parseSyntheticPattern(const std::string& name, SyntheticPattern& out) {
+    if (name == "scroll") { out = SyntheticPattern::Scroll; return true; }
+    if (name == "noise") { out = SyntheticPattern::Noise; return true; }
+    if (name == "static") { out = SyntheticPattern::Static; return true; }
+    if (name == "game") { out = SyntheticPattern::GameMotion; return true; }
+    return false;
+}
+
+SyntheticSource::SyntheticSource(int width, int height, int fps, size_t bufferCount,
+                                 SyntheticPattern pattern, uint32_t seed)
+    : FrameSource(width, height, fps, bufferCount), pattern(pattern), seed(seed),
+      rngState(0), frameNumber(0), backgroundWidth(0) {
+}
+
+SyntheticSource::~SyntheticSource() {
+    Stop();
+}
+
+uint32_t SyntheticSource::nextRandom() {
+    // xorshift64*, deterministic for a given seed
+    rngState ^= rngState >> 12;
+    rngState ^= rngState << 25;
+    rngState ^= rngState >> 27;
+    return (uint32_t)((rngState * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+bool SyntheticSource::Initialize() {
+    if (!FrameSource::Initialize()) return false;
+
+    rngState = 0x9E3779B97F4A7C15ULL ^ seed;
+    frameNumber = 0;
+
+    if (pattern == SyntheticPattern::Noise) return true;
+
+    // Background strip twice the frame width so scrolling can wrap with two row copies.
+    // Content mixes flat areas, gradients and fine detail like a real desktop or game scene.
+    backgroundWidth = (pattern == SyntheticPattern::Static) ? width : width * 2;
+    background.resize(static_cast<size_t>(backgroundWidth) * height * 4);
+
+    std::vector<uint32_t> barColors(16);
+    for (auto& c : barColors) c = nextRandom() | 0xFF000000u;
+    int barWidth = std::max(1, backgroundWidth / 16);
+
+    for (int y = 0; y < height; ++y) {
+        uint8_t* row = background.data() + static_cast<size_t>(y) * backgroundWidth * 4;
+        for (int x = 0; x < backgroundWidth; ++x) {
+            uint32_t c = barColors[(x / barWidth) & 15];
+            uint8_t b = (uint8_t)(c & 0xFF), g = (uint8_t)((c >> 8) & 0xFF), r = (uint8_t)((c >> 16) & 0xFF);
+            // vertical gradient
+            int shade = (y * 96) / std::max(1, height);
+            b = (uint8_t)std::max(0, b - shade);
+            g = (uint8_t)std::max(0, g - shade);
+            r = (uint8_t)std::max(0, r - shade);
+            // fine checker detail in every other bar
+            if (((x / barWidth) & 1) && (((x >> 2) ^ (y >> 2)) & 1)) {
+                b ^= 0x40; g ^= 0x40; r ^= 0x40;
+            }
+            row[x * 4 + 0] = b;
+            row[x * 4 + 1] = g;
+            row[x * 4 + 2] = r;
+            row[x * 4 + 3] = 0xFF;
+        }
+    }
+    return true;
+}
+
+bool SyntheticSource::CaptureFrame(uint8_t* dst) {
+    switch (pattern) {
+    case SyntheticPattern::Scroll:
+        renderScroll(dst);
+        break;
+    case SyntheticPattern::Noise:
+        renderNoise(dst);
+        break;
+    case SyntheticPattern::Static:
+        memcpy(dst, background.data(), frameSize);
+        break;
+    case SyntheticPattern::GameMotion:
+        renderGameMotion(dst);
+        break;
+    }
+    ++frameNumber;
+    return true;
+}
+
+void SyntheticSource::renderScroll(uint8_t* dst) {
+    int speed = (pattern == SyntheticPattern::Scroll) ? 8 : 2; // pixels per frame
+    int offset = (int)((frameNumber * (uint64_t)speed) % (uint64_t)backgroundWidth);
+    int firstRun = std::min(width, backgroundWidth - offset);
+    size_t rowBytes = static_cast<size_t>(width) * 4;
+    for (int y = 0; y < height; ++y) {
+        const uint8_t* src = background.data() + static_cast<size_t>(y) * backgroundWidth * 4;
+        uint8_t* out = dst + y * rowBytes;
+        memcpy(out, src + static_cast<size_t>(offset) * 4, static_cast<size_t>(firstRun) * 4);
+        if (firstRun < width) memcpy(out + static_cast<size_t>(firstRun) * 4, src, static_cast<size_t>(width - firstRun) * 4);
+    }
+}
+
+void SyntheticSource::renderNoise(uint8_t* dst) {
+    size_t words = frameSize / 4;
+    uint32_t* px = reinterpret_cast<uint32_t*>(dst);
+    for (size_t i = 0; i < words; ++i) px[i] = nextRandom() | 0xFF000000u;
+}
+
+void SyntheticSource::fillRect(uint8_t* dst, int x, int y, int w, int h, uint32_t bgra) {
+    int x0 = std::max(0, x), y0 = std::max(0, y);
+    int x1 = std::min(width, x + w), y1 = std::min(height, y + h);
+    for (int yy = y0; yy < y1; ++yy) {
+        uint32_t* row = reinterpret_cast<uint32_t*>(dst + static_cast<size_t>(yy) * width * 4);
+        std::fill(row + x0, row + std::max(x0, x1), bgra);
+    }
+}
+
+void SyntheticSource::renderGameMotion(uint8_t* dst) {
+    renderScroll(dst);
+
+    // Sprites bouncing on triangle-wave paths; positions depend only on the frame number
+    const int spriteCount = 8;
+    int spriteSize = std::max(8, height / 10);
+    for (int i = 0; i < spriteCount; ++i) {
+        uint64_t t = frameNumber * (uint64_t)(3 + i * 2);
+        int spanX = std::max(1, width - spriteSize);
+        int spanY = std::max(1, height - spriteSize);
+        int px = (int)((t + (uint64_t)i * 97) % (uint64_t)(2 * spanX));
+        int py = (int)((t * 2 / 3 + (uint64_t)i * 53) % (uint64_t)(2 * spanY));
+        if (px >= spanX) px = 2 * spanX - px;
+        if (py >= spanY) py = 2 * spanY - py;
+        uint32_t color = 0xFF000000u | (0x3050F0u * (uint32_t)(i + 1));
+        fillRect(dst, px, py, spriteSize, spriteSize, color);
+    }
+
+    // Particle burst: small noisy region that changes every frame
+    int burst = std::max(8, height / 8);
+    int bx = width / 2 - burst / 2, by = height / 3;
+    for (int y = 0; y < burst && by + y < height; ++y) {
+        uint32_t* row = reinterpret_cast<uint32_t*>(dst + static_cast<size_t>(by + y) * width * 4);
+        for (int x = 0; x < burst && bx + x < width; ++x) {
+            if (bx + x >= 0 && (nextRandom() & 3) == 0) row[bx + x] = 0xFFFFFFFFu;
+        }
+    }
+
+    // Static HUD bar along the bottom
+    int hudHeight = std::max(4, height / 12);
+    fillRect(dst, 0, height - hudHeight, width, hudHeight, 0xFF202020u);
+    fillRect(dst, hudHeight / 2, height - hudHeight + hudHeight / 4, width / 4, hudHeight / 2, 0xFF20C040u);
+}
@@ -0,0 +1,48 @@
+#ifndef SYNTHETIC_SOURCE_H
+#define SYNTHETIC_SOURCE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "frame_source.h"
+
+enum class SyntheticPattern {
+    Scroll,     // bars and gradients scrolling horizontally (camera pan)
+    Noise,      // per-pixel random noise, worst case for the encoder
+    Static,     // one fixed image repeated (idle desktop)
+    GameMotion  // slowly panning background, moving sprites and a static HUD
+};
+
+// Parse "scroll", "noise", "static" or "game"; returns false on unknown names
+bool parseSyntheticPattern(const std::string& name, SyntheticPattern& out);
+
+// Deterministic generated frames so the pipeline can run headless and repeatably.
+// The same seed, pattern and size always produce the same sequence of frames.
+class SyntheticSource : public FrameSource {
+public:
+    SyntheticSource(int width, int height, int fps = 30, size_t bufferCount = 4,
+                    SyntheticPattern pattern = SyntheticPattern::GameMotion, uint32_t seed = 1);
+    ~SyntheticSource();
+
+    bool Initialize() override;
+
+protected:
+    bool CaptureFrame(uint8_t* dst) override;
+
+private:
+    void renderScroll(uint8_t* dst);
+    void renderNoise(uint8_t* dst);
+    void renderGameMotion(uint8_t* dst);
+    void fillRect(uint8_t* dst, int x, int y, int w, int h, uint32_t bgra);
+    uint32_t nextRandom();
+
+    SyntheticPattern pattern;
+    uint32_t seed;
+    uint64_t rngState;
+    uint64_t frameNumber;
+    std::vector<uint8_t> background; // pre-rendered static image / wide scroll strip
+    int backgroundWidth;
+};
+
+#endif // SYNTHETIC_SOURCE_H
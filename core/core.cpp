@@ -1,51 +1,271 @@
 #include "core.h"
-#include "capture/gdi_capture.h"
-#include "capture/hook_present.h"
-#include "encode/mjpeg.h"
-#include "audio/wasapi_capture.h"
+#include "encode/encoder_pool.h"
 #include "io/writer.h"
-#include "io/avi_mux.h"
+#include "io/muxer.h"
+#include "io/av_interleaver.h"
 #include "util/timing.h"
 #include "util/arena_alloc.h"
+#include <algorithm>
 #include <chrono>
+#include <cstdio>
 #include <iostream>
 
+#ifdef _WIN32
+#include "capture/gdi_capture.h"
+#include "capture/hook_present.h"
+#include "audio/wasapi_capture.h"
+#endif
+
 static uint64_t now_ms() {
     using namespace std::chrono;
-    return (uint64_t)duration_cast<milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    return (uint64_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
 }
 
 // Implementation of Core (was previously ScreenRecorder)
 Core::Core()
-    : gdiCapture(nullptr), hookPresent(nullptr), mjpegEncoder(nullptr), aviMux(nullptr), audioCapture(nullptr),
-      captureToEncodeRing(nullptr), encodeToWriterRing(nullptr), audioRing(nullptr), running(false),
-      cfgWidth(1280), cfgHeight(720), cfgFps(30), cfgBufferCount(4) {}
+    : frameSource(nullptr), hookPresent(nullptr), encoderPool(nullptr), muxer(nullptr), audioCapture(nullptr),
+      interleaver(nullptr), captureToEncodeRing(nullptr), encodeToWriterRing(nullptr), audioRing(nullptr),
+      videoBufferPool(nullptr), audioBufferPool(nullptr), running(false), writeFailed(false), startedUs(0),
+      ladder(nullptr), ladderLevel(0), ladderTransitions(0),
+      cfgWidth(1280), cfgHeight(720), cfgFps(30), cfgScaleFilter(ScaleFilter::Area), cfgVideoCodec(VideoCodec::Mjpeg),
+      cfgFrameMemoryBudget(64u * 1024u * 1024u), cfgOverflowPolicy(OverflowPolicy::DropOldest), cfgEncoderThreads(0), cfgEncoderSlices(1), cfgSkipRepeatedFrames(true), cfgAbbreviatedJpeg(false),
+      cfgContainer(ContainerFormat::Avi), cfgWriterBackend(WriterBackend::Threaded), cfgWriterBuffers(3), cfgCheckpointMs(2000), cfgSegmentBytes(0),
+      cfgInterleaveWindowMs(250), cfgInterleaveGranularityMs(0), cfgStatsIntervalMs(1000) {}
 
 Core::~Core() {
     stop();
 }
 
-bool Core::initialize(int width, int height, int fps) {
-    cfgWidth = width;
-    cfgHeight = height;
+void Core::setEncoderThreads(int threads) {
+    cfgEncoderThreads = threads;
+}
+
+void Core::setEncoderSlices(int slices) {
+    cfgEncoderSlices = slices;
+}
+
+void Core::setSkipRepeatedFrames(bool enabled) {
+    cfgSkipRepeatedFrames = enabled;
+}
+
+void Core::setAbbreviatedJpeg(bool enabled) {
+    cfgAbbreviatedJpeg = enabled;
+}
+
+void Core::setVideoCodec(VideoCodec codec) {
+    cfgVideoCodec = codec;
+}
+
+void Core::setRateControl(const RateControlOptions& options) {
+    cfgRateControl = options;
+}
+
+void Core::setScaleFilter(ScaleFilter filter) {
+    cfgScaleFilter = filter;
+}
+
+void Core::setFrameMemoryBudget(size_t bytes) {
+    cfgFrameMemoryBudget = bytes;
+}
+
+void Core::setOverflowPolicy(OverflowPolicy policy) {
+    cfgOverflowPolicy = policy;
+}
+
+void Core::setInterleaveOptions(uint32_t latencyWindowMs, uint32_t granularityMs) {
+    cfgInterleaveWindowMs = latencyWindowMs;
+    cfgInterleaveGranularityMs = granularityMs;
+}
+
+void Core::setDegradationLadder(const std::vector<DegradationStep>& steps, const DegradationThresholds& thresholds) {
+    cfgLadder = steps;
+    cfgLadderThresholds = thresholds;
+}
+
+void Core::setContainerFormat(ContainerFormat format) {
+    cfgContainer = format;
+}
+
+void Core::setDiskWriter(WriterBackend backend, int buffers) {
+    cfgWriterBackend = backend;
+    cfgWriterBuffers = buffers;
+}
+
+void Core::setCheckpointInterval(uint32_t ms) {
+    cfgCheckpointMs = ms;
+}
+
+void Core::setSegmentSize(uint64_t bytes) {
+    cfgSegmentBytes = bytes;
+}
+
+void Core::setStatsDump(const std::string& path, uint32_t intervalMs) {
+    cfgStatsPath = path;
+    cfgStatsIntervalMs = intervalMs > 0 ? intervalMs : 1000;
+}
+
+bool Core::hasFailed() const { return writeFailed.load(); }
+
+PipelineStats Core::getStats() const {
+    PipelineStats s = PipelineStats();
+    std::lock_guard<std::mutex> lock(statsMutex);
+    if (!running.load() || !frameSource || !encoderPool || !interleaver || !muxer) return s;
+
+    s.uptimeSec = (double)(telemetry_now_us() - startedUs) / 1e6;
+
+    s.framesCaptured = frameSource->getCapturedFrames();
+    s.framesDropped = frameSource->getDroppedFrames();
+    s.ticksMissed = frameSource->getMissedTicks();
+    s.captureUs = frameSource->getCaptureTimeHistogram().snapshot();
+
+    EncoderPoolTelemetry enc = encoderPool->getTelemetry();
+    s.framesEncoded = enc.framesEncoded;
+    s.framesRepeated = enc.framesRepeated;
+    s.captureToEncodeUs = enc.queueWaitUs;
+    s.encodeUs = enc.encodeUs;
+    s.encodedBytes = enc.encodedBytes;
+
+    AVInterleaverStats il = interleaver->getStats();
+    s.videoChunks = il.videoChunks;
+    s.gapChunks = il.gapChunks;
+    s.audioChunks = il.audioChunks;
+    s.lateChunks = il.lateChunks;
+    s.muxWriteUs = interleaver->getMuxWriteHistogram().snapshot();
+    s.endToEndUs = interleaver->getEndToEndHistogram().snapshot();
+
+    WriterStats disk = muxer->getWriterStats();
+    s.diskBytesWritten = disk.bytesWritten;
+    s.diskStalls = disk.stalls;
+    s.diskStallUs = disk.stallUs;
+    s.diskWriteUs = disk.writeUs;
+
+    // capture drops frames (pool overflow or ticket ring full); the encoders block on a
+    // full writer ring instead of dropping; audio capture drops whatever does not fit
+    s.captureToEncode.depth = captureToEncodeRing->size();
+    s.captureToEncode.capacity = captureToEncodeRing->capacity();
+    s.captureToEncode.fullEvents = captureToEncodeRing->full_events();
+    s.captureToEncode.drops = s.framesDropped;
+
+    s.encodeToWriter.depth = encodeToWriterRing->size();
+    s.encodeToWriter.capacity = encodeToWriterRing->capacity();
+    s.encodeToWriter.fullEvents = encodeToWriterRing->full_events();
+    s.encodeToWriter.drops = 0;
+
+    s.audio.depth = audioRing->size();
+    s.audio.capacity = audioRing->capacity();
+    s.audio.fullEvents = audioRing->full_events();
+    s.audio.drops = s.audio.fullEvents;
+    s.audioPacketsDropped = s.audio.drops;
+
+    s.degradationLevel = ladderLevel.load();
+    s.degradationTransitions = ladderTransitions.load();
+    s.fps = frameSource->getFps();
+    s.downscale = frameSource->getCaptureDownscale();
+    s.encoderThreads = encoderPool->getActiveThreads();
+
+    RateControlStats rc;
+    s.videoQuality = encoderPool->getQuality();
+    if (encoderPool->getRateControlStats(rc)) {
+        s.targetBytesPerSec = rc.targetBytesPerSec;
+        s.achievedBytesPerSec = rc.achievedBytesPerSec;
+        s.recentBytesPerSec = rc.recentBytesPerSec;
+    }
+    return s;
+}
+
+void Core::dumpStats() {
+    if (cfgStatsPath.empty()) return;
+    FILE* f = fopen(cfgStatsPath.c_str(), "a");
+    if (!f) return;
+    std::string line = statsToJson(getStats());
+    fprintf(f, "%s\n", line.c_str());
+    fclose(f);
+}
+
+bool Core::initialize(int width, int height, int fps, FrameSource* source) {
     cfgFps = fps;
 
+    // The source defines the captured frame geometry; the encoder scales it to the
+    // recorded size when the two differ
+    int captureWidth = 0;
+    int captureHeight = 0;
+    if (source) {
+        captureWidth = source->getWidth();
+        captureHeight = source->getHeight();
+        source->setFps(cfgFps);
+    } else {
+#ifdef _WIN32
+        if (!GDICapture::getScreenSize(captureWidth, captureHeight)) {
+            std::cerr << "Failed to query the screen size" << std::endl;
+            return false;
+        }
+#else
+        std::cerr << "No desktop capture on this platform; supply a FrameSource" << std::endl;
+        return false;
+#endif
+    }
+    cfgWidth = width > 0 ? width : captureWidth;
+    cfgHeight = height > 0 ? height : captureHeight;
+
+    int baseThreads = (cfgEncoderThreads > 0) ? cfgEncoderThreads : EncoderPool::defaultThreadCount();
+    if (cfgLadder.empty()) {
+        // last resort on the default ladder: all but one core, at most 8 workers
+        int hw = (int)std::thread::hardware_concurrency();
+        int maxThreads = std::max(baseThreads, std::min(8, hw - 1));
+        ladderSteps = DegradationLadder::buildDefault(cfgFps, baseThreads, maxThreads);
+    } else {
+        ladderSteps = cfgLadder;
+    }
+    // the pool is built for the busiest rung; the others park workers
+    int encoderThreads = DegradationLadder(ladderSteps).maxEncoderThreads();
+
+    // Frame slots from the memory budget: every encoder worker can hold one while the
+    // capture thread fills another, plus at least one queued
+    size_t frameSize = static_cast<size_t>(captureWidth) * static_cast<size_t>(captureHeight) * 4;
+    size_t frameSlots = FramePool::slotsForBudget(frameSize, cfgFrameMemoryBudget, (size_t)encoderThreads + 2, 64);
+
+    // Ticket ring with room for stale DropOldest tickets next to every live one
+    size_t ticketCapacity = 1;
+    while (ticketCapacity < frameSlots * 2 + 1) ticketCapacity <<= 1;
+
     // allocate rings and components
-    captureToEncodeRing = new SPSC_Ring<int>(cfgBufferCount * 2);
+    captureToEncodeRing = new SPSC_Ring<FrameTicket>(ticketCapacity);
     encodeToWriterRing = new SPSC_Ring<VideoPacket>(32);
     audioRing = new SPSC_Ring<AudioPacket>(64);
 
-    gdiCapture = new GDICapture(cfgWidth, cfgHeight, cfgFps, cfgBufferCount);
-    if (!gdiCapture->Initialize()) return false;
-
-    mjpegEncoder = new MJPEGEncoder(cfgWidth, cfgHeight);
+    // enough buffers for full rings plus the ones being filled or written
+    videoBufferPool = new PacketBufferPool(32 + (size_t)encoderThreads * 3 + 1);
+    audioBufferPool = new PacketBufferPool(64 + 2);
 
+    if (source) {
+        frameSource = source;
+    } else {
+#ifdef _WIN32
+        frameSource = new GDICapture(captureWidth, captureHeight, cfgFps, frameSlots);
+#endif
+    }
+    frameSource->setBufferCount(frameSlots);
+    frameSource->setOverflowPolicy(cfgOverflowPolicy);
+    frameSource->setFingerprinting(cfgSkipRepeatedFrames);
+    if (!frameSource->Initialize()) return false;
+
+    encoderPool = new EncoderPool(cfgWidth, cfgHeight, encoderThreads);
+    encoderPool->setScaleFilter(cfgScaleFilter);
+    encoderPool->setCodec(cfgVideoCodec);
+    encoderPool->setBufferPool(videoBufferPool);
+    encoderPool->setSlicesPerFrame(cfgEncoderSlices);
+    encoderPool->setAbbreviatedJpeg(cfgAbbreviatedJpeg);
+    encoderPool->setRateControl(cfgRateControl);
+    applyStep(ladderSteps.front());
+
+#ifdef _WIN32
     audioCapture = new WASAPICapture();
     if (!audioCapture->Initialize()) {
         std::cerr << "Failed to initialize WASAPI capture" << std::endl;
         // audio optional; continue without audio
         delete audioCapture; audioCapture = nullptr;
     }
+#endif
 
     // Do not open AVI mux here; open when start() is called with filename
 
@@ -55,164 +275,178 @@ bool Core::initialize(int width, int height, int fps) {
 bool Core::start(const std::string& outFilename) {
     if (running.load()) return false;
 
-    aviMux = new AVIMux(outFilename.c_str());
-    if (!aviMux->open()) {
-        std::cerr << "Failed to open AVI mux output file" << std::endl;
-        delete aviMux; aviMux = nullptr;
-        return false;
-    }
-
+    // stream parameters first: open() writes them into the headers
+    muxer = createMuxer(cfgContainer, outFilename);
+#ifdef _WIN32
     if (audioCapture) {
-        aviMux->setAudioParameters(audioCapture->getSampleRate(), audioCapture->getChannels(), audioCapture->getBlockAlign(), 16);
+        muxer->setAudioParameters(audioCapture->getSampleRate(), audioCapture->getChannels(), audioCapture->getBlockAlign(), 16);
+    }
+#endif
+    muxer->setVideoParameters(cfgWidth, cfgHeight, cfgFps, videoCodecFourCC(cfgVideoCodec));
+    muxer->setWriterBackend(cfgWriterBackend, cfgWriterBuffers);
+    muxer->setCheckpointInterval(cfgCheckpointMs);
+    if (cfgSegmentBytes > 0) muxer->setSegmentSize(cfgSegmentBytes);
+    if (!muxer->open()) {
+        std::cerr << "Failed to open output file " << outFilename << std::endl;
+        delete muxer; muxer = nullptr;
+        return false;
     }
-    aviMux->setVideoParameters(cfgWidth, cfgHeight, cfgFps);
 
     running.store(true);
+    writeFailed.store(false);
+
+    ladder = new DegradationLadder(ladderSteps, cfgLadderThresholds);
+    ladderLevel.store(0);
+    ladderTransitions.store(0);
+    applyStep(ladder->current());
 
     // Start capturing frames and audio
-    if (!gdiCapture->Start(captureToEncodeRing)) {
-        std::cerr << "Failed to start GDI capture" << std::endl;
+    if (!frameSource->Start(captureToEncodeRing)) {
+        std::cerr << "Failed to start frame capture" << std::endl;
+        std::lock_guard<std::mutex> lock(statsMutex);
         running.store(false);
+        delete ladder; ladder = nullptr;
+        // stop() does nothing once running is false; release the open file here
+        muxer->close();
+        delete muxer; muxer = nullptr;
         return false;
     }
 
+#ifdef _WIN32
     if (audioCapture) {
+        audioCapture->setBufferPool(audioBufferPool);
         audioCapture->Start(audioRing);
     }
+#endif
+
+    // start encoder workers and writer thread
+    {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        interleaver = new AVInterleaver(muxer, videoBufferPool, audioBufferPool, audioCapture != nullptr);
+        interleaver->setLatencyWindowMs(cfgInterleaveWindowMs);
+        interleaver->setGranularityMs(cfgInterleaveGranularityMs);
+        // the AVI plays at cfgFps whatever the capture rate is now; keep video on its clock
+        interleaver->setFrameRate((uint32_t)cfgFps);
+        startedUs = telemetry_now_us();
+    }
 
-    // start encoder and writer threads
-    encoderThread = std::thread(&Core::encoderLoop, this);
+    encoderPool->Start(frameSource, captureToEncodeRing, encodeToWriterRing);
     writerThread = std::thread(&Core::writerLoop, this);
 
-    // Start a monitor thread to observe queue fill and perform fallback logic
-    std::thread([this]() {
-        using namespace std::chrono;
-        const double highThreshold = 0.75; // 75%
-        const double lowThreshold = 0.25;  // 25%
-        milliseconds highDuration(800);
-        milliseconds lowDuration(5000);
-
-        auto highStart = steady_clock::time_point();
-        auto lowStart = steady_clock::time_point();
-
-        bool currentlyLowered = (cfgFps <= 30);
-
-        while (running.load()) {
-            double fill = captureToEncodeRing->fillFactor();
-
-            auto now = steady_clock::now();
-            if (fill >= highThreshold) {
-                if (highStart == steady_clock::time_point()) highStart = now;
-                if (!currentlyLowered && now - highStart >= highDuration) {
-                    std::cout << "Queue >75% for 800ms, lowering FPS to 30" << std::endl;
-                    gdiCapture->setFps(30);
-                    currentlyLowered = true;
-                }
-            } else {
-                highStart = steady_clock::time_point();
-            }
-
-            if (fill <= lowThreshold) {
-                if (lowStart == steady_clock::time_point()) lowStart = now;
-                if (currentlyLowered && now - lowStart >= lowDuration) {
-                    // Only recover to original higher fps if original cfgFps was higher
-                    if (cfgFps > 30) {
-                        std::cout << "Queue <25% for 5s, restoring FPS to " << cfgFps << std::endl;
-                        gdiCapture->setFps(cfgFps);
-                        currentlyLowered = false;
-                    }
-                }
-            } else {
-                lowStart = steady_clock::time_point();
-            }
-
-            std::this_thread::sleep_for(milliseconds(100));
-        }
-    }).detach();
+    // Monitor thread: degradation ladder and periodic stats dump
+    monitorThread = std::thread(&Core::monitorLoop, this);
 
     return true;
 }
 
+void Core::applyStep(const DegradationStep& step) {
+    frameSource->setFps(step.fps);
+    encoderPool->setFrameRate(step.fps);
+    frameSource->setCaptureDownscale(step.downscale);
+    encoderPool->setActiveThreads(step.encoderThreads);
+}
+
+// Feed encode time and queue occupancy to the degradation ladder every 100 ms and apply
+// its transitions; also writes the periodic stats lines
+void Core::monitorLoop() {
+    using namespace std::chrono;
+    const milliseconds tick(100);
+    auto nextDump = steady_clock::now() + milliseconds(cfgStatsIntervalMs);
+
+    uint64_t lastFrames = 0, lastEncodeUs = 0;
+    encoderPool->getEncodeTotals(lastFrames, lastEncodeUs);
+
+    while (running.load()) {
+        std::this_thread::sleep_for(tick);
+        if (!running.load()) break;
+
+        uint64_t frames, encodeUs;
+        encoderPool->getEncodeTotals(frames, encodeUs);
+        DegradationSample sample;
+        sample.encodeMsPerFrame = (frames > lastFrames)
+            ? (double)(encodeUs - lastEncodeUs) / 1000.0 / (double)(frames - lastFrames) : -1.0;
+        sample.backlog = frameSource->getFramePool().fillFactor();
+        sample.writerFill = encodeToWriterRing->fillFactor();
+        lastFrames = frames;
+        lastEncodeUs = encodeUs;
+
+        // after a write failure the backlog says nothing about encode speed
+        DegradationTransition t;
+        if (!writeFailed.load() && ladder->update(sample, now_ms(), t)) {
+            applyStep(t.step);
+            ladderLevel.store((uint32_t)t.toLevel);
+            ladderTransitions.fetch_add(1);
+            std::cout << "Pipeline " << t.describe() << std::endl;
+        }
+
+        auto now = steady_clock::now();
+        if (now >= nextDump) {
+            dumpStats();
+            nextDump += milliseconds(cfgStatsIntervalMs);
+            if (nextDump < now) nextDump = now + milliseconds(cfgStatsIntervalMs);
+        }
+    }
+}
+
 void Core::stop() {
     if (!running.load()) return;
+    // final stats line while every component is still alive
+    dumpStats();
     running.store(false);
+    if (monitorThread.joinable()) monitorThread.join();
 
-    if (gdiCapture) gdiCapture->Stop();
+    if (frameSource) frameSource->Stop();
+#ifdef _WIN32
     if (audioCapture) audioCapture->Stop();
-    if (encoderThread.joinable()) encoderThread.join();
+#endif
+    if (encoderPool) encoderPool->Stop();
     if (writerThread.joinable()) writerThread.join();
 
-    if (aviMux) {
-        aviMux->close();
-        delete aviMux; aviMux = nullptr;
+    // every thread is stopped; wait out a getStats() still reading what is deleted below
+    std::lock_guard<std::mutex> lock(statsMutex);
+    if (interleaver) { delete interleaver; interleaver = nullptr; }
+    if (ladder) { delete ladder; ladder = nullptr; }
+
+    if (muxer) {
+        muxer->close();
+        delete muxer; muxer = nullptr;
     }
 
-    if (mjpegEncoder) { delete mjpegEncoder; mjpegEncoder = nullptr; }
-    if (gdiCapture) { delete gdiCapture; gdiCapture = nullptr; }
+    if (encoderPool) { delete encoderPool; encoderPool = nullptr; }
+    if (frameSource) { delete frameSource; frameSource = nullptr; }
     if (captureToEncodeRing) { delete captureToEncodeRing; captureToEncodeRing = nullptr; }
     if (encodeToWriterRing) { delete encodeToWriterRing; encodeToWriterRing = nullptr; }
     if (audioRing) { delete audioRing; audioRing = nullptr; }
+    if (videoBufferPool) { delete videoBufferPool; videoBufferPool = nullptr; }
+    if (audioBufferPool) { delete audioBufferPool; audioBufferPool = nullptr; }
+#ifdef _WIN32
     if (audioCapture) { delete audioCapture; audioCapture = nullptr; }
-}
-
-void Core::encoderLoop() {
-    int index;
-    while (running.load()) {
-        if (captureToEncodeRing->pop(index)) {
-            const uint8_t* frame = gdiCapture->getFrameBuffer((size_t)index);
-            if (frame) {
-                VideoPacket pkt;
-                pkt.pts_ms = now_ms();
-                mjpegEncoder->encodeFrame(frame, pkt.data);
-                // push to writer ring (try until space or shutdown)
-                while (running.load() && !encodeToWriterRing->push(pkt)) {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
-                }
-            }
-        } else {
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
-        }
-    }
+#endif
 }
 
 void Core::writerLoop() {
-    VideoPacket v;
-    AudioPacket a;
 
-    // simple interleave based on pts_ms
-    while (running.load()) {
-        bool haveV = encodeToWriterRing->pop(v);
-        bool haveA = audioRing && audioRing->pop(a);
-
-        if (haveV && haveA) {
-            if (v.pts_ms <= a.pts_ms) {
-                aviMux->writeVideoFrame(v.data.data(), v.data.size());
-                // push back audio to ring for next iteration
-                audioRing->push(a);
-            } else {
-                aviMux->writeAudioSamples(a.data.data(), a.data.size());
-                // push back video
-                encodeToWriterRing->push(v);
-            }
-            continue;
-        }
+    // Sleep on the video ring when idle. Audio arrives every ~10 ms without waking this
+    // thread, so with audio the wait is short enough that its ring never backs up.
+    const std::chrono::milliseconds idleWait(audioCapture ? 5 : 50);
 
-        if (haveV) {
-            aviMux->writeVideoFrame(v.data.data(), v.data.size());
-            continue;
-        }
-        if (haveA) {
-            aviMux->writeAudioSamples(a.data.data(), a.data.size());
-            continue;
-        }
-
-        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    while (running.load()) {
+        bool got = interleaver->pull(*encodeToWriterRing, audioRing);
+        interleaver->emit(now_ms());
+        if (interleaver->failed()) break;
+        if (!got) encodeToWriterRing->wait_not_empty(idleWait);
     }
 
-    while (audioRing && audioRing->pop(a)) {
-        aviMux->writeAudioSamples(a.data.data(), a.data.size());
-    }
-    while (encodeToWriterRing->pop(v)) {
-        aviMux->writeVideoFrame(v.data.data(), v.data.size());
+    // The muxer refused a write. Stop pulling: encoders then block on the full ring and
+    // capture drops its frames, instead of encoding into a file that no longer grows.
+    // What is still queued is freed with the rings at stop().
+    if (interleaver->failed()) {
+        writeFailed.store(true);
+        std::cerr << "Writing the recording failed (disk full or I/O error); recording stopped" << std::endl;
+        return;
     }
-}
\ No newline at end of file
+
+    // Encoder workers and audio capture have stopped; write out what is left in order
+    interleaver->pull(*encodeToWriterRing, audioRing);
+    interleaver->flush();
+}
@@ -1,65 +1,194 @@
 #ifndef CORE_H
 #define CORE_H
 
-#include "capture/gdi_capture.h"
-#include "capture/hook_present.h"
+#include "capture/frame_source.h"
 #include "encode/mjpeg.h"
+#include "encode/encoder_pool.h"
 #include "encode/delta_tiles.h"
-#include "io/avi_mux.h"
+#include "io/muxer.h"
 #include "io/writer.h"
-#include "audio/wasapi_capture.h"
 #include "util/spsc_ring.h"
 #include "util/timing.h"
 #include "util/arena_alloc.h"
+#include "util/telemetry.h"
+#include "util/degradation_ladder.h"
 #include "io/packets.h"
 
 #include <thread>
 #include <atomic>
+#include <mutex>
 #include <vector>
 #include <string>
 
+// Platform-specific components are only referenced through pointers here so the
+// pipeline builds without the Windows SDK (see core.cpp).
+class HookPresent;
+class WASAPICapture;
+class AVInterleaver;
+
 class Core {
 public:
     Core();
     ~Core();
 
-    // Initialize core subsystems. width/height in pixels, fps 30/60
-    bool initialize(int width, int height, int fps = 30);
+    // Initialize core subsystems. width/height: recorded size in pixels (<= 0 records at
+    // the capture size), fps 30/60.
+    // source: optional frame source (Core takes ownership). When null the GDI desktop
+    // capture is used at the full screen size; on platforms without GDI a source must be
+    // supplied. Frames of another size than the recorded one are resampled (setScaleFilter).
+    bool initialize(int width, int height, int fps = 30, FrameSource* source = nullptr);
 
-    // Start capture/encode/write pipeline, provide output filename for AVI
+    // Start capture/encode/write pipeline, provide output filename (see setContainerFormat)
     bool start(const std::string& outFilename);
 
     // Stop pipeline and flush
     void stop();
 
+    // Number of parallel MJPEG encoder workers; call before initialize().
+    // 0 (default) picks EncoderPool::defaultThreadCount().
+    void setEncoderThreads(int threads);
+
+    // Stripes each frame is split into and encoded on in parallel (lower per-frame latency,
+    // each worker then uses this many threads); call before initialize(). Default 1.
+    void setEncoderSlices(int slices);
+
+    // Write frames identical to the one before as empty chunks instead of encoding them
+    // (fingerprinted on the capture thread); call before initialize(). Default on.
+    void setSkipRepeatedFrames(bool enabled);
+
+    // Write MJPEG frames in the abbreviated AVI1 form, without the standard Huffman tables
+    // every frame would otherwise repeat; call before initialize(). Default off.
+    void setAbbreviatedJpeg(bool enabled);
+
+    // Video codec of the recording (default Mjpeg); call before initialize()
+    void setVideoCodec(VideoCodec codec);
+
+    // Target-bitrate rate control for MJPEG (see RateController): quality follows the
+    // content to keep output near options.targetBytesPerSec, within the quality bounds.
+    // Target 0 (default) records at a fixed quality. Call before initialize().
+    void setRateControl(const RateControlOptions& options);
+
+    // Filter for resampling captured frames to the recorded size; call before
+    // initialize(). Default Area.
+    void setScaleFilter(ScaleFilter filter);
+
+    // Memory for captured frames; the frame pool gets as many slots as fit (at least
+    // encoder threads + 2). Call before initialize(). Default 64 MB.
+    void setFrameMemoryBudget(size_t bytes);
+
+    // What capture does when every frame slot is busy; default DropOldest
+    void setOverflowPolicy(OverflowPolicy policy);
+
+    // A/V interleaving in the writer (see AVInterleaver): how long a chunk may wait for the
+    // other stream (default 250 ms) and the pts bucket size chunks are grouped by (default
+    // 0 = strict pts order). Call before start().
+    void setInterleaveOptions(uint32_t latencyWindowMs, uint32_t granularityMs);
+
+    // Rungs the pipeline steps through when encoding cannot keep up (see DegradationLadder);
+    // the first rung is what recording starts with. Empty (default) builds the standard
+    // ladder from fps and encoder threads; a single rung disables degradation.
+    // Call before initialize().
+    void setDegradationLadder(const std::vector<DegradationStep>& steps,
+                              const DegradationThresholds& thresholds = DegradationThresholds());
+
+    // Container of the recording (default Avi); Matroska writes self-contained clusters
+    // front to back, with no index or header patching. Call before start().
+    void setContainerFormat(ContainerFormat format);
+
+    // How the recording is written to disk (see Writer): Threaded (default) hands full
+    // buffers to an I/O thread, Direct also bypasses the page cache, Mmap copies into a
+    // mapping of the file, Stdio writes on the writer thread. buffers: in flight for
+    // Threaded and Direct (default 3). Call before start().
+    void setDiskWriter(WriterBackend backend, int buffers = 3);
+
+    // How often the AVI headers are patched to cover what has been recorded so far, so a
+    // crash leaves a playable file (see AVIMux; recorder_recover rebuilds the rest). Default
+    // 2000 ms, 0 only at stop(). Only AVI patches its headers. Call before start().
+    void setCheckpointInterval(uint32_t ms);
+
+    // Size of the AVI's RIFF segments (see AVIMux::setSegmentSize; default 1 GB, at least
+    // 1 MB). Smaller segments make OpenDML files with many AVIX segments quickly, for
+    // testing players; 256 segments is the limit. Call before start().
+    void setSegmentSize(uint64_t bytes);
+
+    // Append a statsToJson() line to path every intervalMs while recording, plus a final
+    // one at stop(). Empty path disables. Call before start().
+    void setStatsDump(const std::string& path, uint32_t intervalMs = 1000);
+
+    // Live pipeline telemetry (latency histograms, counters, ring depths); callable from
+    // any thread, including while another one runs stop(). All zero when no recording is
+    // running.
+    PipelineStats getStats() const;
+
+    // True once writing the recording failed (disk full, I/O error). The writer then stops
+    // and capture frames are dropped until stop(), which still has to be called.
+    bool hasFailed() const;
+
 private:
     // pipeline components
-    GDICapture* gdiCapture;
+    FrameSource* frameSource;
     HookPresent* hookPresent; // optional high-end path (may be null)
-    MJPEGEncoder* mjpegEncoder;
-    AVIMux* aviMux;
+    EncoderPool* encoderPool;
+    Muxer* muxer;
     WASAPICapture* audioCapture;
+    AVInterleaver* interleaver; // owned by the writer thread while it runs
 
     // Lock-free rings
-    SPSC_Ring<int>* captureToEncodeRing;                // indices of frame buffers
+    SPSC_Ring<FrameTicket>* captureToEncodeRing;        // frame pool tickets
     SPSC_Ring<VideoPacket>* encodeToWriterRing;         // encoded JPEG frames with pts
     SPSC_Ring<AudioPacket>* audioRing;                  // raw PCM audio chunks with pts
 
+    // Payload buffers recycled from the writer back to the encoder and audio threads
+    PacketBufferPool* videoBufferPool;
+    PacketBufferPool* audioBufferPool;
+
     // Threads
-    std::thread encoderThread;
     std::thread writerThread;
+    std::thread monitorThread;
 
     std::atomic<bool> running;
+    std::atomic<bool> writeFailed; // set by the writer thread, see hasFailed()
+    uint64_t startedUs;
+    // Held by getStats() for its whole snapshot and by start()/stop() while they create or
+    // delete the components it reads, so a snapshot never sees one half built or freed
+    mutable std::mutex statsMutex;
+
+    // Degradation ladder, driven by the monitor thread
+    std::vector<DegradationStep> ladderSteps;
+    DegradationLadder* ladder;
+    std::atomic<uint32_t> ladderLevel;
+    std::atomic<uint64_t> ladderTransitions;
 
     // Internal thread funcs
-    void encoderLoop();
     void writerLoop();
+    void monitorLoop();
+    void dumpStats();
+    void applyStep(const DegradationStep& step);
 
     // configuration
-    int cfgWidth;
+    int cfgWidth;      // recorded
     int cfgHeight;
     int cfgFps;
-    size_t cfgBufferCount;
+    ScaleFilter cfgScaleFilter;
+    VideoCodec cfgVideoCodec;
+    RateControlOptions cfgRateControl;
+    size_t cfgFrameMemoryBudget;
+    OverflowPolicy cfgOverflowPolicy;
+    int cfgEncoderThreads;
+    int cfgEncoderSlices;
+    bool cfgSkipRepeatedFrames;
+    bool cfgAbbreviatedJpeg;
+    ContainerFormat cfgContainer;
+    WriterBackend cfgWriterBackend;
+    int cfgWriterBuffers;
+    uint32_t cfgCheckpointMs;
+    uint64_t cfgSegmentBytes; // 0: the muxer's default
+    uint32_t cfgInterleaveWindowMs;
+    uint32_t cfgInterleaveGranularityMs;
+    std::string cfgStatsPath;
+    uint32_t cfgStatsIntervalMs;
+    std::vector<DegradationStep> cfgLadder;
+    DegradationThresholds cfgLadderThresholds;
 };
 
 #endif // CORE_H
\ No newline at end of file
@@ -0,0 +1,284 @@
+#include "color_convert.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef RECORDER_X86
+#include <immintrin.h>
+#endif
+
+// JFIF (full-range BT.601) coefficients in Q15; each row sums to 32768 (Y) or 0 (Cb, Cr)
+static const int kYR = 9798, kYG = 19235, kYB = 3735;
+static const int kCbR = -5529, kCbG = -10855, kCbB = 16384;
+static const int kCrR = 16384, kCrG = -13720, kCrB = -2664;
+
+// Luma rounds at Q15; chroma works on the sum of a 2x2 block (Q17) with the +128 offset
+static const int kLumaRound = 1 << 14;
+static const int kChromaBias = (128 << 17) + (1 << 16);
+
+static int alignUp(int v, int a) { return (v + a - 1) / a * a; }
+
+YUV420Planes::YUV420Planes()
+    : width(0), height(0), chromaWidth(0), chromaHeight(0), yStride(0), cStride(0), paddedWidth(0), paddedHeight(0),
+      y(nullptr), cb(nullptr), cr(nullptr) {}
+
+void YUV420Planes::allocate(int w, int h) {
+    if (w == width && h == height && y) return;
+    width = w;
+    height = h;
+    chromaWidth = (w + 1) / 2;
+    chromaHeight = (h + 1) / 2;
+    paddedWidth = alignUp(w, 16);
+    paddedHeight = alignUp(h, 16);
+    yStride = alignUp(paddedWidth, 32);
+    cStride = alignUp(paddedWidth / 2, 32);
+
+    size_t ySize = (size_t)yStride * paddedHeight;
+    size_t cSize = (size_t)cStride * (paddedHeight / 2);
+    storage.assign(ySize + 2 * cSize + 32, 0);
+    // start the planes on a 32-byte boundary
+    uint8_t* base = storage.data();
+    base += (32 - (reinterpret_cast<uintptr_t>(base) & 31)) & 31;
+    y = base;
+    cb = y + ySize;
+    cr = cb + cSize;
+}
+
+static inline uint8_t clampByte(int v) {
+    return (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+static inline uint8_t lumaOf(const uint8_t* p) {
+    return (uint8_t)((kYR * p[2] + kYG * p[1] + kYB * p[0] + kLumaRound) >> 15);
+}
+
+// Columns [x, width) of one row pair; x must be even
+static void convertPairScalar(const uint8_t* row0, const uint8_t* row1, int x, int width,
+                              uint8_t* y0, uint8_t* y1, uint8_t* cb, uint8_t* cr) {
+    for (; x < width; x += 2) {
+        const uint8_t* p00 = row0 + (size_t)x * 4;
+        const uint8_t* p10 = row1 + (size_t)x * 4;
+        bool hasRight = x + 1 < width;
+        const uint8_t* p01 = hasRight ? p00 + 4 : p00;
+        const uint8_t* p11 = hasRight ? p10 + 4 : p10;
+
+        y0[x] = lumaOf(p00);
+        y1[x] = lumaOf(p10);
+        if (hasRight) {
+            y0[x + 1] = lumaOf(p01);
+            y1[x + 1] = lumaOf(p11);
+        }
+
+        int sb = p00[0] + p01[0] + p10[0] + p11[0];
+        int sg = p00[1] + p01[1] + p10[1] + p11[1];
+        int sr = p00[2] + p01[2] + p10[2] + p11[2];
+        cb[x / 2] = clampByte((kCbR * sr + kCbG * sg + kCbB * sb + kChromaBias) >> 17);
+        cr[x / 2] = clampByte((kCrR * sr + kCrG * sg + kCrB * sb + kChromaBias) >> 17);
+    }
+}
+
+#ifdef RECORDER_X86
+
+// Coefficients laid out for pmaddwd over BGRA words: (B,G) and (R,A) pairs per pixel
+#define PIXEL_COEFS(cb, cg, cr) (short)(cb), (short)(cg), (short)(cr), 0, (short)(cb), (short)(cg), (short)(cr), 0
+
+// 4 BGRA pixels -> their 4 weighted sums (int32)
+RECORDER_TARGET_SSE41 static inline __m128i weigh4(__m128i px, __m128i coef) {
+    __m128i lo = _mm_cvtepu8_epi16(px);
+    __m128i hi = _mm_unpackhi_epi8(px, _mm_setzero_si128());
+    return _mm_hadd_epi32(_mm_madd_epi16(lo, coef), _mm_madd_epi16(hi, coef));
+}
+
+// 4 pixels from each of two rows -> two 2x2 block sums as BGRA words [block0 | block1]
+RECORDER_TARGET_SSE41 static inline __m128i blockSums(__m128i r0, __m128i r1) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i lo = _mm_add_epi16(_mm_cvtepu8_epi16(r0), _mm_cvtepu8_epi16(r1));
+    __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(r0, zero), _mm_unpackhi_epi8(r1, zero));
+    return _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+}
+
+// Two blockSums() results -> 4 chroma values (int32)
+RECORDER_TARGET_SSE41 static inline __m128i chroma4(__m128i q0, __m128i q1, __m128i coef, __m128i bias) {
+    __m128i sums = _mm_hadd_epi32(_mm_madd_epi16(q0, coef), _mm_madd_epi16(q1, coef));
+    return _mm_srai_epi32(_mm_add_epi32(sums, bias), 17);
+}
+
+RECORDER_TARGET_SSE41 static void convertPairSSE41(const uint8_t* row0, const uint8_t* row1, int width,
+                                                   uint8_t* y0, uint8_t* y1, uint8_t* cb, uint8_t* cr) {
+    const __m128i yCoef = _mm_setr_epi16(PIXEL_COEFS(kYB, kYG, kYR));
+    const __m128i cbCoef = _mm_setr_epi16(PIXEL_COEFS(kCbB, kCbG, kCbR));
+    const __m128i crCoef = _mm_setr_epi16(PIXEL_COEFS(kCrB, kCrG, kCrR));
+    const __m128i round = _mm_set1_epi32(kLumaRound);
+    const __m128i bias = _mm_set1_epi32(kChromaBias);
+
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i a0 = _mm_loadu_si128((const __m128i*)(row0 + (size_t)x * 4));
+        __m128i a1 = _mm_loadu_si128((const __m128i*)(row0 + (size_t)x * 4 + 16));
+        __m128i b0 = _mm_loadu_si128((const __m128i*)(row1 + (size_t)x * 4));
+        __m128i b1 = _mm_loadu_si128((const __m128i*)(row1 + (size_t)x * 4 + 16));
+
+        __m128i ya = _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(weigh4(a0, yCoef), round), 15),
+                                     _mm_srai_epi32(_mm_add_epi32(weigh4(a1, yCoef), round), 15));
+        __m128i yb = _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(weigh4(b0, yCoef), round), 15),
+                                     _mm_srai_epi32(_mm_add_epi32(weigh4(b1, yCoef), round), 15));
+        __m128i yBytes = _mm_packus_epi16(ya, yb);
+        _mm_storel_epi64((__m128i*)(y0 + x), yBytes);
+        _mm_storel_epi64((__m128i*)(y1 + x), _mm_srli_si128(yBytes, 8));
+
+        __m128i q0 = blockSums(a0, b0);
+        __m128i q1 = blockSums(a1, b1);
+        __m128i c = _mm_packus_epi16(_mm_packs_epi32(chroma4(q0, q1, cbCoef, bias), chroma4(q0, q1, crCoef, bias)),
+                                     _mm_setzero_si128());
+        int cbWord = _mm_cvtsi128_si32(c);
+        int crWord = _mm_cvtsi128_si32(_mm_srli_si128(c, 4));
+        memcpy(cb + x / 2, &cbWord, 4);
+        memcpy(cr + x / 2, &crWord, 4);
+    }
+    convertPairScalar(row0, row1, x, width, y0, y1, cb, cr);
+}
+
+// 16 luma values of one row, in order
+RECORDER_TARGET_AVX2 static inline __m128i luma16AVX2(__m128i p0, __m128i p1, __m128i p2, __m128i p3,
+                                                      __m256i coef, __m256i round) {
+    // each madd covers 4 pixels: lane 0 holds pixels 0-1, lane 1 pixels 2-3
+    __m256i m0 = _mm256_madd_epi16(_mm256_cvtepu8_epi16(p0), coef);
+    __m256i m1 = _mm256_madd_epi16(_mm256_cvtepu8_epi16(p1), coef);
+    __m256i m2 = _mm256_madd_epi16(_mm256_cvtepu8_epi16(p2), coef);
+    __m256i m3 = _mm256_madd_epi16(_mm256_cvtepu8_epi16(p3), coef);
+    // h01 holds pixels 0 1 4 5 (lane 0) and 2 3 6 7 (lane 1); h23 the same plus 8
+    __m256i h01 = _mm256_srai_epi32(_mm256_add_epi32(_mm256_hadd_epi32(m0, m1), round), 15);
+    __m256i h23 = _mm256_srai_epi32(_mm256_add_epi32(_mm256_hadd_epi32(m2, m3), round), 15);
+    __m256i bytes = _mm256_packus_epi16(_mm256_packs_epi32(h01, h23), _mm256_setzero_si256());
+    // interleave the pixel pairs of both lanes back into 0..15
+    return _mm_unpacklo_epi16(_mm256_castsi256_si128(bytes), _mm256_extracti128_si256(bytes, 1));
+}
+
+RECORDER_TARGET_AVX2 static void convertPairAVX2(const uint8_t* row0, const uint8_t* row1, int width,
+                                                 uint8_t* y0, uint8_t* y1, uint8_t* cb, uint8_t* cr) {
+    const __m256i yCoef = _mm256_setr_epi16(PIXEL_COEFS(kYB, kYG, kYR), PIXEL_COEFS(kYB, kYG, kYR));
+    const __m256i round = _mm256_set1_epi32(kLumaRound);
+    const __m128i cbCoef = _mm_setr_epi16(PIXEL_COEFS(kCbB, kCbG, kCbR));
+    const __m128i crCoef = _mm_setr_epi16(PIXEL_COEFS(kCrB, kCrG, kCrR));
+    const __m128i bias = _mm_set1_epi32(kChromaBias);
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const uint8_t* r0 = row0 + (size_t)x * 4;
+        const uint8_t* r1 = row1 + (size_t)x * 4;
+        __m128i a0 = _mm_loadu_si128((const __m128i*)r0);
+        __m128i a1 = _mm_loadu_si128((const __m128i*)(r0 + 16));
+        __m128i a2 = _mm_loadu_si128((const __m128i*)(r0 + 32));
+        __m128i a3 = _mm_loadu_si128((const __m128i*)(r0 + 48));
+        __m128i b0 = _mm_loadu_si128((const __m128i*)r1);
+        __m128i b1 = _mm_loadu_si128((const __m128i*)(r1 + 16));
+        __m128i b2 = _mm_loadu_si128((const __m128i*)(r1 + 32));
+        __m128i b3 = _mm_loadu_si128((const __m128i*)(r1 + 48));
+
+        _mm_storeu_si128((__m128i*)(y0 + x), luma16AVX2(a0, a1, a2, a3, yCoef, round));
+        _mm_storeu_si128((__m128i*)(y1 + x), luma16AVX2(b0, b1, b2, b3, yCoef, round));
+
+        // chroma is a quarter of the work; the 128-bit path is plenty
+        __m128i q0 = blockSums(a0, b0), q1 = blockSums(a1, b1);
+        __m128i q2 = blockSums(a2, b2), q3 = blockSums(a3, b3);
+        __m128i cbw = _mm_packs_epi32(chroma4(q0, q1, cbCoef, bias), chroma4(q2, q3, cbCoef, bias));
+        __m128i crw = _mm_packs_epi32(chroma4(q0, q1, crCoef, bias), chroma4(q2, q3, crCoef, bias));
+        __m128i c = _mm_packus_epi16(cbw, crw);
+        _mm_storel_epi64((__m128i*)(cb + x / 2), c);
+        _mm_storel_epi64((__m128i*)(cr + x / 2), _mm_srli_si128(c, 8));
+    }
+    // finish with the SSE4.1 kernel (8 at a time) and then scalar
+    if (x < width) {
+        convertPairSSE41(row0 + (size_t)x * 4, row1 + (size_t)x * 4, width - x, y0 + x, y1 + x, cb + x / 2, cr + x / 2);
+    }
+}
+
+#undef PIXEL_COEFS
+
+#endif // RECORDER_X86
+
+void convertBGRAToYUV420Rows(const uint8_t* bgra, int srcStride, YUV420Planes& planes,
+                             int firstRow, int lastRow, SimdLevel level) {
+    if (firstRow & 1) --firstRow;
+    if (lastRow > planes.height) lastRow = planes.height;
+
+    for (int row = firstRow; row < lastRow; row += 2) {
+        const uint8_t* row0 = bgra + (size_t)row * srcStride;
+        // odd height: the last row pairs with itself; its second luma row lands in the padding
+        const uint8_t* row1 = (row + 1 < planes.height) ? row0 + srcStride : row0;
+        uint8_t* y0 = planes.y + (size_t)row * planes.yStride;
+        uint8_t* y1 = y0 + planes.yStride;
+        uint8_t* cb = planes.cb + (size_t)(row / 2) * planes.cStride;
+        uint8_t* cr = planes.cr + (size_t)(row / 2) * planes.cStride;
+
+#ifdef RECORDER_X86
+        if (level == SimdLevel::AVX2) {
+            convertPairAVX2(row0, row1, planes.width, y0, y1, cb, cr);
+            continue;
+        }
+        if (level == SimdLevel::SSE41) {
+            convertPairSSE41(row0, row1, planes.width, y0, y1, cb, cr);
+            continue;
+        }
+#else
+        (void)level;
+#endif
+        convertPairScalar(row0, row1, 0, planes.width, y0, y1, cb, cr);
+    }
+}
+
+void convertBGRAToYUV420(const uint8_t* bgra, int srcStride, YUV420Planes& planes, SimdLevel level) {
+    convertBGRAToYUV420Rows(bgra, srcStride, planes, 0, planes.height, level);
+}
+
+void convertBGRAToYUV420(const uint8_t* bgra, int srcStride, YUV420Planes& planes) {
+    convertBGRAToYUV420(bgra, srcStride, planes, simdLevel());
+}
+
+// JFIF inverse in Q16: R = Y + 1.402 Cr, G = Y - 0.344136 Cb - 0.714136 Cr, B = Y + 1.772 Cb
+static const int kRCr = 91881, kGCb = -22554, kGCr = -46802, kBCb = 116130;
+
+void convertYUV420ToBGRA(const YUV420Planes& planes, uint8_t* bgra, int dstStride) {
+    for (int row = 0; row < planes.height; ++row) {
+        const uint8_t* yRow = planes.y + (size_t)row * planes.yStride;
+        const uint8_t* cbRow = planes.cb + (size_t)(row / 2) * planes.cStride;
+        const uint8_t* crRow = planes.cr + (size_t)(row / 2) * planes.cStride;
+        uint8_t* dst = bgra + (size_t)row * dstStride;
+        for (int x = 0; x < planes.width; ++x) {
+            int yv = (yRow[x] << 16) + (1 << 15);
+            int cb = cbRow[x / 2] - 128;
+            int cr = crRow[x / 2] - 128;
+            dst[x * 4 + 0] = clampByte((yv + kBCb * cb) >> 16);
+            dst[x * 4 + 1] = clampByte((yv + kGCb * cb + kGCr * cr) >> 16);
+            dst[x * 4 + 2] = clampByte((yv + kRCr * cr) >> 16);
+            dst[x * 4 + 3] = 255;
+        }
+    }
+}
+
+// Pads rows [firstRow, lastRow) of a plane with height real rows of width pixels
+static void padPlane(uint8_t* plane, int stride, int width, int height, int paddedWidth,
+                     int firstRow, int lastRow) {
+    if (width <= 0 || height <= 0) return;
+    if (paddedWidth > width) {
+        for (int row = firstRow; row < lastRow && row < height; ++row) {
+            uint8_t* line = plane + (size_t)row * stride;
+            memset(line + width, line[width - 1], (size_t)(paddedWidth - width));
+        }
+    }
+    const uint8_t* last = plane + (size_t)(height - 1) * stride;
+    for (int row = std::max(firstRow, height); row < lastRow; ++row) {
+        memcpy(plane + (size_t)row * stride, last, (size_t)paddedWidth);
+    }
+}
+
+void padYUV420ToMCU(YUV420Planes& planes) {
+    padYUV420ToMCU(planes, 0, planes.paddedHeight);
+}
+
+void padYUV420ToMCU(YUV420Planes& planes, int firstRow, int lastRow) {
+    padPlane(planes.y, planes.yStride, planes.width, planes.height, planes.paddedWidth, firstRow, lastRow);
+    padPlane(planes.cb, planes.cStride, planes.chromaWidth, planes.chromaHeight, planes.paddedWidth / 2,
+             firstRow / 2, lastRow / 2);
+    padPlane(planes.cr, planes.cStride, planes.chromaWidth, planes.chromaHeight, planes.paddedWidth / 2,
+             firstRow / 2, lastRow / 2);
+}
@@ -0,0 +1,54 @@
+#ifndef COLOR_CONVERT_H
+#define COLOR_CONVERT_H
+
+#include <cstdint>
+#include <vector>
+
+#include "../util/cpu_features.h"
+
+// Planar YCbCr 4:2:0 frame. Planes are allocated once and reused; strides are multiples
+// of 32 and the rows are padded to a multiple of 16 so encoders can read whole MCUs.
+struct YUV420Planes {
+    int width;
+    int height;
+    int chromaWidth;  // (width + 1) / 2
+    int chromaHeight; // (height + 1) / 2
+    int yStride;
+    int cStride;
+    int paddedWidth;  // width rounded up to 16 (chroma: paddedWidth / 2)
+    int paddedHeight; // height rounded up to 16 (chroma: paddedHeight / 2)
+    uint8_t* y;
+    uint8_t* cb;
+    uint8_t* cr;
+
+    YUV420Planes();
+    // (Re)allocate for width x height; keeps the storage when the size is unchanged
+    void allocate(int width, int height);
+
+private:
+    std::vector<uint8_t> storage;
+};
+
+// BGRA (top-down, srcStride bytes per row) to JFIF YCbCr 4:2:0: full-range BT.601, chroma
+// is the average of each 2x2 block. Odd widths/heights replicate the last column/row.
+// The SIMD kernels produce exactly the same bytes as the scalar code.
+void convertBGRAToYUV420(const uint8_t* bgra, int srcStride, YUV420Planes& planes);
+void convertBGRAToYUV420(const uint8_t* bgra, int srcStride, YUV420Planes& planes, SimdLevel level);
+
+// Convert luma rows [firstRow, lastRow) only (firstRow even), for splitting a frame
+// across threads; bgra still points at row 0
+void convertBGRAToYUV420Rows(const uint8_t* bgra, int srcStride, YUV420Planes& planes,
+                             int firstRow, int lastRow, SimdLevel level);
+
+// Back to BGRA (alpha 255) for decoders: JFIF inverse, chroma repeated over each 2x2 block.
+// Writes planes.width x planes.height pixels at bgra, dstStride bytes per row. Scalar.
+void convertYUV420ToBGRA(const YUV420Planes& planes, uint8_t* bgra, int dstStride);
+
+// Fill the padding up to paddedWidth x paddedHeight by repeating the last column and row,
+// so partial MCUs at the right and bottom edges compress like the picture next to them
+void padYUV420ToMCU(YUV420Planes& planes);
+// Same for luma rows [firstRow, lastRow) only (multiples of 16, the last row may be
+// paddedHeight), once the rows of that stripe are converted
+void padYUV420ToMCU(YUV420Planes& planes, int firstRow, int lastRow);
+
+#endif // COLOR_CONVERT_H
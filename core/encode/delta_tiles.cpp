@@ -1,31 +1,257 @@
 #include "delta_tiles.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
 
-DeltaTilesEncoder::DeltaTilesEncoder(int width, int height) : width(width), height(height) {
+#ifdef RECORDER_X86
+#include <immintrin.h>
+#endif
+
+static const uint8_t kMagic[4] = {'D', 'T', 'L', '1'};
+static const size_t kHeaderSize = 16;
+static const size_t kTileHeaderSize = 12;
+static const uint8_t kFlagKeyframe = 1;
+
+static void store16(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void store32(uint8_t* p, uint32_t v) {
+    store16(p, v & 0xFFFF);
+    store16(p + 2, v >> 16);
+}
+
+static uint32_t get16(const uint8_t* p) { return (uint32_t)p[0] | ((uint32_t)p[1] << 8); }
+static uint32_t get32(const uint8_t* p) { return get16(p) | (get16(p + 2) << 16); }
+
+// ---------------------------------------------------------------------------------------------
+// Dirty tile test: rows of a tile in two frames, rowBytes apart by stride. Each row is
+// XOR-accumulated in vector registers and tested once, so static tiles cost about a load
+// per 16/32 bytes and changed tiles usually stop after the first rows.
+
+static bool tileDiffersScalar(const uint8_t* a, const uint8_t* b, size_t stride, size_t rowBytes, int rows) {
+    for (int r = 0; r < rows; ++r) {
+        if (memcmp(a + r * stride, b + r * stride, rowBytes) != 0) return true;
+    }
+    return false;
+}
+
+#ifdef RECORDER_X86
+RECORDER_TARGET_SSE41 static bool tileDiffersSSE41(const uint8_t* a, const uint8_t* b, size_t stride,
+                                                   size_t rowBytes, int rows) {
+    size_t vecBytes = rowBytes & ~(size_t)15;
+    for (int r = 0; r < rows; ++r) {
+        const uint8_t* pa = a + r * stride;
+        const uint8_t* pb = b + r * stride;
+        __m128i acc = _mm_setzero_si128();
+        for (size_t i = 0; i < vecBytes; i += 16) {
+            __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pa + i));
+            __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pb + i));
+            acc = _mm_or_si128(acc, _mm_xor_si128(va, vb));
+        }
+        if (!_mm_testz_si128(acc, acc)) return true;
+        if (vecBytes < rowBytes && memcmp(pa + vecBytes, pb + vecBytes, rowBytes - vecBytes) != 0) return true;
+    }
+    return false;
+}
+
+RECORDER_TARGET_AVX2 static bool tileDiffersAVX2(const uint8_t* a, const uint8_t* b, size_t stride,
+                                                 size_t rowBytes, int rows) {
+    size_t vecBytes = rowBytes & ~(size_t)31;
+    for (int r = 0; r < rows; ++r) {
+        const uint8_t* pa = a + r * stride;
+        const uint8_t* pb = b + r * stride;
+        __m256i acc = _mm256_setzero_si256();
+        for (size_t i = 0; i < vecBytes; i += 32) {
+            __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pa + i));
+            __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pb + i));
+            acc = _mm256_or_si256(acc, _mm256_xor_si256(va, vb));
+        }
+        if (!_mm256_testz_si256(acc, acc)) return true;
+        if (vecBytes < rowBytes && memcmp(pa + vecBytes, pb + vecBytes, rowBytes - vecBytes) != 0) return true;
+    }
+    return false;
+}
+#endif
+
+static bool tileDiffers(SimdLevel level, const uint8_t* a, const uint8_t* b, size_t stride, size_t rowBytes,
+                        int rows) {
+#ifdef RECORDER_X86
+    if (level == SimdLevel::AVX2) return tileDiffersAVX2(a, b, stride, rowBytes, rows);
+    if (level == SimdLevel::SSE41) return tileDiffersSSE41(a, b, stride, rowBytes, rows);
+#endif
+    return tileDiffersScalar(a, b, stride, rowBytes, rows);
+}
+
+// ---------------------------------------------------------------------------------------------
+
+DeltaTilesEncoder::DeltaTilesEncoder(int width, int height, int tileSize)
+    : width(width), height(height), tileSize(tileSize), tilesX(0), tilesY(0), keyframeInterval(60),
+      framesSinceKey(0), keyPending(true), mode(DeltaTileMode::Jpeg), quality(75), dirtyTiles(0),
+      keyframe(false), level(simdLevel()) {
+    this->tileSize = std::max(16, std::min(256, (tileSize + 15) / 16 * 16));
+    tilesX = (width + this->tileSize - 1) / this->tileSize;
+    tilesY = (height + this->tileSize - 1) / this->tileSize;
+    jpeg.setQuality(quality);
 }
 
 DeltaTilesEncoder::~DeltaTilesEncoder() {}
 
-void DeltaTilesEncoder::encodeFrame(const uint8_t* currentFrame, const uint8_t* previousFrame) {
-    // simple placeholder: compute deltas and store raw differences (not optimized)
-    computeDeltas(currentFrame, previousFrame);
-    compressDeltas();
+void DeltaTilesEncoder::setKeyframeInterval(int frames) {
+    keyframeInterval = std::max(1, frames);
+}
+
+void DeltaTilesEncoder::setTileMode(DeltaTileMode m) {
+    mode = m;
+}
+
+void DeltaTilesEncoder::setQuality(int q) {
+    jpeg.setQuality(q);
+    quality = jpeg.getQuality();
+}
+
+void DeltaTilesEncoder::forceKeyframe() {
+    keyPending = true;
 }
 
-std::vector<uint8_t> DeltaTilesEncoder::getEncodedData() const {
+const PacketBuffer& DeltaTilesEncoder::getEncodedData() const {
     return encodedData;
 }
 
-void DeltaTilesEncoder::computeDeltas(const uint8_t* currentFrame, const uint8_t* previousFrame) {
+int DeltaTilesEncoder::getDirtyTileCount() const { return dirtyTiles; }
+
+int DeltaTilesEncoder::getTileCount() const { return tilesX * tilesY; }
+
+bool DeltaTilesEncoder::lastWasKeyframe() const { return keyframe; }
+
+void DeltaTilesEncoder::encodeFrame(const uint8_t* currentFrame, const uint8_t* previousFrame) {
     encodedData.clear();
-    if (!currentFrame || !previousFrame) return;
-    size_t pixels = static_cast<size_t>(width) * static_cast<size_t>(height) * 4;
-    encodedData.reserve(pixels / 8);
-    for (size_t i = 0; i < pixels; ++i) {
-        uint8_t d = currentFrame[i] - previousFrame[i];
-        if (d != 0) encodedData.push_back((uint8_t)i & 0xFF), encodedData.push_back(d);
+    dirtyTiles = 0;
+    if (!currentFrame || width <= 0 || height <= 0) return;
+
+    keyframe = !previousFrame || keyPending || framesSinceKey >= keyframeInterval;
+
+    uint8_t header[kHeaderSize];
+    memcpy(header, kMagic, 4);
+    store16(header + 4, (uint32_t)width);
+    store16(header + 6, (uint32_t)height);
+    store16(header + 8, (uint32_t)tileSize);
+    header[10] = keyframe ? kFlagKeyframe : 0;
+    header[11] = (uint8_t)quality;
+    store32(header + 12, 0); // tile count, patched below
+    encodedData.insert(encodedData.end(), header, header + kHeaderSize);
+
+    const size_t stride = (size_t)width * 4;
+    for (int ty = 0; ty < tilesY; ++ty) {
+        int th = std::min(tileSize, height - ty * tileSize);
+        for (int tx = 0; tx < tilesX; ++tx) {
+            int tw = std::min(tileSize, width - tx * tileSize);
+            size_t offset = (size_t)ty * tileSize * stride + (size_t)tx * tileSize * 4;
+            if (!keyframe && !tileDiffers(level, currentFrame + offset, previousFrame + offset, stride,
+                                          (size_t)tw * 4, th)) {
+                continue;
+            }
+            encodeTile(currentFrame, tx, ty);
+            ++dirtyTiles;
+        }
+    }
+    store32(encodedData.data() + kHeaderSize - 4, (uint32_t)dirtyTiles);
+
+    framesSinceKey = keyframe ? 1 : framesSinceKey + 1;
+    keyPending = false;
+}
+
+void DeltaTilesEncoder::encodeTile(const uint8_t* frame, int tx, int ty) {
+    const int tw = std::min(tileSize, width - tx * tileSize);
+    const int th = std::min(tileSize, height - ty * tileSize);
+    const size_t stride = (size_t)width * 4;
+    const uint8_t* src = frame + (size_t)ty * tileSize * stride + (size_t)tx * tileSize * 4;
+
+    uint8_t record[kTileHeaderSize] = {};
+    store32(record, (uint32_t)(ty * tilesX + tx));
+    record[4] = (uint8_t)mode;
+    encodedData.insert(encodedData.end(), record, record + kTileHeaderSize); // size patched below
+    size_t sizeAt = encodedData.size() - 4;
+    size_t payloadStart = encodedData.size();
+
+    if (mode == DeltaTileMode::Raw) {
+        for (int r = 0; r < th; ++r) {
+            const uint8_t* row = src + r * stride;
+            encodedData.insert(encodedData.end(), row, row + (size_t)tw * 4);
+        }
+    } else {
+        YUV420Planes& planes = tilePlanes[(tw < tileSize ? 1 : 0) | (th < tileSize ? 2 : 0)];
+        planes.allocate(tw, th);
+        convertBGRAToYUV420(src, width * 4, planes, level);
+        padYUV420ToMCU(planes);
+        jpeg.encodeRows(planes, 0, planes.paddedHeight / 16, encodedData);
     }
+    store32(encodedData.data() + sizeAt, (uint32_t)(encodedData.size() - payloadStart));
 }
 
-void DeltaTilesEncoder::compressDeltas() {
-    // no-op placeholder; in production replace with real compression
-}
\ No newline at end of file
+// ---------------------------------------------------------------------------------------------
+
+DeltaTilesDecoder::DeltaTilesDecoder() : width(0), height(0), tileSize(0) {}
+
+const std::vector<uint8_t>& DeltaTilesDecoder::getFrame() const { return frame; }
+
+int DeltaTilesDecoder::getWidth() const { return width; }
+
+int DeltaTilesDecoder::getHeight() const { return height; }
+
+bool DeltaTilesDecoder::decodeFrame(const uint8_t* data, size_t size) {
+    if (!data || size < kHeaderSize || memcmp(data, kMagic, 4) != 0) return false;
+    int w = (int)get16(data + 4);
+    int h = (int)get16(data + 6);
+    int ts = (int)get16(data + 8);
+    bool key = (data[10] & kFlagKeyframe) != 0;
+    int q = data[11];
+    uint32_t count = get32(data + 12);
+    if (w <= 0 || h <= 0 || ts < 16 || ts % 16 != 0) return false;
+
+    if (key) {
+        if (w != width || h != height) frame.assign((size_t)w * h * 4, 0);
+        width = w;
+        height = h;
+        tileSize = ts;
+    } else if (frame.empty() || w != width || h != height || ts != tileSize) {
+        return false;
+    }
+    jpeg.setQuality(q);
+
+    const int tilesX = (width + tileSize - 1) / tileSize;
+    const int tilesY = (height + tileSize - 1) / tileSize;
+    const size_t stride = (size_t)width * 4;
+    const uint8_t* p = data + kHeaderSize;
+    const uint8_t* end = data + size;
+    for (uint32_t i = 0; i < count; ++i) {
+        if ((size_t)(end - p) < kTileHeaderSize) return false;
+        uint32_t index = get32(p);
+        uint8_t tileMode = p[4];
+        uint32_t bytes = get32(p + 8);
+        p += kTileHeaderSize;
+        if (index >= (uint32_t)(tilesX * tilesY) || (size_t)(end - p) < bytes) return false;
+
+        int tx = (int)(index % tilesX);
+        int ty = (int)(index / tilesX);
+        int tw = std::min(tileSize, width - tx * tileSize);
+        int th = std::min(tileSize, height - ty * tileSize);
+        uint8_t* dst = frame.data() + (size_t)ty * tileSize * stride + (size_t)tx * tileSize * 4;
+
+        if (tileMode == (uint8_t)DeltaTileMode::Raw) {
+            size_t rowBytes = (size_t)tw * 4;
+            if (bytes != rowBytes * th) return false;
+            for (int r = 0; r < th; ++r) memcpy(dst + r * stride, p + r * rowBytes, rowBytes);
+        } else if (tileMode == (uint8_t)DeltaTileMode::Jpeg) {
+            YUV420Planes& planes = tilePlanes[(tw < tileSize ? 1 : 0) | (th < tileSize ? 2 : 0)];
+            planes.allocate(tw, th);
+            if (!jpeg.decodeRows(p, bytes, planes, 0, planes.paddedHeight / 16)) return false;
+            convertYUV420ToBGRA(planes, dst, (int)stride);
+        } else {
+            return false;
+        }
+        p += bytes;
+    }
+    return true;
+}
@@ -4,21 +4,94 @@
 #include <cstdint>
 #include <vector>
 
+#include "color_convert.h"
+#include "jpeg_baseline.h"
+#include "../io/packets.h"
+#include "../util/cpu_features.h"
+
+// Tile-based delta codec for mostly static content (desktop, menus). A frame is cut into
+// tileSize x tileSize tiles; only tiles that differ from the previous frame are stored,
+// raw or as a bare JPEG scan, and every keyframe interval all of them are.
+//
+// One encoded frame (little-endian):
+//   header    "DTL1", u16 width, u16 height, u16 tileSize, u8 flags (bit 0: keyframe),
+//             u8 JPEG quality, u32 number of tile records
+//   per tile  u32 tile index (row-major), u8 mode (DeltaTileMode), u8[3] reserved,
+//             u32 payload bytes, payload
+// Raw payload: the tile's BGRA rows, clipped at the right and bottom edges.
+// JPEG payload: JpegBaselineEncoder::encodeRows() of the tile (4:2:0, no markers) at the
+// header's quality; edge tiles are padded the way a whole frame is.
+
+enum class DeltaTileMode : uint8_t {
+    Raw = 0, // lossless, 4 bytes per pixel
+    Jpeg = 1
+};
+
 class DeltaTilesEncoder {
 public:
-    DeltaTilesEncoder(int width, int height);
+    // tileSize is rounded to a multiple of 16 (whole JPEG MCUs) between 16 and 256
+    DeltaTilesEncoder(int width, int height, int tileSize = 64);
     ~DeltaTilesEncoder();
 
+    // Frames from one keyframe to the next (1 = every frame); default 60
+    void setKeyframeInterval(int frames);
+    void setTileMode(DeltaTileMode mode); // default Jpeg
+    void setQuality(int quality);         // JPEG tiles, default 75
+    // Make the next frame a keyframe (e.g. after frames were dropped)
+    void forceKeyframe();
+
+    // Encode currentFrame (BGRA, width * 4 bytes per row) against previousFrame, the frame
+    // encoded last time; nullptr makes a keyframe
     void encodeFrame(const uint8_t* currentFrame, const uint8_t* previousFrame);
-    std::vector<uint8_t> getEncodedData() const;
+    const PacketBuffer& getEncodedData() const;
+
+    // Tiles stored in the last frame and tiles per frame
+    int getDirtyTileCount() const;
+    int getTileCount() const;
+    bool lastWasKeyframe() const;
 
 private:
+    void encodeTile(const uint8_t* frame, int tx, int ty);
+
     int width;
     int height;
-    std::vector<uint8_t> encodedData;
+    int tileSize;
+    int tilesX;
+    int tilesY;
+    int keyframeInterval;
+    int framesSinceKey;
+    bool keyPending;
+    DeltaTileMode mode;
+    int quality;
+    int dirtyTiles;
+    bool keyframe;
+    SimdLevel level;
+    PacketBuffer encodedData;
+    JpegBaselineEncoder jpeg;
+    YUV420Planes tilePlanes[4]; // by tile shape: full, right edge, bottom edge, corner
+};
 
-    void computeDeltas(const uint8_t* currentFrame, const uint8_t* previousFrame);
-    void compressDeltas();
+// Rebuilds full BGRA frames from a DeltaTilesEncoder stream
+class DeltaTilesDecoder {
+public:
+    DeltaTilesDecoder();
+
+    // Apply one encoded frame on top of the current picture. Returns false for malformed
+    // data, or a delta frame before the first keyframe or of a different size.
+    bool decodeFrame(const uint8_t* data, size_t size);
+
+    // Current picture, width * height * 4 bytes (empty before the first keyframe)
+    const std::vector<uint8_t>& getFrame() const;
+    int getWidth() const;
+    int getHeight() const;
+
+private:
+    int width;
+    int height;
+    int tileSize;
+    std::vector<uint8_t> frame;
+    JpegScanDecoder jpeg;
+    YUV420Planes tilePlanes[4];
 };
 
-#endif // DELTA_TILES_H
\ No newline at end of file
+#endif // DELTA_TILES_H
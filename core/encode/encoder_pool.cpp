@@ -0,0 +1,290 @@
+#include "encoder_pool.h"
+#include <chrono>
+
+// Longest a worker blocks before re-checking for shutdown; work wakes it immediately
+static const std::chrono::milliseconds waitSlice(50);
+
+EncoderPool::EncoderPool(int width, int height, int threadCount)
+    : width(width), height(height), scaleFilter(ScaleFilter::Area), codec(VideoCodec::Mjpeg), source(nullptr), inRing(nullptr), outRing(nullptr), bufferPool(nullptr),
+      nextSeq(0), lastFingerprint(0), reorderWindow(0), nextEmit(0), quality(75), slicesPerFrame(1), abbreviatedJpeg(false), activeThreads(threadCount),
+      running(false) {
+    if (threadCount < 1) threadCount = 1;
+    activeThreads.store(threadCount);
+    for (int i = 0; i < threadCount; ++i) {
+        encoders.emplace_back(new MJPEGEncoder(width, height));
+        telemetry.emplace_back(new WorkerTelemetry());
+    }
+    // Twice the worker count lets fast workers run ahead of one slow frame
+    reorderWindow = encoders.size() * 2;
+    reorderSlots.resize(reorderWindow);
+    slotState.assign(reorderWindow, SlotEmpty);
+}
+
+EncoderPool::~EncoderPool() {
+    Stop();
+}
+
+int EncoderPool::defaultThreadCount() {
+    unsigned hw = std::thread::hardware_concurrency();
+    int n = (int)(hw / 2);
+    if (n < 1) n = 1;
+    if (n > 8) n = 8;
+    return n;
+}
+
+bool EncoderPool::Start(FrameSource* source, SPSC_Ring<FrameTicket>* inRing, SPSC_Ring<VideoPacket>* outRing) {
+    if (!source || !inRing || !outRing) return false;
+    if (running.load()) return false;
+    this->source = source;
+    this->inRing = inRing;
+    this->outRing = outRing;
+    nextSeq = 0;
+    lastFingerprint = 0;
+    nextEmit.store(0);
+    slotState.assign(reorderWindow, SlotEmpty);
+
+    running.store(true);
+    for (size_t i = 0; i < encoders.size(); ++i) {
+        workers.emplace_back(&EncoderPool::WorkerLoop, this, i);
+    }
+    return true;
+}
+
+void EncoderPool::Stop() {
+    if (!running.load()) return;
+    running.store(false);
+    windowOpen.notify_all();
+    {
+        std::lock_guard<std::mutex> lock(parkMutex);
+    }
+    unparked.notify_all();
+    for (auto& t : workers) {
+        if (t.joinable()) t.join();
+    }
+    workers.clear();
+}
+
+void EncoderPool::setBufferPool(PacketBufferPool* pool) {
+    bufferPool = pool;
+}
+
+void EncoderPool::setCodec(VideoCodec codec) {
+    this->codec = codec;
+}
+
+VideoCodec EncoderPool::getCodec() const { return codec; }
+
+void EncoderPool::setQuality(int quality) {
+    // applied by each worker before its next frame
+    this->quality.store(quality);
+}
+
+int EncoderPool::getQuality() const { return quality.load(); }
+
+void EncoderPool::setRateControl(const RateControlOptions& options) {
+    if (options.targetBytesPerSec == 0) {
+        rateControl.reset();
+        return;
+    }
+    rateControl.reset(new RateController(options));
+    setQuality(rateControl->getQuality());
+}
+
+void EncoderPool::setFrameRate(int fps) {
+    std::lock_guard<std::mutex> lock(rateMutex);
+    if (rateControl) rateControl->setFrameRate(fps);
+}
+
+bool EncoderPool::getRateControlStats(RateControlStats& stats) const {
+    std::lock_guard<std::mutex> lock(rateMutex);
+    if (!rateControl) return false;
+    stats = rateControl->getStats();
+    return true;
+}
+
+int EncoderPool::getThreadCount() const { return (int)encoders.size(); }
+
+void EncoderPool::setSlicesPerFrame(int slices) {
+    if (slices < 1) slices = 1;
+    slicesPerFrame = slices;
+    for (auto& e : encoders) e->setSlices(slices);
+}
+
+int EncoderPool::getSlicesPerFrame() const { return slicesPerFrame; }
+
+void EncoderPool::setAbbreviatedJpeg(bool abbreviated) {
+    abbreviatedJpeg = abbreviated;
+    for (auto& e : encoders) e->setAbbreviated(abbreviated);
+}
+
+void EncoderPool::setActiveThreads(int count) {
+    if (count < 1) count = 1;
+    if (count > (int)encoders.size()) count = (int)encoders.size();
+    {
+        std::lock_guard<std::mutex> lock(parkMutex);
+        activeThreads.store(count);
+    }
+    unparked.notify_all();
+}
+
+int EncoderPool::getActiveThreads() const { return activeThreads.load(); }
+
+void EncoderPool::setScaleFilter(ScaleFilter filter) {
+    scaleFilter = filter;
+}
+
+void EncoderPool::getEncodeTotals(uint64_t& frames, uint64_t& encodeUs) const {
+    frames = 0;
+    encodeUs = 0;
+    for (const auto& w : telemetry) {
+        frames += w->frames.load(std::memory_order_relaxed);
+        encodeUs += w->encodeUsTotal.load(std::memory_order_relaxed);
+    }
+}
+
+EncoderPoolTelemetry EncoderPool::getTelemetry() const {
+    EncoderPoolTelemetry t = EncoderPoolTelemetry();
+    std::vector<const LatencyHistogram*> wait, encode, bytes;
+    for (const auto& w : telemetry) {
+        t.framesEncoded += w->frames.load(std::memory_order_relaxed);
+        t.framesRepeated += w->repeats.load(std::memory_order_relaxed);
+        wait.push_back(&w->queueWait);
+        encode.push_back(&w->encodeTime);
+        bytes.push_back(&w->encodedBytes);
+    }
+    t.queueWaitUs = LatencyHistogram::merge(wait);
+    t.encodeUs = LatencyHistogram::merge(encode);
+    t.encodedBytes = LatencyHistogram::merge(bytes);
+    return t;
+}
+
+const uint8_t* EncoderPool::takeFrame(FrameTicket& ticket, uint64_t& seq, bool& repeat) {
+    std::unique_lock<std::mutex> lock(intakeMutex);
+    // Don't run further ahead of the oldest unfinished frame than the reorder window holds.
+    // (submit() notifies without intakeMutex; a missed wake-up costs at most one slice.)
+    bool windowHasRoom = windowOpen.wait_for(lock, waitSlice, [this]() {
+        return nextSeq - nextEmit.load(std::memory_order_acquire) < reorderWindow || !running.load();
+    });
+    if (!windowHasRoom || !running.load()) return nullptr;
+
+    // Other workers queue on intakeMutex meanwhile, so only one thread waits on the ring
+    FramePool& pool = source->getFramePool();
+    while (inRing->pop_wait(ticket, waitSlice)) {
+        const uint8_t* frame = pool.acquireForRead(ticket);
+        if (!frame) continue;
+        seq = nextSeq++;
+        // sequence order is output order, so this compares with the frame written before
+        repeat = ticket.fingerprint != 0 && ticket.fingerprint == lastFingerprint;
+        lastFingerprint = ticket.fingerprint;
+        return frame;
+    }
+    return nullptr;
+}
+
+void EncoderPool::submit(uint64_t seq, VideoPacket& pkt) {
+    std::lock_guard<std::mutex> lock(reorderMutex);
+    size_t slot = (size_t)(seq % reorderWindow);
+    std::swap(reorderSlots[slot], pkt);
+    slotState[slot] = SlotPacket;
+
+    uint64_t emit = nextEmit.load(std::memory_order_relaxed);
+    while (slotState[emit % reorderWindow] != SlotEmpty) {
+        size_t s = (size_t)(emit % reorderWindow);
+        // push to writer ring (wait for space until shutdown)
+        while (running.load() && !outRing->push_wait(std::move(reorderSlots[s]), waitSlice)) {
+        }
+        slotState[s] = SlotEmpty;
+        ++emit;
+    }
+    if (emit != nextEmit.load(std::memory_order_relaxed)) {
+        nextEmit.store(emit, std::memory_order_release);
+        windowOpen.notify_all();
+    }
+}
+
+void EncoderPool::WorkerLoop(size_t worker) {
+    MJPEGEncoder* encoder = encoders[worker].get();
+    WorkerTelemetry& stats = *telemetry[worker];
+    FramePool& pool = source->getFramePool();
+    FrameTicket ticket;
+    uint64_t seq;
+    bool repeat = false;
+    size_t sizeHint = 0; // last encoded size plus headroom, so recycled buffers rarely grow
+
+    // frames captured at another size than the output are resampled into scaledFrame
+    ImageScaler scaler;
+    std::vector<uint8_t> scaledFrame;
+    // built on the first frame when recording with the lossless codec
+    std::unique_ptr<LosslessEncoder> lossless;
+
+    while (running.load()) {
+        if ((int)worker >= activeThreads.load()) {
+            std::unique_lock<std::mutex> lock(parkMutex);
+            unparked.wait_for(lock, waitSlice, [this, worker]() {
+                return (int)worker < activeThreads.load() || !running.load();
+            });
+            continue;
+        }
+
+        const uint8_t* frame = takeFrame(ticket, seq, repeat);
+        if (!frame) continue;
+
+        uint64_t leasedUs = telemetry_now_us();
+        stats.queueWait.record(leasedUs > ticket.capture_us ? leasedUs - ticket.capture_us : 0);
+
+        VideoPacket pkt;
+        pkt.pts_ms = ticket.pts_ms;
+        pkt.capture_us = ticket.capture_us;
+        if (repeat) {
+            // nothing changed since the previous frame: an empty chunk shows it again
+            pool.release(ticket.slot);
+            pkt.length = 0;
+            stats.repeats.fetch_add(1, std::memory_order_relaxed);
+            submit(seq, pkt);
+            continue;
+        }
+        if (bufferPool) pkt.data = bufferPool->acquire(sizeHint);
+
+        int frameWidth = (int)ticket.width;
+        int frameHeight = (int)ticket.height;
+        bool scaled = frameWidth != width || frameHeight != height;
+        if (scaled) {
+            // taps are only rebuilt when the capture size changes (degradation ladder)
+            scaler.configure(frameWidth, frameHeight, width, height, scaleFilter);
+            scaledFrame.resize((size_t)width * (size_t)height * 4);
+            // row bands on as many threads as the encode uses stripes
+            scaler.scale(frame, frameWidth * 4, scaledFrame.data(), width * 4, slicesPerFrame);
+            // done with the captured frame; free the slot before the (longer) encode
+            pool.release(ticket.slot);
+        }
+
+        int frameQuality = quality.load();
+        if (codec == VideoCodec::Lossless) {
+            if (!lossless) {
+                lossless.reset(new LosslessEncoder(width, height));
+                lossless->setStripes(slicesPerFrame);
+            }
+            pkt.length = lossless->encodeFrame(scaled ? scaledFrame.data() : frame, pkt.data);
+            if (!scaled) pool.release(ticket.slot);
+        } else {
+            encoder->setQuality(frameQuality);
+            pkt.length = encoder->encodeFrame(scaled ? scaledFrame.data() : frame, pkt.data);
+            // the slot can be recaptured as soon as the encoder is done reading it
+            if (!scaled) pool.release(ticket.slot);
+        }
+
+        uint64_t encodedUs = telemetry_now_us();
+        if (rateControl && codec == VideoCodec::Mjpeg) {
+            std::lock_guard<std::mutex> lock(rateMutex);
+            setQuality(rateControl->update(pkt.length, frameQuality, encodedUs));
+        }
+
+        sizeHint = pkt.length + pkt.length / 4;
+        uint64_t encodeUs = encodedUs - leasedUs;
+        stats.encodeTime.record(encodeUs);
+        stats.encodedBytes.record(pkt.length);
+        stats.encodeUsTotal.fetch_add(encodeUs, std::memory_order_relaxed);
+        stats.frames.fetch_add(1, std::memory_order_relaxed);
+        submit(seq, pkt);
+    }
+}
@@ -0,0 +1,168 @@
+#ifndef ENCODER_POOL_H
+#define ENCODER_POOL_H
+
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+
+#include "mjpeg.h"
+#include "image_scaler.h"
+#include "lossless_codec.h"
+#include "rate_control.h"
+#include "video_codec.h"
+#include "../capture/frame_source.h"
+#include "../util/spsc_ring.h"
+#include "../io/packets.h"
+#include "../util/telemetry.h"
+
+// Encoder-side telemetry, merged over all workers
+struct EncoderPoolTelemetry {
+    uint64_t framesEncoded;
+    uint64_t framesRepeated;        // unchanged frames sent as repeats without encoding
+    HistogramSnapshot queueWaitUs;  // capture -> leased by a worker
+    HistogramSnapshot encodeUs;     // encodeFrame() duration
+    HistogramSnapshot encodedBytes; // encoded frame size
+};
+
+// N encoder workers, each with its own encoder (and TurboJPEG handle).
+// Workers lease frames from the capture ring in turn, tag them with a sequence
+// number and encode in parallel; a reorder stage hands packets to the writer ring in
+// capture order. At most reorderWindow frames are in flight past the oldest unfinished one.
+//
+// threadCount workers are created up front; setActiveThreads() parks the ones above the
+// limit so the degradation ladder can change the worker count while recording.
+//
+// Frames of a different size than the output (FrameTicket::width/height: the capture size,
+// or less while the source captures downscaled) are resampled to it by each worker before
+// encoding, so scaling runs in parallel with everything else and every encoded frame has
+// the output size.
+//
+// Frames whose ticket fingerprint (FrameSource::setFingerprinting) equals the previous
+// frame's are not encoded: they go out as zero-length packets, which the muxer writes as
+// empty chunks that players show as a repeat of the frame before.
+class EncoderPool {
+public:
+    // width/height: size of the encoded frames (and of the stream)
+    EncoderPool(int width, int height, int threadCount);
+    ~EncoderPool();
+
+    // Start workers reading frame tickets from inRing (frames leased from the source's pool)
+    // and pushing encoded packets to outRing in capture order
+    bool Start(FrameSource* source, SPSC_Ring<FrameTicket>* inRing, SPSC_Ring<VideoPacket>* outRing);
+
+    // Stop workers and return when complete; frames not yet encoded are discarded
+    void Stop();
+
+    // Recycle packet payloads from this pool (optional; call before Start)
+    void setBufferPool(PacketBufferPool* pool);
+
+    // Codec the workers encode with (default Mjpeg). Call before Start.
+    void setCodec(VideoCodec codec);
+    VideoCodec getCodec() const;
+
+    // JPEG quality; ignored by the lossless codec
+    void setQuality(int quality);
+    int getQuality() const;
+
+    // Hold the encoded output near options.targetBytesPerSec by choosing the quality of
+    // every frame from the sizes of the frames before (see RateController); replaces the
+    // fixed quality. Target 0 turns it off. Call before Start.
+    void setRateControl(const RateControlOptions& options);
+
+    // Frame rate rate control splits its budget over; safe to call while running
+    void setFrameRate(int fps);
+
+    // Current rate control state; false when rate control is off
+    bool getRateControlStats(RateControlStats& stats) const;
+    int getThreadCount() const;
+
+    // Split every frame into this many stripes encoded in parallel (see
+    // MJPEGEncoder::setSlices), trading throughput for per-frame latency; resampling is split
+    // the same way. Call before Start.
+    void setSlicesPerFrame(int slices);
+    int getSlicesPerFrame() const;
+
+    // Encode abbreviated AVI1 frames (MJPEGEncoder::setAbbreviated). Call before Start.
+    void setAbbreviatedJpeg(bool abbreviated);
+
+    // Workers taking frames (1..getThreadCount()); safe to call while running
+    void setActiveThreads(int count);
+    int getActiveThreads() const;
+
+    // Filter used to resample frames to the output size (default Area). Call before Start.
+    void setScaleFilter(ScaleFilter filter);
+
+    // Frames encoded and total encode time so far, repeats not included (cheap; for
+    // controllers polling often)
+    void getEncodeTotals(uint64_t& frames, uint64_t& encodeUs) const;
+
+    EncoderPoolTelemetry getTelemetry() const;
+
+    // Default worker count for this machine: half the cores, leaving room for the game
+    static int defaultThreadCount();
+
+private:
+    void WorkerLoop(size_t worker);
+    // Wait for a ticket that can be leased; stale (reclaimed) tickets are skipped.
+    // Returns nullptr if none arrives within one wait slice. repeat is set when the frame
+    // has the same fingerprint as the one leased before it.
+    const uint8_t* takeFrame(FrameTicket& ticket, uint64_t& seq, bool& repeat);
+    void submit(uint64_t seq, VideoPacket& pkt);
+
+    // Written only by its own worker, so the counters never bounce between cores
+    struct WorkerTelemetry {
+        std::atomic<uint64_t> frames{0};
+        std::atomic<uint64_t> repeats{0};
+        std::atomic<uint64_t> encodeUsTotal{0};
+        LatencyHistogram queueWait;
+        LatencyHistogram encodeTime;
+        LatencyHistogram encodedBytes;
+    };
+
+    int width;
+    int height;
+    ScaleFilter scaleFilter;
+    VideoCodec codec;
+    std::vector<std::unique_ptr<MJPEGEncoder>> encoders;
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<WorkerTelemetry>> telemetry;
+
+    FrameSource* source;
+    SPSC_Ring<FrameTicket>* inRing;
+    SPSC_Ring<VideoPacket>* outRing;
+    PacketBufferPool* bufferPool;
+
+    // intake: serializes the single-consumer side of inRing and assigns sequence numbers
+    // (separate from the capture sequence, which has gaps where frames were dropped)
+    std::mutex intakeMutex;
+    std::condition_variable windowOpen; // signalled when nextEmit advances
+    uint64_t nextSeq;
+    uint64_t lastFingerprint; // of the frame given nextSeq - 1, 0 if none
+
+    // reorder: completed packets wait here until every earlier sequence number is out.
+    // Slot seq % reorderWindow; whoever completes the oldest frame pushes the ready run,
+    // so outRing only ever has one producer at a time.
+    enum SlotState : uint8_t { SlotEmpty, SlotPacket };
+    std::mutex reorderMutex;
+    std::vector<VideoPacket> reorderSlots;
+    std::vector<uint8_t> slotState;
+    size_t reorderWindow;
+    std::atomic<uint64_t> nextEmit;
+
+    std::atomic<int> quality;
+    std::unique_ptr<RateController> rateControl; // null: fixed quality
+    mutable std::mutex rateMutex;                 // serializes rateControl across workers
+    int slicesPerFrame;
+    bool abbreviatedJpeg;
+    std::atomic<int> activeThreads;
+    std::mutex parkMutex;
+    std::condition_variable unparked; // signalled when activeThreads changes
+
+    std::atomic<bool> running;
+};
+
+#endif // ENCODER_POOL_H
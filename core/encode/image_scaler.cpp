@@ -0,0 +1,364 @@
+#include "image_scaler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+#ifdef RECORDER_X86
+#include <immintrin.h>
+#endif
+
+// Weights are Q14 and sum to exactly 1 << 14 per output sample, all non-negative. The
+// vertical pass keeps 7 fractional bits in int16 (at most 255 << 7), so both passes fit
+// pmaddwd and the result never needs clamping beyond the final pack.
+static const int kWeightBits = 14;
+static const int kVerticalShift = 7;
+static const int kHorizontalShift = 2 * kWeightBits - kVerticalShift;
+
+// Source taps of output sample i along one axis: weights for [first, first + w.size())
+static void axisTaps(int srcSize, int dstSize, ScaleFilter filter, int i, int& first, std::vector<double>& w) {
+    const double scale = (double)srcSize / (double)dstSize;
+    const double lo = i * scale;
+    const double hi = (i + 1) * scale;
+    std::vector<std::pair<int, double>> taps;
+
+    if (filter == ScaleFilter::Bilinear) {
+        double c = (i + 0.5) * scale - 0.5;
+        int x0 = (int)std::floor(c);
+        double f = c - x0;
+        taps.push_back(std::make_pair(x0, 1.0 - f));
+        taps.push_back(std::make_pair(x0 + 1, f));
+    } else if (filter == ScaleFilter::Area) {
+        for (int j = (int)std::floor(lo); j < (int)std::ceil(hi); ++j) {
+            double overlap = std::min(hi, (double)j + 1.0) - std::max(lo, (double)j);
+            if (overlap > 0.0) taps.push_back(std::make_pair(j, overlap));
+        }
+    } else {
+        // pixels with their centre inside [lo, hi); none when enlarging, then the nearest
+        int jFirst = (int)std::ceil(lo - 0.5);
+        int jLast = (int)std::ceil(hi - 0.5) - 1;
+        if (jLast < jFirst) jFirst = jLast = (int)std::floor((i + 0.5) * scale);
+        for (int j = jFirst; j <= jLast; ++j) taps.push_back(std::make_pair(j, 1.0));
+    }
+
+    int minJ = srcSize, maxJ = -1;
+    for (auto& t : taps) {
+        t.first = std::max(0, std::min(srcSize - 1, t.first));
+        minJ = std::min(minJ, t.first);
+        maxJ = std::max(maxJ, t.first);
+    }
+    first = minJ;
+    w.assign((size_t)(maxJ - minJ + 1), 0.0);
+    for (const auto& t : taps) w[(size_t)(t.first - minJ)] += t.second;
+}
+
+// Q14 weights summing to exactly 1 << 14; zero taps at either end are dropped
+static void quantizeTaps(const std::vector<double>& w, int& first, std::vector<int>& q) {
+    double sum = 0.0;
+    for (double v : w) sum += v;
+    q.assign(w.size(), 0);
+    int total = 0;
+    size_t largest = 0;
+    for (size_t k = 0; k < w.size(); ++k) {
+        q[k] = (int)std::floor(w[k] / sum * (1 << kWeightBits) + 0.5);
+        total += q[k];
+        if (q[k] > q[largest]) largest = k;
+    }
+    q[largest] += (1 << kWeightBits) - total;
+    while (q.size() > 1 && q.back() == 0) q.pop_back();
+    while (q.size() > 1 && q.front() == 0) {
+        q.erase(q.begin());
+        ++first;
+    }
+}
+
+// Column weights are stored per group of four output pixels, per tap pair, as four
+// broadcast copies for each pixel in the slot order the AVX2 kernel keeps them in
+static const int kGroupSlot[4] = {0, 2, 1, 3};
+
+static int32_t weightPair(int a, int b) {
+    return (int32_t)((uint32_t)(uint16_t)a | ((uint32_t)(uint16_t)b << 16));
+}
+
+ImageScaler::ImageScaler()
+    : srcWidth(0), srcHeight(0), dstWidth(0), dstHeight(0), filter(ScaleFilter::Area), level(SimdLevel::Scalar),
+      hTaps(0), rowPixels(0) {}
+
+bool ImageScaler::configure(int sw, int sh, int dw, int dh, ScaleFilter f) {
+    return configure(sw, sh, dw, dh, f, simdLevel());
+}
+
+bool ImageScaler::configure(int sw, int sh, int dw, int dh, ScaleFilter f, SimdLevel lv) {
+    if (sw <= 0 || sh <= 0 || dw <= 0 || dh <= 0) return false;
+    level = lv;
+    if (sw == srcWidth && sh == srcHeight && dw == dstWidth && dh == dstHeight && f == filter) return true;
+    srcWidth = sw;
+    srcHeight = sh;
+    dstWidth = dw;
+    dstHeight = dh;
+    filter = f;
+
+    std::vector<double> w;
+    std::vector<int> q;
+
+    std::vector<int> firsts(dw);
+    std::vector<std::vector<int>> cols(dw);
+    hTaps = 0;
+    for (int i = 0; i < dw; ++i) {
+        axisTaps(sw, dw, f, i, firsts[i], w);
+        quantizeTaps(w, firsts[i], cols[i]);
+        hTaps = std::max(hTaps, (int)cols[i].size());
+    }
+    hTaps = (hTaps + 1) & ~1;
+    const int pairs = hTaps / 2;
+    const int groups = (dw + 3) / 4;
+    colStart.assign(dw, 0);
+    colWeights.assign((size_t)groups * pairs * 16, 0);
+    rowPixels = sw;
+    for (int i = 0; i < dw; ++i) {
+        colStart[i] = firsts[i];
+        cols[i].resize(hTaps, 0);
+        for (int k = 0; k < pairs; ++k) {
+            int32_t* slot = &colWeights[((size_t)(i / 4) * pairs + k) * 16 + kGroupSlot[i % 4] * 4];
+            for (int c = 0; c < 4; ++c) slot[c] = weightPair(cols[i][2 * k], cols[i][2 * k + 1]);
+        }
+        // padding taps read past the row; they have zero weight
+        rowPixels = std::max(rowPixels, firsts[i] + hTaps);
+    }
+
+    rowStart.assign(dh, 0);
+    rowCount.assign(dh, 0);
+    rowOffset.assign(dh, 0);
+    rowWeights.clear();
+    for (int y = 0; y < dh; ++y) {
+        int firstRow;
+        axisTaps(sh, dh, f, y, firstRow, w);
+        quantizeTaps(w, firstRow, q);
+        rowStart[y] = firstRow;
+        rowCount[y] = (int)q.size();
+        rowOffset[y] = (int)rowWeights.size();
+        for (int v : q) rowWeights.push_back((int16_t)v);
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------
+// Vertical pass: bytes of one 16-bit row from count source rows
+
+static void verticalScalar(const uint8_t* const* rows, const int16_t* w, int count, int16_t* out, int bytes,
+                           int from) {
+    for (int x = from; x < bytes; ++x) {
+        int acc = 0;
+        for (int t = 0; t < count; ++t) acc += rows[t][x] * w[t];
+        out[x] = (int16_t)((acc + (1 << (kVerticalShift - 1))) >> kVerticalShift);
+    }
+}
+
+#ifdef RECORDER_X86
+RECORDER_TARGET_SSE41 static void verticalSSE41(const uint8_t* const* rows, const int16_t* w, int count,
+                                                int16_t* out, int bytes) {
+    const __m128i round = _mm_set1_epi32(1 << (kVerticalShift - 1));
+    int x = 0;
+    for (; x + 16 <= bytes; x += 16) {
+        __m128i acc0 = _mm_setzero_si128(), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+        for (int t = 0; t < count; t += 2) {
+            bool pair = t + 1 < count;
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[t] + x));
+            __m128i b = pair ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[t + 1] + x)) : a;
+            __m128i wp = _mm_set1_epi32(weightPair(w[t], pair ? w[t + 1] : 0));
+            __m128i aLo = _mm_cvtepu8_epi16(a), aHi = _mm_cvtepu8_epi16(_mm_srli_si128(a, 8));
+            __m128i bLo = _mm_cvtepu8_epi16(b), bHi = _mm_cvtepu8_epi16(_mm_srli_si128(b, 8));
+            acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi16(aLo, bLo), wp));
+            acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi16(aLo, bLo), wp));
+            acc2 = _mm_add_epi32(acc2, _mm_madd_epi16(_mm_unpacklo_epi16(aHi, bHi), wp));
+            acc3 = _mm_add_epi32(acc3, _mm_madd_epi16(_mm_unpackhi_epi16(aHi, bHi), wp));
+        }
+        acc0 = _mm_srai_epi32(_mm_add_epi32(acc0, round), kVerticalShift);
+        acc1 = _mm_srai_epi32(_mm_add_epi32(acc1, round), kVerticalShift);
+        acc2 = _mm_srai_epi32(_mm_add_epi32(acc2, round), kVerticalShift);
+        acc3 = _mm_srai_epi32(_mm_add_epi32(acc3, round), kVerticalShift);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm_packs_epi32(acc0, acc1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x + 8), _mm_packs_epi32(acc2, acc3));
+    }
+    verticalScalar(rows, w, count, out, bytes, x);
+}
+
+RECORDER_TARGET_AVX2 static void verticalAVX2(const uint8_t* const* rows, const int16_t* w, int count,
+                                              int16_t* out, int bytes) {
+    const __m256i round = _mm256_set1_epi32(1 << (kVerticalShift - 1));
+    const __m256i zero = _mm256_setzero_si256();
+    int x = 0;
+    for (; x + 32 <= bytes; x += 32) {
+        __m256i acc0 = _mm256_setzero_si256(), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+        for (int t = 0; t < count; t += 2) {
+            bool pair = t + 1 < count;
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[t] + x));
+            __m256i b = pair ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[t + 1] + x)) : zero;
+            __m256i wp = _mm256_set1_epi32(weightPair(w[t], pair ? w[t + 1] : 0));
+            // interleave the two rows' bytes, then zero-extend: 16-bit (a, b) pairs for pmaddwd
+            __m256i abLo = _mm256_unpacklo_epi8(a, b);
+            __m256i abHi = _mm256_unpackhi_epi8(a, b);
+            acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(_mm256_unpacklo_epi8(abLo, zero), wp));
+            acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(_mm256_unpackhi_epi8(abLo, zero), wp));
+            acc2 = _mm256_add_epi32(acc2, _mm256_madd_epi16(_mm256_unpacklo_epi8(abHi, zero), wp));
+            acc3 = _mm256_add_epi32(acc3, _mm256_madd_epi16(_mm256_unpackhi_epi8(abHi, zero), wp));
+        }
+        acc0 = _mm256_srai_epi32(_mm256_add_epi32(acc0, round), kVerticalShift);
+        acc1 = _mm256_srai_epi32(_mm256_add_epi32(acc1, round), kVerticalShift);
+        acc2 = _mm256_srai_epi32(_mm256_add_epi32(acc2, round), kVerticalShift);
+        acc3 = _mm256_srai_epi32(_mm256_add_epi32(acc3, round), kVerticalShift);
+        // unpacks work per 128-bit lane: bytes 0-7 | 16-23 and 8-15 | 24-31
+        __m256i r01 = _mm256_packs_epi32(acc0, acc1);
+        __m256i r23 = _mm256_packs_epi32(acc2, acc3);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), _mm256_permute2x128_si256(r01, r23, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x + 16), _mm256_permute2x128_si256(r01, r23, 0x31));
+    }
+    verticalScalar(rows, w, count, out, bytes, x);
+}
+#endif
+
+// ---------------------------------------------------------------------------------------------
+// Horizontal pass: output pixels [from, count) of one row from the 16-bit row
+
+static void horizontalScalar(const int16_t* row, const int32_t* start, const int32_t* weights, int taps,
+                             uint8_t* out, int from, int count) {
+    const int pairs = taps / 2;
+    for (int i = from; i < count; ++i) {
+        const int16_t* p = row + (size_t)start[i] * 4;
+        const int32_t* wp = weights + (size_t)(i / 4) * pairs * 16 + kGroupSlot[i % 4] * 4;
+        int acc[4] = {0, 0, 0, 0};
+        for (int t = 0; t < taps; ++t) {
+            int w = (int16_t)(wp[(t / 2) * 16] >> ((t & 1) * 16));
+            for (int c = 0; c < 4; ++c) acc[c] += p[t * 4 + c] * w;
+        }
+        for (int c = 0; c < 4; ++c) {
+            int v = (acc[c] + (1 << (kHorizontalShift - 1))) >> kHorizontalShift;
+            out[i * 4 + c] = (uint8_t)(v > 255 ? 255 : v);
+        }
+    }
+}
+
+#ifdef RECORDER_X86
+// Two adjacent pixels as 16-bit BGRA pairs -> (B0 B1 G0 G1 R0 R1 A0 A1) for pmaddwd
+#define SCALER_PAIR_SHUFFLE 0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14, 15
+
+RECORDER_TARGET_SSE41 static __m128i horizontalPixelSSE41(const int16_t* p, const int32_t* w, int pairs,
+                                                          __m128i shuffle) {
+    __m128i acc = _mm_setzero_si128();
+    for (int k = 0; k < pairs; ++k, w += 16) {
+        __m128i v = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + k * 8)), shuffle);
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(v, _mm_loadu_si128(reinterpret_cast<const __m128i*>(w))));
+    }
+    return _mm_srai_epi32(_mm_add_epi32(acc, _mm_set1_epi32(1 << (kHorizontalShift - 1))), kHorizontalShift);
+}
+
+RECORDER_TARGET_SSE41 static void horizontalSSE41(const int16_t* row, const int32_t* start, const int32_t* weights,
+                                                  int taps, uint8_t* out, int from, int count) {
+    const int pairs = taps / 2;
+    const __m128i shuffle = _mm_setr_epi8(SCALER_PAIR_SHUFFLE);
+    int i = from;
+    for (; i + 4 <= count && i % 4 == 0; i += 4) {
+        const int32_t* w = weights + (size_t)(i / 4) * pairs * 16;
+        __m128i a = horizontalPixelSSE41(row + (size_t)start[i] * 4, w + kGroupSlot[0] * 4, pairs, shuffle);
+        __m128i b = horizontalPixelSSE41(row + (size_t)start[i + 1] * 4, w + kGroupSlot[1] * 4, pairs, shuffle);
+        __m128i c = horizontalPixelSSE41(row + (size_t)start[i + 2] * 4, w + kGroupSlot[2] * 4, pairs, shuffle);
+        __m128i d = horizontalPixelSSE41(row + (size_t)start[i + 3] * 4, w + kGroupSlot[3] * 4, pairs, shuffle);
+        __m128i px = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + (size_t)i * 4), px);
+    }
+    for (; i < count; ++i) {
+        const int32_t* w = weights + (size_t)(i / 4) * pairs * 16 + kGroupSlot[i % 4] * 4;
+        __m128i a = horizontalPixelSSE41(row + (size_t)start[i] * 4, w, pairs, shuffle);
+        int32_t px = _mm_cvtsi128_si32(_mm_packus_epi16(_mm_packs_epi32(a, a), a));
+        memcpy(out + (size_t)i * 4, &px, 4);
+    }
+}
+
+RECORDER_TARGET_AVX2 static void horizontalAVX2(const int16_t* row, const int32_t* start, const int32_t* weights,
+                                                int taps, uint8_t* out, int count) {
+    const int pairs = taps / 2;
+    const __m256i shuffle = _mm256_setr_epi8(SCALER_PAIR_SHUFFLE, SCALER_PAIR_SHUFFLE);
+    const __m256i round = _mm256_set1_epi32(1 << (kHorizontalShift - 1));
+    int i = 0;
+    // four output pixels: (i, i + 2) in one register and (i + 1, i + 3) in the other, one per lane
+    for (; i + 4 <= count; i += 4) {
+        const int16_t* p0 = row + (size_t)start[i] * 4;
+        const int16_t* p1 = row + (size_t)start[i + 1] * 4;
+        const int16_t* p2 = row + (size_t)start[i + 2] * 4;
+        const int16_t* p3 = row + (size_t)start[i + 3] * 4;
+        const int32_t* w = weights + (size_t)(i / 4) * pairs * 16;
+        __m256i acc02 = _mm256_setzero_si256(), acc13 = acc02;
+        for (int k = 0; k < pairs; ++k, w += 16) {
+            __m256i v02 = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p0 + k * 8))),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(p2 + k * 8)), 1);
+            __m256i v13 = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p1 + k * 8))),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(p3 + k * 8)), 1);
+            __m256i w02 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w));
+            __m256i w13 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w + 8));
+            acc02 = _mm256_add_epi32(acc02, _mm256_madd_epi16(_mm256_shuffle_epi8(v02, shuffle), w02));
+            acc13 = _mm256_add_epi32(acc13, _mm256_madd_epi16(_mm256_shuffle_epi8(v13, shuffle), w13));
+        }
+        acc02 = _mm256_srai_epi32(_mm256_add_epi32(acc02, round), kHorizontalShift);
+        acc13 = _mm256_srai_epi32(_mm256_add_epi32(acc13, round), kHorizontalShift);
+        // lanes become (i, i + 1) and (i + 2, i + 3); gather the low qword of each
+        __m256i px = _mm256_packus_epi16(_mm256_packs_epi32(acc02, acc13), _mm256_setzero_si256());
+        px = _mm256_permute4x64_epi64(px, _MM_SHUFFLE(3, 1, 2, 0));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + (size_t)i * 4), _mm256_castsi256_si128(px));
+    }
+    horizontalSSE41(row, start, weights, taps, out, i, count);
+}
+#endif
+
+// ---------------------------------------------------------------------------------------------
+
+void ImageScaler::scaleRows(const uint8_t* src, int srcStride, uint8_t* dst, int dstStride, int firstRow,
+                            int lastRow) const {
+    if (dstWidth <= 0 || firstRow >= lastRow) return;
+    // per call, so bands on different threads never share it; padding stays zero
+    std::vector<int16_t> tmp((size_t)rowPixels * 4, 0);
+    std::vector<const uint8_t*> rows;
+    const int bytes = srcWidth * 4;
+
+    for (int y = std::max(0, firstRow); y < std::min(lastRow, dstHeight); ++y) {
+        const int count = rowCount[y];
+        const int16_t* w = rowWeights.data() + rowOffset[y];
+        rows.resize(count);
+        for (int t = 0; t < count; ++t) rows[t] = src + (size_t)(rowStart[y] + t) * srcStride;
+        uint8_t* out = dst + (size_t)y * dstStride;
+
+#ifdef RECORDER_X86
+        if (level == SimdLevel::AVX2) {
+            verticalAVX2(rows.data(), w, count, tmp.data(), bytes);
+            horizontalAVX2(tmp.data(), colStart.data(), colWeights.data(), hTaps, out, dstWidth);
+            continue;
+        }
+        if (level == SimdLevel::SSE41) {
+            verticalSSE41(rows.data(), w, count, tmp.data(), bytes);
+            horizontalSSE41(tmp.data(), colStart.data(), colWeights.data(), hTaps, out, 0, dstWidth);
+            continue;
+        }
+#endif
+        verticalScalar(rows.data(), w, count, tmp.data(), bytes, 0);
+        horizontalScalar(tmp.data(), colStart.data(), colWeights.data(), hTaps, out, 0, dstWidth);
+    }
+}
+
+void ImageScaler::scale(const uint8_t* src, int srcStride, uint8_t* dst, int dstStride, int threads) const {
+    if (threads > dstHeight) threads = dstHeight;
+    if (threads <= 1) {
+        scaleRows(src, srcStride, dst, dstStride, 0, dstHeight);
+        return;
+    }
+    int band = (dstHeight + threads - 1) / threads;
+    std::vector<std::thread> helpers;
+    for (int b = 1; b < threads; ++b) {
+        int first = b * band;
+        int last = std::min(dstHeight, first + band);
+        if (first >= last) break;
+        helpers.emplace_back(&ImageScaler::scaleRows, this, src, srcStride, dst, dstStride, first, last);
+    }
+    scaleRows(src, srcStride, dst, dstStride, 0, std::min(dstHeight, band));
+    for (auto& t : helpers) t.join();
+}
@@ -0,0 +1,64 @@
+#ifndef IMAGE_SCALER_H
+#define IMAGE_SCALER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "../util/cpu_features.h"
+
+enum class ScaleFilter {
+    Box,      // equal weights over the source pixels whose centres fall in the output pixel
+    Bilinear, // two taps per axis at the output pixel centre; cheapest, aliases when shrinking a lot
+    Area      // exact coverage of the output pixel's footprint; best for downscaling
+};
+
+// Separable BGRA resampler for arbitrary ratios. configure() precomputes per-column and
+// per-row tap positions and Q14 weights once; scaling is then a vertical pass into a 16-bit
+// row followed by a horizontal pass, both vectorized (SSE4.1/AVX2, identical results to
+// the scalar path). Output rows are independent, so bands of rows can be scaled on
+// different threads with scaleRows().
+class ImageScaler {
+public:
+    ImageScaler();
+
+    // Returns false for empty sizes. Calling it again with the same arguments is free.
+    bool configure(int srcWidth, int srcHeight, int dstWidth, int dstHeight, ScaleFilter filter);
+    bool configure(int srcWidth, int srcHeight, int dstWidth, int dstHeight, ScaleFilter filter, SimdLevel level);
+
+    // Scale output rows [firstRow, lastRow). Reads only scaler state, so several threads
+    // may scale different bands of the same frame at once.
+    void scaleRows(const uint8_t* src, int srcStride, uint8_t* dst, int dstStride, int firstRow, int lastRow) const;
+
+    // Scale a whole frame, split into bands over this many threads (1 = calling thread)
+    void scale(const uint8_t* src, int srcStride, uint8_t* dst, int dstStride, int threads = 1) const;
+
+    int getSrcWidth() const { return srcWidth; }
+    int getSrcHeight() const { return srcHeight; }
+    int getDstWidth() const { return dstWidth; }
+    int getDstHeight() const { return dstHeight; }
+    ScaleFilter getFilter() const { return filter; }
+
+private:
+    int srcWidth;
+    int srcHeight;
+    int dstWidth;
+    int dstHeight;
+    ScaleFilter filter;
+    SimdLevel level;
+
+    // Horizontal: every output column has hTaps (even) taps from colStart; weights are
+    // pairs (w[2k] | w[2k + 1] << 16) for pmaddwd, zero-padded past the real taps, laid out
+    // in groups of four columns (see image_scaler.cpp)
+    int hTaps;
+    std::vector<int32_t> colStart;
+    std::vector<int32_t> colWeights;
+    int rowPixels;                   // 16-bit row length, taps past the source width included
+
+    // Vertical: output row y blends rowCount[y] source rows from rowStart[y]
+    std::vector<int32_t> rowStart;
+    std::vector<int32_t> rowCount;
+    std::vector<int32_t> rowOffset;  // into rowWeights
+    std::vector<int16_t> rowWeights;
+};
+
+#endif // IMAGE_SCALER_H
@@ -0,0 +1,839 @@
+#include "jpeg_baseline.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef RECORDER_X86
+#include <immintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// ITU T.81 Annex K.1 quantization tables (natural order, quality 50)
+static const uint8_t kLumaQuant[64] = {
+    16, 11, 10, 16, 24, 40, 51, 61,
+    12, 12, 14, 19, 26, 58, 60, 55,
+    14, 13, 16, 24, 40, 57, 69, 56,
+    14, 17, 22, 29, 51, 87, 80, 62,
+    18, 22, 37, 56, 68, 109, 103, 77,
+    24, 35, 55, 64, 81, 104, 113, 92,
+    49, 64, 78, 87, 103, 121, 120, 101,
+    72, 92, 95, 98, 112, 100, 103, 99
+};
+static const uint8_t kChromaQuant[64] = {
+    17, 18, 24, 47, 99, 99, 99, 99,
+    18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99,
+    47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99
+};
+
+// Zigzag position -> natural (row-major) index
+static const uint8_t kZigzag[64] = {
+    0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+};
+
+// Annex K.3 Huffman tables: number of codes of each length 1..16, then the symbols
+static const uint8_t kDcLumaBits[16] = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+static const uint8_t kDcChromaBits[16] = {0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0};
+static const uint8_t kDcVals[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+
+static const uint8_t kAcLumaBits[16] = {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d};
+static const uint8_t kAcLumaVals[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+    0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+    0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa
+};
+static const uint8_t kAcChromaBits[16] = {0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77};
+static const uint8_t kAcChromaVals[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+    0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+    0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+    0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+    0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa
+};
+
+// AAN multipliers in Q15 for the pmulhw-style (2a * c) >> 16; 1.306562965 is applied as
+// 0.306562965 plus the operand itself
+static const int kC0_382 = 12540;  // 0.382683433
+static const int kC0_541 = 17734;  // 0.541196100
+static const int kC0_707 = 23170;  // 0.707106781
+static const int kC0_306 = 10045;  // 0.306562965
+
+// Worst case bytes one MCU (6 blocks) can produce, including 0xFF stuffing
+static const size_t kMcuWorstCase = 4096;
+
+// The DCT leaves the block transposed (index v * 8 + u for vertical frequency u and
+// horizontal frequency v); this maps zigzag positions straight to that layout
+struct ZigzagTransposed {
+    uint8_t index[64];
+    ZigzagTransposed() {
+        for (int k = 0; k < 64; ++k) index[k] = (uint8_t)((kZigzag[k] % 8) * 8 + kZigzag[k] / 8);
+    }
+};
+static const ZigzagTransposed kZigzagT;
+
+struct HuffTable {
+    uint16_t code[256];
+    uint8_t size[256];
+};
+
+// Annex C.2: canonical codes from the per-length counts
+static void buildHuffTable(HuffTable& table, const uint8_t* bits, const uint8_t* vals) {
+    memset(&table, 0, sizeof(table));
+    unsigned code = 0;
+    int k = 0;
+    for (int len = 1; len <= 16; ++len) {
+        for (int i = 0; i < bits[len - 1]; ++i) {
+            table.code[vals[k]] = (uint16_t)code++;
+            table.size[vals[k]] = (uint8_t)len;
+            ++k;
+        }
+        code <<= 1;
+    }
+}
+
+struct HuffTables {
+    HuffTable dc[2];
+    HuffTable ac[2];
+    HuffTables() {
+        buildHuffTable(dc[0], kDcLumaBits, kDcVals);
+        buildHuffTable(dc[1], kDcChromaBits, kDcVals);
+        buildHuffTable(ac[0], kAcLumaBits, kAcLumaVals);
+        buildHuffTable(ac[1], kAcChromaBits, kAcChromaVals);
+    }
+};
+static const HuffTables kHuff;
+
+static inline int bitLength(unsigned v) {
+#ifdef _MSC_VER
+    unsigned long idx;
+    return _BitScanReverse(&idx, v) ? (int)idx + 1 : 0;
+#else
+    return v ? 32 - __builtin_clz(v) : 0;
+#endif
+}
+
+static inline int lowestBit(uint64_t v) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long idx;
+    _BitScanForward64(&idx, v);
+    return (int)idx;
+#elif defined(_MSC_VER)
+    unsigned long idx;
+    if (_BitScanForward(&idx, (unsigned long)v)) return (int)idx;
+    _BitScanForward(&idx, (unsigned long)(v >> 32));
+    return (int)idx + 32;
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+
+// Entropy-coded segment writer: bits collect in a 64-bit accumulator and leave 32 at a time;
+// words without a 0xFF byte (nearly all of them) are stored without the stuffing loop
+struct BitWriter {
+    uint8_t* p;
+    uint64_t acc;
+    int bits;
+
+    // value must fit in len bits; len <= 27 keeps the accumulator below 64 bits
+    inline void put(uint32_t value, int len) {
+        acc = (acc << len) | value;
+        bits += len;
+        if (bits >= 32) {
+            bits -= 32;
+            emit32((uint32_t)(acc >> bits));
+        }
+    }
+
+    inline void emit32(uint32_t w) {
+        uint32_t inv = ~w;
+        if (((inv - 0x01010101u) & ~inv & 0x80808080u) == 0) {
+            p[0] = (uint8_t)(w >> 24);
+            p[1] = (uint8_t)(w >> 16);
+            p[2] = (uint8_t)(w >> 8);
+            p[3] = (uint8_t)w;
+            p += 4;
+            return;
+        }
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            uint8_t b = (uint8_t)(w >> shift);
+            *p++ = b;
+            if (b == 0xFF) *p++ = 0;
+        }
+    }
+
+    // Pad the last byte with 1 bits and write out what is left
+    void flush() {
+        int pad = (8 - (bits & 7)) & 7;
+        if (pad) put((1u << pad) - 1, pad);
+        while (bits >= 8) {
+            bits -= 8;
+            uint8_t b = (uint8_t)(acc >> bits);
+            *p++ = b;
+            if (b == 0xFF) *p++ = 0;
+        }
+    }
+};
+
+static inline void encodeBlock(BitWriter& bw, const int16_t* zz, uint64_t nonzero, int& pred,
+                               const HuffTable& dc, const HuffTable& ac) {
+    int diff = zz[0] - pred;
+    pred = zz[0];
+    int nbits = bitLength((unsigned)(diff < 0 ? -diff : diff));
+    uint32_t extra = (uint32_t)(diff < 0 ? diff - 1 : diff) & ((1u << nbits) - 1);
+    bw.put(((uint32_t)dc.code[nbits] << nbits) | extra, dc.size[nbits] + nbits);
+
+    uint64_t mask = nonzero & ~1ull;
+    int last = 0;
+    while (mask) {
+        int k = lowestBit(mask);
+        mask &= mask - 1;
+        int run = k - last - 1;
+        while (run >= 16) {
+            bw.put(ac.code[0xF0], ac.size[0xF0]);
+            run -= 16;
+        }
+        int v = zz[k];
+        nbits = bitLength((unsigned)(v < 0 ? -v : v));
+        extra = (uint32_t)(v < 0 ? v - 1 : v) & ((1u << nbits) - 1);
+        int sym = (run << 4) | nbits;
+        bw.put(((uint32_t)ac.code[sym] << nbits) | extra, ac.size[sym] + nbits);
+        last = k;
+    }
+    if (last != 63) bw.put(ac.code[0x00], ac.size[0x00]);
+}
+
+// One 8x8 block: level shift, forward DCT, quantize, zigzag. Returns a mask of the nonzero
+// zigzag positions.
+typedef uint64_t (*BlockFn)(const uint8_t* src, int stride, const float* qscale, int16_t* zz);
+
+// ---------------------------------------------------------------------------------------------
+// Scalar kernel. Same fixed-point steps as the SIMD one (no intermediate overflows int16
+// for 8-bit input), so both produce the same coefficients.
+
+static inline int mulq(int a, int c) { return (a * 2 * c) >> 16; }
+
+static void aan8Scalar(int* d, int step) {
+    int tmp0 = d[0] + d[7 * step], tmp7 = d[0] - d[7 * step];
+    int tmp1 = d[step] + d[6 * step], tmp6 = d[step] - d[6 * step];
+    int tmp2 = d[2 * step] + d[5 * step], tmp5 = d[2 * step] - d[5 * step];
+    int tmp3 = d[3 * step] + d[4 * step], tmp4 = d[3 * step] - d[4 * step];
+
+    int tmp10 = tmp0 + tmp3, tmp13 = tmp0 - tmp3;
+    int tmp11 = tmp1 + tmp2, tmp12 = tmp1 - tmp2;
+    d[0] = tmp10 + tmp11;
+    d[4 * step] = tmp10 - tmp11;
+    int z1 = mulq(tmp12 + tmp13, kC0_707);
+    d[2 * step] = tmp13 + z1;
+    d[6 * step] = tmp13 - z1;
+
+    tmp10 = tmp4 + tmp5;
+    tmp11 = tmp5 + tmp6;
+    tmp12 = tmp6 + tmp7;
+    int z5 = mulq(tmp10 - tmp12, kC0_382);
+    int z2 = mulq(tmp10, kC0_541) + z5;
+    int z4 = mulq(tmp12, kC0_306) + tmp12 + z5;
+    int z3 = mulq(tmp11, kC0_707);
+    int z11 = tmp7 + z3, z13 = tmp7 - z3;
+    d[5 * step] = z13 + z2;
+    d[3 * step] = z13 - z2;
+    d[step] = z11 + z4;
+    d[7 * step] = z11 - z4;
+}
+
+static uint64_t blockScalar(const uint8_t* src, int stride, const float* qscale, int16_t* zz) {
+    int d[64];
+    for (int r = 0; r < 8; ++r)
+        for (int c = 0; c < 8; ++c) d[r * 8 + c] = src[(size_t)r * stride + c] - 128;
+    for (int c = 0; c < 8; ++c) aan8Scalar(d + c, 8);
+    for (int u = 0; u < 8; ++u) aan8Scalar(d + u * 8, 1);
+
+    int16_t coef[64];
+    for (int u = 0; u < 8; ++u) {
+        for (int v = 0; v < 8; ++v) {
+            int idx = v * 8 + u;
+            long q = std::lrint((float)d[u * 8 + v] * qscale[idx]);
+            coef[idx] = (int16_t)std::max(-1023L, std::min(1023L, q));
+        }
+    }
+    uint64_t mask = 0;
+    for (int k = 0; k < 64; ++k) {
+        zz[k] = coef[kZigzagT.index[k]];
+        if (zz[k]) mask |= 1ull << k;
+    }
+    return mask;
+}
+
+#ifdef RECORDER_X86
+// ---------------------------------------------------------------------------------------------
+// SSE4.1 kernel: one register per block row, so each 1-D pass transforms all eight columns
+
+RECORDER_TARGET_SSE41 static inline __m128i mulq(__m128i a, __m128i c) {
+    return _mm_mulhi_epi16(_mm_slli_epi16(a, 1), c);
+}
+
+RECORDER_TARGET_SSE41 static inline void aan8(__m128i* d) {
+    __m128i tmp0 = _mm_add_epi16(d[0], d[7]), tmp7 = _mm_sub_epi16(d[0], d[7]);
+    __m128i tmp1 = _mm_add_epi16(d[1], d[6]), tmp6 = _mm_sub_epi16(d[1], d[6]);
+    __m128i tmp2 = _mm_add_epi16(d[2], d[5]), tmp5 = _mm_sub_epi16(d[2], d[5]);
+    __m128i tmp3 = _mm_add_epi16(d[3], d[4]), tmp4 = _mm_sub_epi16(d[3], d[4]);
+
+    __m128i tmp10 = _mm_add_epi16(tmp0, tmp3), tmp13 = _mm_sub_epi16(tmp0, tmp3);
+    __m128i tmp11 = _mm_add_epi16(tmp1, tmp2), tmp12 = _mm_sub_epi16(tmp1, tmp2);
+    d[0] = _mm_add_epi16(tmp10, tmp11);
+    d[4] = _mm_sub_epi16(tmp10, tmp11);
+    __m128i z1 = mulq(_mm_add_epi16(tmp12, tmp13), _mm_set1_epi16(kC0_707));
+    d[2] = _mm_add_epi16(tmp13, z1);
+    d[6] = _mm_sub_epi16(tmp13, z1);
+
+    tmp10 = _mm_add_epi16(tmp4, tmp5);
+    tmp11 = _mm_add_epi16(tmp5, tmp6);
+    tmp12 = _mm_add_epi16(tmp6, tmp7);
+    __m128i z5 = mulq(_mm_sub_epi16(tmp10, tmp12), _mm_set1_epi16(kC0_382));
+    __m128i z2 = _mm_add_epi16(mulq(tmp10, _mm_set1_epi16(kC0_541)), z5);
+    __m128i z4 = _mm_add_epi16(_mm_add_epi16(mulq(tmp12, _mm_set1_epi16(kC0_306)), tmp12), z5);
+    __m128i z3 = mulq(tmp11, _mm_set1_epi16(kC0_707));
+    __m128i z11 = _mm_add_epi16(tmp7, z3), z13 = _mm_sub_epi16(tmp7, z3);
+    d[5] = _mm_add_epi16(z13, z2);
+    d[3] = _mm_sub_epi16(z13, z2);
+    d[1] = _mm_add_epi16(z11, z4);
+    d[7] = _mm_sub_epi16(z11, z4);
+}
+
+RECORDER_TARGET_SSE41 static inline void transpose8(__m128i* r) {
+    __m128i a0 = _mm_unpacklo_epi16(r[0], r[1]), a1 = _mm_unpackhi_epi16(r[0], r[1]);
+    __m128i a2 = _mm_unpacklo_epi16(r[2], r[3]), a3 = _mm_unpackhi_epi16(r[2], r[3]);
+    __m128i a4 = _mm_unpacklo_epi16(r[4], r[5]), a5 = _mm_unpackhi_epi16(r[4], r[5]);
+    __m128i a6 = _mm_unpacklo_epi16(r[6], r[7]), a7 = _mm_unpackhi_epi16(r[6], r[7]);
+    __m128i b0 = _mm_unpacklo_epi32(a0, a2), b1 = _mm_unpackhi_epi32(a0, a2);
+    __m128i b2 = _mm_unpacklo_epi32(a1, a3), b3 = _mm_unpackhi_epi32(a1, a3);
+    __m128i b4 = _mm_unpacklo_epi32(a4, a6), b5 = _mm_unpackhi_epi32(a4, a6);
+    __m128i b6 = _mm_unpacklo_epi32(a5, a7), b7 = _mm_unpackhi_epi32(a5, a7);
+    r[0] = _mm_unpacklo_epi64(b0, b4);
+    r[1] = _mm_unpackhi_epi64(b0, b4);
+    r[2] = _mm_unpacklo_epi64(b1, b5);
+    r[3] = _mm_unpackhi_epi64(b1, b5);
+    r[4] = _mm_unpacklo_epi64(b2, b6);
+    r[5] = _mm_unpackhi_epi64(b2, b6);
+    r[6] = _mm_unpacklo_epi64(b3, b7);
+    r[7] = _mm_unpackhi_epi64(b3, b7);
+}
+
+RECORDER_TARGET_SSE41 static uint64_t blockSSE41(const uint8_t* src, int stride, const float* qscale, int16_t* zz) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16(128);
+    __m128i r[8];
+    for (int i = 0; i < 8; ++i) {
+        __m128i px = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + (size_t)i * stride));
+        r[i] = _mm_sub_epi16(_mm_unpacklo_epi8(px, zero), bias);
+    }
+    aan8(r);
+    transpose8(r);
+    aan8(r);
+
+    // Fused descale + quantize: one multiply by 1 / (q * AAN scale), round to nearest
+    alignas(16) int16_t coef[64];
+    const __m128i hiLimit = _mm_set1_epi16(1023);
+    const __m128i loLimit = _mm_set1_epi16(-1023);
+    for (int i = 0; i < 8; ++i) {
+        __m128 lo = _mm_cvtepi32_ps(_mm_cvtepi16_epi32(r[i]));
+        __m128 hi = _mm_cvtepi32_ps(_mm_cvtepi16_epi32(_mm_srli_si128(r[i], 8)));
+        lo = _mm_mul_ps(lo, _mm_load_ps(qscale + i * 8));
+        hi = _mm_mul_ps(hi, _mm_load_ps(qscale + i * 8 + 4));
+        __m128i q = _mm_packs_epi32(_mm_cvtps_epi32(lo), _mm_cvtps_epi32(hi));
+        q = _mm_max_epi16(_mm_min_epi16(q, hiLimit), loLimit);
+        _mm_store_si128(reinterpret_cast<__m128i*>(coef + i * 8), q);
+    }
+
+    for (int k = 0; k < 64; ++k) zz[k] = coef[kZigzagT.index[k]];
+    uint64_t mask = 0;
+    for (int i = 0; i < 64; i += 16) {
+        __m128i a = _mm_cmpeq_epi16(_mm_load_si128(reinterpret_cast<const __m128i*>(zz + i)), zero);
+        __m128i b = _mm_cmpeq_epi16(_mm_load_si128(reinterpret_cast<const __m128i*>(zz + i + 8)), zero);
+        unsigned zeros = (unsigned)_mm_movemask_epi8(_mm_packs_epi16(a, b));
+        mask |= (uint64_t)(~zeros & 0xFFFFu) << i;
+    }
+    return mask;
+}
+#endif // RECORDER_X86
+
+// ---------------------------------------------------------------------------------------------
+
+JpegBaselineEncoder::JpegBaselineEncoder()
+    : quality(75), restartRows(0), abbreviated(false), level(simdLevel()), headerWidth(0), headerHeight(0) {
+    buildTables();
+}
+
+void JpegBaselineEncoder::setQuality(int q) {
+    if (q < 1) q = 1;
+    if (q > 100) q = 100;
+    if (q == quality) return;
+    quality = q;
+    buildTables();
+}
+
+void JpegBaselineEncoder::setRestartRows(int rows) {
+    if (rows < 0) rows = 0;
+    if (rows == restartRows) return;
+    restartRows = rows;
+    headerWidth = headerHeight = 0; // DRI changed
+}
+
+void JpegBaselineEncoder::setAbbreviated(bool on) {
+    if (on == abbreviated) return;
+    abbreviated = on;
+    headerWidth = headerHeight = 0; // APP0 and DHT changed
+}
+
+static const double kPi = 3.14159265358979323846;
+
+// IJG quality scaling of the Annex K tables (natural order)
+static void scaledQuantTable(int quality, int table, int natural[64]) {
+    int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+    const uint8_t* base = table == 0 ? kLumaQuant : kChromaQuant;
+    for (int i = 0; i < 64; ++i) {
+        int v = (base[i] * scale + 50) / 100;
+        natural[i] = std::max(1, std::min(255, v));
+    }
+}
+
+void JpegBaselineEncoder::buildTables() {
+    double aan[8];
+    aan[0] = 1.0;
+    for (int k = 1; k < 8; ++k) aan[k] = std::cos(k * kPi / 16.0) * std::sqrt(2.0);
+
+    for (int t = 0; t < 2; ++t) {
+        int natural[64];
+        scaledQuantTable(quality, t, natural);
+        for (int k = 0; k < 64; ++k) qtable[t][k] = (uint8_t)natural[kZigzag[k]];
+        // The AAN outputs are 8 * aan[u] * aan[v] times the true coefficients
+        for (int u = 0; u < 8; ++u)
+            for (int v = 0; v < 8; ++v)
+                qscale[t][v * 8 + u] = (float)(1.0 / (natural[u * 8 + v] * aan[u] * aan[v] * 8.0));
+    }
+    headerWidth = headerHeight = 0; // DQT changed
+}
+
+void JpegBaselineEncoder::buildHeader(int width, int height) {
+    header.clear();
+    auto put8 = [this](int v) { header.push_back((uint8_t)v); };
+    auto put16 = [this](int v) {
+        header.push_back((uint8_t)(v >> 8));
+        header.push_back((uint8_t)v);
+    };
+    auto putHuff = [&](int classId, const uint8_t* bits, const uint8_t* vals) {
+        int count = 0;
+        for (int i = 0; i < 16; ++i) count += bits[i];
+        put8(classId);
+        header.insert(header.end(), bits, bits + 16);
+        header.insert(header.end(), vals, vals + count);
+    };
+
+    put16(0xFFD8); // SOI
+
+    if (abbreviated) {
+        put16(0xFFE0); // APP0 AVI1, not interlaced, field sizes unknown
+        put16(16);
+        static const char kAvi1[4] = {'A', 'V', 'I', '1'};
+        header.insert(header.end(), kAvi1, kAvi1 + 4);
+        put8(0); put8(0); put16(0); put16(0); put16(0); put16(0);
+    } else {
+        put16(0xFFE0); // APP0 JFIF 1.01, no density, no thumbnail
+        put16(16);
+        static const char kJfif[5] = {'J', 'F', 'I', 'F', 0};
+        header.insert(header.end(), kJfif, kJfif + 5);
+        put8(1); put8(1); put8(0); put16(1); put16(1); put8(0); put8(0);
+    }
+
+    put16(0xFFDB); // DQT, both tables in one segment
+    put16(2 + 2 * 65);
+    for (int t = 0; t < 2; ++t) {
+        put8(t);
+        header.insert(header.end(), qtable[t], qtable[t] + 64);
+    }
+
+    put16(0xFFC0); // SOF0: Y 2x2, Cb and Cr 1x1
+    put16(17);
+    put8(8);
+    put16(height);
+    put16(width);
+    put8(3);
+    put8(1); put8(0x22); put8(0);
+    put8(2); put8(0x11); put8(1);
+    put8(3); put8(0x11); put8(1);
+
+    if (!abbreviated) {
+        put16(0xFFC4); // DHT, all four tables in one segment
+        put16(2 + 4 * 17 + 12 + 12 + 162 + 162);
+        putHuff(0x00, kDcLumaBits, kDcVals);
+        putHuff(0x10, kAcLumaBits, kAcLumaVals);
+        putHuff(0x01, kDcChromaBits, kDcVals);
+        putHuff(0x11, kAcChromaBits, kAcChromaVals);
+    }
+
+    if (restartRows > 0) {
+        put16(0xFFDD); // DRI
+        put16(4);
+        put16(restartRows * ((width + 15) / 16));
+    }
+
+    put16(0xFFDA); // SOS
+    put16(12);
+    put8(3);
+    put8(1); put8(0x00);
+    put8(2); put8(0x11);
+    put8(3); put8(0x11);
+    put8(0); put8(63); put8(0);
+
+    headerWidth = width;
+    headerHeight = height;
+}
+
+void JpegBaselineEncoder::writeHeader(const YUV420Planes& planes, PacketBuffer& out) {
+    if (planes.width != headerWidth || planes.height != headerHeight) buildHeader(planes.width, planes.height);
+    out.assign(header.begin(), header.end());
+}
+
+void JpegBaselineEncoder::encodeRows(const YUV420Planes& planes, int firstRow, int lastRow,
+                                     PacketBuffer& out) const {
+    BlockFn block = blockScalar;
+#ifdef RECORDER_X86
+    if (level != SimdLevel::Scalar) block = blockSSE41;
+#endif
+
+    // Grow into the buffer's capacity first so a recycled buffer is reused as is
+    const size_t start = out.size();
+    const int mcuCols = planes.paddedWidth / 16;
+    size_t estimate = start + (size_t)planes.width * (lastRow - firstRow) * 4 + 2 * kMcuWorstCase;
+    out.resize(std::max(out.capacity(), estimate));
+
+    BitWriter bw;
+    bw.p = out.data() + start;
+    bw.acc = 0;
+    bw.bits = 0;
+    uint8_t* limit = out.data() + out.size() - kMcuWorstCase;
+
+    alignas(16) int16_t zz[64];
+    int pred[3] = {0, 0, 0};
+    const int ys = planes.yStride;
+    const int cs = planes.cStride;
+    for (int my = firstRow; my < lastRow; ++my) {
+        const uint8_t* yRow = planes.y + (size_t)my * 16 * ys;
+        const uint8_t* cbRow = planes.cb + (size_t)my * 8 * cs;
+        const uint8_t* crRow = planes.cr + (size_t)my * 8 * cs;
+        for (int mx = 0; mx < mcuCols; ++mx) {
+            if (bw.p > limit) {
+                size_t pos = bw.p - out.data();
+                out.resize(out.size() * 2);
+                bw.p = out.data() + pos;
+                limit = out.data() + out.size() - kMcuWorstCase;
+            }
+            const uint8_t* y0 = yRow + mx * 16;
+            uint64_t nz = block(y0, ys, qscale[0], zz);
+            encodeBlock(bw, zz, nz, pred[0], kHuff.dc[0], kHuff.ac[0]);
+            nz = block(y0 + 8, ys, qscale[0], zz);
+            encodeBlock(bw, zz, nz, pred[0], kHuff.dc[0], kHuff.ac[0]);
+            nz = block(y0 + (size_t)8 * ys, ys, qscale[0], zz);
+            encodeBlock(bw, zz, nz, pred[0], kHuff.dc[0], kHuff.ac[0]);
+            nz = block(y0 + (size_t)8 * ys + 8, ys, qscale[0], zz);
+            encodeBlock(bw, zz, nz, pred[0], kHuff.dc[0], kHuff.ac[0]);
+            nz = block(cbRow + mx * 8, cs, qscale[1], zz);
+            encodeBlock(bw, zz, nz, pred[1], kHuff.dc[1], kHuff.ac[1]);
+            nz = block(crRow + mx * 8, cs, qscale[1], zz);
+            encodeBlock(bw, zz, nz, pred[2], kHuff.dc[1], kHuff.ac[1]);
+        }
+    }
+    bw.flush();
+    out.resize(bw.p - out.data());
+}
+
+void JpegBaselineEncoder::appendRestartMarker(PacketBuffer& out, int index) {
+    out.push_back(0xFF);
+    out.push_back((uint8_t)(0xD0 + (index & 7)));
+}
+
+void JpegBaselineEncoder::appendEOI(PacketBuffer& out) {
+    out.push_back(0xFF);
+    out.push_back(0xD9);
+}
+
+void JpegBaselineEncoder::encode(const YUV420Planes& planes, PacketBuffer& out) {
+    writeHeader(planes, out);
+    const int mcuRows = planes.paddedHeight / 16;
+    const int interval = restartRows > 0 ? restartRows : mcuRows;
+    for (int row = 0, index = 0; row < mcuRows; row += interval, ++index) {
+        if (index > 0) appendRestartMarker(out, index - 1);
+        encodeRows(planes, row, std::min(mcuRows, row + interval), out);
+    }
+    appendEOI(out);
+}
+
+// Length of standard table tc (class << 4 | id) if p holds exactly it, else 0
+static size_t matchStandardHuff(int tc, const uint8_t* p, size_t avail) {
+    const uint8_t* bits;
+    const uint8_t* vals;
+    switch (tc) {
+    case 0x00: bits = kDcLumaBits; vals = kDcVals; break;
+    case 0x01: bits = kDcChromaBits; vals = kDcVals; break;
+    case 0x10: bits = kAcLumaBits; vals = kAcLumaVals; break;
+    case 0x11: bits = kAcChromaBits; vals = kAcChromaVals; break;
+    default: return 0;
+    }
+    size_t count = 0;
+    for (int i = 0; i < 16; ++i) count += bits[i];
+    if (avail < 16 + count) return 0;
+    if (memcmp(p, bits, 16) != 0 || memcmp(p + 16, vals, count) != 0) return 0;
+    return 16 + count;
+}
+
+static bool isJfifApp0(const uint8_t* segment, size_t length) {
+    return segment[1] == 0xE0 && length >= 16 && memcmp(segment + 4, "JFIF", 5) == 0;
+}
+
+size_t abbreviateJpeg(uint8_t* data, size_t size) {
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) return size;
+
+    // First pass: every segment up to SOS is complete and every table is a standard one
+    size_t pos = 2;
+    for (;;) {
+        if (pos + 4 > size || data[pos] != 0xFF) return size;
+        int marker = data[pos + 1];
+        size_t length = ((size_t)data[pos + 2] << 8) | data[pos + 3];
+        if (length < 2 || pos + 2 + length > size) return size;
+        if (marker == 0xDA) break;
+        if (marker == 0xC4) {
+            const uint8_t* p = data + pos + 4;
+            const uint8_t* end = data + pos + 2 + length;
+            while (p < end) {
+                size_t n = matchStandardHuff(p[0], p + 1, (size_t)(end - p - 1));
+                if (n == 0) return size;
+                p += 1 + n;
+            }
+        }
+        pos += 2 + length;
+    }
+
+    // Second pass: compact in place; segments only shrink, so writes never overtake reads
+    static const uint8_t kAvi1App0[18] = {0xFF, 0xE0, 0, 16, 'A', 'V', 'I', '1'};
+    size_t in = 2, out = 2;
+    for (;;) {
+        size_t length = ((size_t)data[in + 2] << 8) | data[in + 3];
+        if (data[in + 1] == 0xDA) break;
+        if (data[in + 1] == 0xC4) {
+            // implied by AVI1
+        } else if (isJfifApp0(data + in, length)) {
+            memcpy(data + out, kAvi1App0, sizeof(kAvi1App0));
+            out += sizeof(kAvi1App0);
+        } else {
+            memmove(data + out, data + in, 2 + length);
+            out += 2 + length;
+        }
+        in += 2 + length;
+    }
+    memmove(data + out, data + in, size - in);
+    return out + (size - in);
+}
+
+// ---------------------------------------------------------------------------------------------
+// Scan decoder
+
+// Annex F.2.2.3 decoding tables: codes of length l are mincode[l]..maxcode[l]
+struct HuffDecodeTable {
+    int mincode[17];
+    int maxcode[18];
+    int valptr[17];
+    const uint8_t* vals;
+};
+
+static void buildHuffDecodeTable(HuffDecodeTable& table, const uint8_t* bits, const uint8_t* vals) {
+    int code = 0;
+    int k = 0;
+    for (int len = 1; len <= 16; ++len) {
+        table.valptr[len] = k;
+        table.mincode[len] = code;
+        code += bits[len - 1];
+        k += bits[len - 1];
+        table.maxcode[len] = bits[len - 1] ? code - 1 : -1;
+        code <<= 1;
+    }
+    table.maxcode[17] = 0x7FFFFFFF; // sentinel
+    table.vals = vals;
+}
+
+struct HuffDecodeTables {
+    HuffDecodeTable dc[2];
+    HuffDecodeTable ac[2];
+    HuffDecodeTables() {
+        buildHuffDecodeTable(dc[0], kDcLumaBits, kDcVals);
+        buildHuffDecodeTable(dc[1], kDcChromaBits, kDcVals);
+        buildHuffDecodeTable(ac[0], kAcLumaBits, kAcLumaVals);
+        buildHuffDecodeTable(ac[1], kAcChromaBits, kAcChromaVals);
+    }
+};
+static const HuffDecodeTables kHuffDecode;
+
+// Reads an entropy-coded segment, dropping the stuffed zero after each 0xFF. Past the end
+// (or at a marker) it feeds 1 bits, which is what the encoder padded with.
+struct BitReader {
+    const uint8_t* p;
+    const uint8_t* end;
+    uint32_t acc;
+    int bits;
+    bool overrun;
+
+    int bit() {
+        if (bits == 0) {
+            uint8_t b = 0xFF;
+            if (p < end) {
+                b = *p++;
+                if (b == 0xFF) {
+                    if (p < end && *p == 0x00) ++p;
+                    else { p = end; overrun = true; }
+                }
+            } else {
+                overrun = true;
+            }
+            acc = b;
+            bits = 8;
+        }
+        --bits;
+        return (acc >> bits) & 1;
+    }
+
+    int get(int n) {
+        int v = 0;
+        for (int i = 0; i < n; ++i) v = (v << 1) | bit();
+        return v;
+    }
+
+    int decode(const HuffDecodeTable& t) {
+        int code = bit();
+        int len = 1;
+        while (code > t.maxcode[len]) {
+            code = (code << 1) | bit();
+            if (++len > 16) return -1;
+        }
+        return t.vals[t.valptr[len] + code - t.mincode[len]];
+    }
+
+    // Annex F.2.2.1 EXTEND
+    int receive(int size) {
+        if (size == 0) return 0;
+        int v = get(size);
+        return v < (1 << (size - 1)) ? v - (1 << size) + 1 : v;
+    }
+};
+
+JpegScanDecoder::JpegScanDecoder() : quality(0) {
+    for (int k = 0; k < 8; ++k)
+        for (int n = 0; n < 8; ++n)
+            idctTable[k * 8 + n] = (float)((k == 0 ? std::sqrt(0.5) : 1.0) * 0.5 * std::cos((2 * n + 1) * k * kPi / 16.0));
+    setQuality(75);
+}
+
+void JpegScanDecoder::setQuality(int q) {
+    if (q < 1) q = 1;
+    if (q > 100) q = 100;
+    if (q == quality) return;
+    quality = q;
+    for (int t = 0; t < 2; ++t) scaledQuantTable(quality, t, dequant[t]);
+}
+
+// Plain separable float IDCT of a dequantized block (natural order) into 8x8 pixels
+static void idctBlock(const float* coef, const float* table, uint8_t* dst, int stride) {
+    float tmp[64];
+    for (int u = 0; u < 8; ++u) {
+        for (int x = 0; x < 8; ++x) {
+            float s = 0.0f;
+            for (int v = 0; v < 8; ++v) s += table[v * 8 + x] * coef[u * 8 + v];
+            tmp[u * 8 + x] = s;
+        }
+    }
+    for (int y = 0; y < 8; ++y) {
+        for (int x = 0; x < 8; ++x) {
+            float s = 128.5f;
+            for (int u = 0; u < 8; ++u) s += table[u * 8 + y] * tmp[u * 8 + x];
+            int v = (int)s;
+            dst[(size_t)y * stride + x] = (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+        }
+    }
+}
+
+bool JpegScanDecoder::decodeRows(const uint8_t* data, size_t size, YUV420Planes& planes, int firstRow,
+                                 int lastRow) const {
+    BitReader br;
+    br.p = data;
+    br.end = data + size;
+    br.acc = 0;
+    br.bits = 0;
+    br.overrun = false;
+
+    int pred[3] = {0, 0, 0};
+    float coef[64];
+    const int mcuCols = planes.paddedWidth / 16;
+    for (int my = firstRow; my < lastRow; ++my) {
+        for (int mx = 0; mx < mcuCols; ++mx) {
+            for (int b = 0; b < 6; ++b) {
+                int comp = b < 4 ? 0 : b - 3;
+                int t = comp == 0 ? 0 : 1;
+                std::fill(coef, coef + 64, 0.0f);
+
+                int s = br.decode(kHuffDecode.dc[t]);
+                if (s < 0 || s > 11) return false;
+                pred[comp] += br.receive(s);
+                coef[0] = (float)(pred[comp] * dequant[t][0]);
+                for (int k = 1; k < 64;) {
+                    int rs = br.decode(kHuffDecode.ac[t]);
+                    if (rs < 0) return false;
+                    int run = rs >> 4;
+                    s = rs & 15;
+                    if (s == 0) {
+                        if (run != 15) break; // EOB
+                        k += 16;
+                        continue;
+                    }
+                    k += run;
+                    if (k > 63) return false;
+                    int nat = kZigzag[k];
+                    coef[nat] = (float)(br.receive(s) * dequant[t][nat]);
+                    ++k;
+                }
+                if (br.overrun) return false;
+
+                uint8_t* dst;
+                int stride;
+                if (comp == 0) {
+                    stride = planes.yStride;
+                    dst = planes.y + (size_t)(my * 16 + (b >> 1) * 8) * stride + mx * 16 + (b & 1) * 8;
+                } else {
+                    stride = planes.cStride;
+                    dst = (comp == 1 ? planes.cb : planes.cr) + (size_t)my * 8 * stride + mx * 8;
+                }
+                idctBlock(coef, idctTable, dst, stride);
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,95 @@
+#ifndef JPEG_BASELINE_H
+#define JPEG_BASELINE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "color_convert.h"
+#include "../io/packets.h"
+#include "../util/cpu_features.h"
+
+// Portable baseline JPEG encoder (8-bit sequential DCT, standard Huffman tables, 4:2:0)
+// working straight from YUV420Planes. The forward DCT is the AAN integer transform run on
+// eight columns at once; its output scaling is folded into the quantizer tables so descale
+// and quantize are a single multiply per coefficient. Tables and the header bytes are
+// rebuilt only when the quality, the frame size or the restart interval changes.
+//
+// With a restart interval the scan is split into stripes of whole MCU rows separated by
+// RSTn markers. Each stripe starts with fresh DC predictors on a byte boundary, so stripes
+// can be entropy-coded on different threads and concatenated: writeHeader(), then
+// encodeRows() per stripe, appendRestartMarker() between them and appendEOI() at the end.
+//
+// Abbreviated (AVI1) frames leave out the DHT segment: Motion-JPEG decoders fill in the
+// standard tables this encoder always uses when a frame has none, as AVI1 specifies. The
+// quantization tables cannot be implied and stay, merged into one DQT segment.
+class JpegBaselineEncoder {
+public:
+    JpegBaselineEncoder();
+
+    void setQuality(int quality);
+    int getQuality() const { return quality; }
+
+    // MCU rows (16 pixel rows) per restart interval; 0 (default) writes no DRI/RSTn.
+    // One interval must not exceed 65535 MCUs.
+    void setRestartRows(int rows);
+    int getRestartRows() const { return restartRows; }
+
+    // Write AVI1 Motion-JPEG frames (AVI1 APP0, no DHT) instead of full JFIF images;
+    // default off. Saves 420 bytes per frame.
+    void setAbbreviated(bool abbreviated);
+    bool getAbbreviated() const { return abbreviated; }
+
+    // Encode planes padded with padYUV420ToMCU as one JFIF image; out is resized to the
+    // image length (its capacity is kept, so a reused buffer does not reallocate)
+    void encode(const YUV420Planes& planes, PacketBuffer& out);
+
+    // Replace out with the SOI .. SOS header for planes
+    void writeHeader(const YUV420Planes& planes, PacketBuffer& out);
+    // Append the entropy-coded MCU rows [firstRow, lastRow), byte aligned. Only reads
+    // encoder state, so several threads may encode different stripes at once.
+    void encodeRows(const YUV420Planes& planes, int firstRow, int lastRow, PacketBuffer& out) const;
+    // RSTn that goes after restart interval index (n = index % 8)
+    static void appendRestartMarker(PacketBuffer& out, int index);
+    static void appendEOI(PacketBuffer& out);
+
+private:
+    void buildTables();
+    void buildHeader(int width, int height);
+
+    int quality;
+    int restartRows;
+    bool abbreviated;
+    SimdLevel level;
+    uint8_t qtable[2][64];            // luma, chroma in zigzag order, as written to DQT
+    alignas(16) float qscale[2][64];  // 1 / (q * AAN scale) in the DCT's output order
+    std::vector<uint8_t> header;      // SOI .. SOS for headerWidth x headerHeight and restartRows
+    int headerWidth;
+    int headerHeight;
+};
+
+// Rewrite a baseline JFIF image coded with the standard Huffman tables (such as TurboJPEG
+// output) into an abbreviated AVI1 frame in place, as setAbbreviated() writes them: the
+// JFIF APP0 becomes an AVI1 one and DHT segments are dropped. Returns the new length; an
+// image with other Huffman tables or an unexpected layout is left as it is.
+size_t abbreviateJpeg(uint8_t* data, size_t size);
+
+// Decoder for bare scans written by JpegBaselineEncoder::encodeRows() at a known quality
+// (standard Huffman tables, 4:2:0, no markers), for formats that store tiles or stripes
+// without JPEG headers. Float IDCT; meant for tools and playback, not the capture path.
+class JpegScanDecoder {
+public:
+    JpegScanDecoder();
+
+    void setQuality(int quality);
+
+    // Decode MCU rows [firstRow, lastRow) from data into planes (allocated by the caller,
+    // padding included). Returns false on corrupt or truncated data.
+    bool decodeRows(const uint8_t* data, size_t size, YUV420Planes& planes, int firstRow, int lastRow) const;
+
+private:
+    int quality;
+    int dequant[2][64];   // natural order
+    float idctTable[64];  // C(k) / 2 * cos((2n + 1) k pi / 16), [k * 8 + n]
+};
+
+#endif // JPEG_BASELINE_H
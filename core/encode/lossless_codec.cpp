@@ -0,0 +1,429 @@
+#include "lossless_codec.h"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#ifdef RECORDER_X86
+#include <immintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static const int kHeaderBytes = 12;
+static const int kMaxUpRun = 64;
+static const int kMaxRun = 62;
+static const uint8_t kOpRgb = 0xFE;
+// Bytes of the op in a precomputed op word, by its top two tag bits (DIFF, LUMA, RGB)
+static const int kOpLength[4] = {0, 1, 2, 4};
+
+static void store16(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void store32(uint8_t* p, uint32_t v) {
+    store16(p, v & 0xFFFF);
+    store16(p + 2, v >> 16);
+}
+
+static uint32_t get16(const uint8_t* p) { return (uint32_t)p[0] | ((uint32_t)p[1] << 8); }
+static uint32_t get32(const uint8_t* p) { return get16(p) | (get16(p + 2) << 16); }
+
+// Pixels and op words are moved as host uint32s: little-endian hosts only (x86, ARM)
+static inline uint32_t loadPixel(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static inline int lowestBit(uint64_t v) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long idx;
+    _BitScanForward64(&idx, v);
+    return (int)idx;
+#elif defined(_MSC_VER)
+    unsigned long idx;
+    if (_BitScanForward(&idx, (unsigned long)v)) return (int)idx;
+    _BitScanForward(&idx, (unsigned long)(v >> 32));
+    return (int)idx + 32;
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+
+static inline bool maskBit(const uint64_t* mask, int x) {
+    return (mask[x >> 6] >> (x & 63)) & 1;
+}
+
+// First pixel from x on (width if none) with a bit in either mask
+static int nextRunStart(const uint64_t* a, const uint64_t* b, int x, int width) {
+    while (x < width) {
+        uint64_t bits = (a[x >> 6] | b[x >> 6]) >> (x & 63);
+        if (bits) return std::min(width, x + lowestBit(bits));
+        x = (x | 63) + 1;
+    }
+    return width;
+}
+
+// Set bits from x on, at most limit; bits past the row end are always clear
+static int runLength(const uint64_t* mask, int x, int limit) {
+    int n = 0;
+    while (n < limit) {
+        int pos = x + n;
+        uint64_t clear = ~(mask[pos >> 6] >> (pos & 63));
+        int ones = clear ? lowestBit(clear) : 64;
+        n += ones;
+        if (ones < 64 - (pos & 63)) break;
+    }
+    return std::min(n, limit);
+}
+
+// ---------------------------------------------------------------------------------------------
+// Prediction: op word and run bits for pixels [from, to) of a row. left is the pixel before
+// x = 0; up is the row above or nullptr.
+
+static inline uint32_t pixelOp(uint32_t p, uint32_t l) {
+    int db = (int8_t)(uint8_t)(p - l);
+    int dg = (int8_t)(uint8_t)((p >> 8) - (l >> 8));
+    int dr = (int8_t)(uint8_t)((p >> 16) - (l >> 16));
+    if ((uint8_t)(db + 2) < 4 && (uint8_t)(dg + 2) < 4 && (uint8_t)(dr + 2) < 4) {
+        return 0x40u | (uint32_t)(db + 2) << 4 | (uint32_t)(dg + 2) << 2 | (uint32_t)(dr + 2);
+    }
+    int dbg = (int8_t)(uint8_t)(db - dg);
+    int drg = (int8_t)(uint8_t)(dr - dg);
+    if ((uint8_t)(dg + 32) < 64 && (uint8_t)(drg + 8) < 16 && (uint8_t)(dbg + 8) < 16) {
+        return 0x80u | (uint32_t)(dg + 32) | (uint32_t)(drg + 8) << 12 | (uint32_t)(dbg + 8) << 8;
+    }
+    return kOpRgb | (p & 0xFFFFFF) << 8;
+}
+
+static void predictScalar(const uint8_t* cur, const uint8_t* up, uint32_t left, int from, int to, uint32_t* ops,
+                          uint64_t* leftMask, uint64_t* upMask) {
+    if (from > 0) left = loadPixel(cur + (size_t)(from - 1) * 4);
+    for (int x = from; x < to; ++x) {
+        uint32_t p = loadPixel(cur + (size_t)x * 4);
+        if (((p ^ left) & 0xFFFFFF) == 0) leftMask[x >> 6] |= 1ull << (x & 63);
+        if (up && ((p ^ loadPixel(up + (size_t)x * 4)) & 0xFFFFFF) == 0) upMask[x >> 6] |= 1ull << (x & 63);
+        ops[x] = pixelOp(p, left);
+        left = p;
+    }
+}
+
+#ifdef RECORDER_X86
+// Four pixels from x (> 0, a multiple of 4): ops stored, run bits returned in bits 0-3 / 4-7
+RECORDER_TARGET_SSE41 static inline int predictQuadSSE41(const uint8_t* cur, const uint8_t* up, int x,
+                                                         uint32_t* ops) {
+    const __m128i rgb = _mm_set1_epi32(0x00FFFFFF);
+    __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + (size_t)x * 4));
+    __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + (size_t)x * 4 - 4));
+    int bits = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(p, rgb), _mm_and_si128(l, rgb))));
+    if (up) {
+        __m128i u = _mm_loadu_si128(reinterpret_cast<const __m128i*>(up + (size_t)x * 4));
+        bits |= _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(p, rgb), _mm_and_si128(u, rgb)))) << 4;
+    }
+
+    __m128i d = _mm_sub_epi8(p, l);
+    // DIFF: every channel + 2 in 0..3
+    __m128i t = _mm_add_epi8(d, _mm_set1_epi8(2));
+    __m128i diffOk = _mm_cmpeq_epi32(_mm_and_si128(t, _mm_set1_epi32(0x00FCFCFC)), _mm_setzero_si128());
+    __m128i three = _mm_set1_epi32(3);
+    __m128i diffOp = _mm_or_si128(
+        _mm_or_si128(_mm_set1_epi32(0x40), _mm_slli_epi32(_mm_and_si128(t, three), 4)),
+        _mm_or_si128(_mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(t, 8), three), 2),
+                     _mm_and_si128(_mm_srli_epi32(t, 16), three)));
+    // LUMA: dg + 32 in byte 1, (db - dg) + 8 and (dr - dg) + 8 in bytes 0 and 2
+    __m128i dg = _mm_shuffle_epi8(d, _mm_setr_epi8(1, 1, 1, 1, 5, 5, 5, 5, 9, 9, 9, 9, 13, 13, 13, 13));
+    __m128i g = _mm_add_epi8(d, _mm_set1_epi32(0x2000));
+    __m128i e = _mm_add_epi8(_mm_sub_epi8(d, dg), _mm_set1_epi32(0x00080008));
+    __m128i lumaOk = _mm_cmpeq_epi32(_mm_or_si128(_mm_and_si128(g, _mm_set1_epi32(0xC000)),
+                                                  _mm_and_si128(e, _mm_set1_epi32(0x00F000F0))),
+                                     _mm_setzero_si128());
+    __m128i lumaOp = _mm_or_si128(
+        _mm_or_si128(_mm_set1_epi32(0x80), _mm_and_si128(_mm_srli_epi32(g, 8), _mm_set1_epi32(0x3F))),
+        _mm_or_si128(_mm_and_si128(_mm_srli_epi32(e, 4), _mm_set1_epi32(0xF000)),
+                     _mm_and_si128(_mm_slli_epi32(e, 8), _mm_set1_epi32(0x0F00))));
+    __m128i rgbOp = _mm_or_si128(_mm_slli_epi32(p, 8), _mm_set1_epi32(kOpRgb));
+
+    __m128i op = _mm_blendv_epi8(_mm_blendv_epi8(rgbOp, lumaOp, lumaOk), diffOp, diffOk);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(ops + x), op);
+    return bits;
+}
+
+RECORDER_TARGET_SSE41 static void predictSSE41(const uint8_t* cur, const uint8_t* up, uint32_t left, int width,
+                                               uint32_t* ops, uint64_t* leftMask, uint64_t* upMask) {
+    int head = std::min(width, 4);
+    predictScalar(cur, up, left, 0, head, ops, leftMask, upMask);
+    int x = head;
+    for (; x + 4 <= width; x += 4) {
+        int bits = predictQuadSSE41(cur, up, x, ops);
+        leftMask[x >> 6] |= (uint64_t)(bits & 15) << (x & 63);
+        upMask[x >> 6] |= (uint64_t)(bits >> 4) << (x & 63);
+    }
+    predictScalar(cur, up, left, x, width, ops, leftMask, upMask);
+}
+
+RECORDER_TARGET_AVX2 static void predictAVX2(const uint8_t* cur, const uint8_t* up, uint32_t left, int width,
+                                             uint32_t* ops, uint64_t* leftMask, uint64_t* upMask) {
+    const __m256i rgb = _mm256_set1_epi32(0x00FFFFFF);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i three = _mm256_set1_epi32(3);
+    const __m256i dgShuffle = _mm256_setr_epi8(1, 1, 1, 1, 5, 5, 5, 5, 9, 9, 9, 9, 13, 13, 13, 13,
+                                               1, 1, 1, 1, 5, 5, 5, 5, 9, 9, 9, 9, 13, 13, 13, 13);
+    int head = std::min(width, 8);
+    predictScalar(cur, up, left, 0, head, ops, leftMask, upMask);
+    int x = head;
+    // run bits collect in registers and go out once per 64 pixels
+    uint64_t leftBits = leftMask[x >> 6];
+    uint64_t upBits = upMask[x >> 6];
+    for (; x + 8 <= width; x += 8) {
+        if ((x & 63) == 0) {
+            leftMask[(x >> 6) - 1] = leftBits;
+            upMask[(x >> 6) - 1] = upBits;
+            leftBits = upBits = 0;
+        }
+        __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cur + (size_t)x * 4));
+        __m256i l = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cur + (size_t)x * 4 - 4));
+        __m256i pc = _mm256_and_si256(p, rgb);
+        leftBits |= (uint64_t)(uint32_t)_mm256_movemask_ps(
+            _mm256_castsi256_ps(_mm256_cmpeq_epi32(pc, _mm256_and_si256(l, rgb)))) << (x & 63);
+        if (up) {
+            __m256i u = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(up + (size_t)x * 4));
+            upBits |= (uint64_t)(uint32_t)_mm256_movemask_ps(
+                _mm256_castsi256_ps(_mm256_cmpeq_epi32(pc, _mm256_and_si256(u, rgb)))) << (x & 63);
+        }
+
+        __m256i d = _mm256_sub_epi8(p, l);
+        __m256i t = _mm256_add_epi8(d, _mm256_set1_epi8(2));
+        __m256i diffOk = _mm256_cmpeq_epi32(_mm256_and_si256(t, _mm256_set1_epi32(0x00FCFCFC)), zero);
+        __m256i diffOp = _mm256_or_si256(
+            _mm256_or_si256(_mm256_set1_epi32(0x40), _mm256_slli_epi32(_mm256_and_si256(t, three), 4)),
+            _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(_mm256_srli_epi32(t, 8), three), 2),
+                            _mm256_and_si256(_mm256_srli_epi32(t, 16), three)));
+        __m256i dg = _mm256_shuffle_epi8(d, dgShuffle);
+        __m256i g = _mm256_add_epi8(d, _mm256_set1_epi32(0x2000));
+        __m256i e = _mm256_add_epi8(_mm256_sub_epi8(d, dg), _mm256_set1_epi32(0x00080008));
+        __m256i lumaOk = _mm256_cmpeq_epi32(_mm256_or_si256(_mm256_and_si256(g, _mm256_set1_epi32(0xC000)),
+                                                            _mm256_and_si256(e, _mm256_set1_epi32(0x00F000F0))),
+                                            zero);
+        __m256i lumaOp = _mm256_or_si256(
+            _mm256_or_si256(_mm256_set1_epi32(0x80), _mm256_and_si256(_mm256_srli_epi32(g, 8), _mm256_set1_epi32(0x3F))),
+            _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(e, 4), _mm256_set1_epi32(0xF000)),
+                            _mm256_and_si256(_mm256_slli_epi32(e, 8), _mm256_set1_epi32(0x0F00))));
+        __m256i rgbOp = _mm256_or_si256(_mm256_slli_epi32(p, 8), _mm256_set1_epi32(kOpRgb));
+
+        __m256i op = _mm256_blendv_epi8(_mm256_blendv_epi8(rgbOp, lumaOp, lumaOk), diffOp, diffOk);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(ops + x), op);
+    }
+    leftMask[(x - 1) >> 6] = leftBits;
+    upMask[(x - 1) >> 6] = upBits;
+    if (x + 4 <= width) {
+        int bits = predictQuadSSE41(cur, up, x, ops);
+        leftMask[x >> 6] |= (uint64_t)(bits & 15) << (x & 63);
+        upMask[x >> 6] |= (uint64_t)(bits >> 4) << (x & 63);
+        x += 4;
+    }
+    predictScalar(cur, up, left, x, width, ops, leftMask, upMask);
+}
+#endif
+
+// ---------------------------------------------------------------------------------------------
+
+LosslessEncoder::LosslessEncoder(int width, int height, SimdLevel level)
+    : width(width), height(height), stripes(0), level(level) {
+    setStripes(1);
+}
+
+void LosslessEncoder::setStripes(int n) {
+    if (n < 1) n = 1;
+    if (n > height) n = std::max(1, height);
+    if (n > 0xFFFF) n = 0xFFFF;
+    if (n == stripes) return;
+    stripes = n;
+    size_t maskWords = (size_t)width / 64 + 2;
+    scratch.resize(n);
+    for (RowScratch& s : scratch) {
+        s.ops.resize(width);
+        s.leftMask.resize(maskWords);
+        s.upMask.resize(maskWords);
+    }
+}
+
+int LosslessEncoder::getStripes() const { return stripes; }
+
+size_t LosslessEncoder::stripeCapacity(int rows) const {
+    // RGB ops are 4 bytes, the most a pixel can take; 4 more for the last op word store
+    return (size_t)rows * (size_t)width * 4 + 4;
+}
+
+size_t LosslessEncoder::encodeStripe(const uint8_t* frame, int firstRow, int lastRow, uint8_t* out,
+                                     RowScratch& s) const {
+    const size_t stride = (size_t)width * 4;
+    uint8_t* o = out;
+    uint32_t left = 0;
+    for (int y = firstRow; y < lastRow; ++y) {
+        const uint8_t* cur = frame + (size_t)y * stride;
+        const uint8_t* up = y > firstRow ? cur - stride : nullptr;
+        std::fill(s.leftMask.begin(), s.leftMask.end(), 0);
+        std::fill(s.upMask.begin(), s.upMask.end(), 0);
+#ifdef RECORDER_X86
+        if (level == SimdLevel::AVX2) predictAVX2(cur, up, left, width, s.ops.data(), s.leftMask.data(), s.upMask.data());
+        else if (level == SimdLevel::SSE41) predictSSE41(cur, up, left, width, s.ops.data(), s.leftMask.data(), s.upMask.data());
+        else predictScalar(cur, up, left, 0, width, s.ops.data(), s.leftMask.data(), s.upMask.data());
+#else
+        predictScalar(cur, up, left, 0, width, s.ops.data(), s.leftMask.data(), s.upMask.data());
+#endif
+
+        const uint64_t* leftMask = s.leftMask.data();
+        const uint64_t* upMask = s.upMask.data();
+        const uint32_t* ops = s.ops.data();
+        int x = 0;
+        while (x < width) {
+            // pixels up to the next run take their precomputed op
+            for (int next = nextRunStart(leftMask, upMask, x, width); x < next; ++x) {
+                uint32_t op = ops[x];
+                memcpy(o, &op, 4);
+                o += kOpLength[(op >> 6) & 3];
+            }
+            if (x >= width) break;
+
+            // take the longer run; runs past the op limit continue in the next op
+            int nLeft = maskBit(leftMask, x) ? runLength(leftMask, x, width - x) : 0;
+            int nUp = maskBit(upMask, x) ? runLength(upMask, x, width - x) : 0;
+            if (nUp > nLeft) {
+                x += nUp;
+                for (; nUp > 0; nUp -= kMaxUpRun) *o++ = (uint8_t)(std::min(nUp, kMaxUpRun) - 1);
+            } else {
+                x += nLeft;
+                for (; nLeft > 0; nLeft -= kMaxRun) *o++ = (uint8_t)(0xC0 | (std::min(nLeft, kMaxRun) - 1));
+            }
+        }
+        left = loadPixel(cur + stride - 4);
+    }
+    return (size_t)(o - out);
+}
+
+size_t LosslessEncoder::encodeFrame(const uint8_t* frameData, PacketBuffer& outputBuffer) {
+    std::vector<size_t> slot(stripes + 1);
+    std::vector<size_t> bytes(stripes);
+    slot[0] = 0;
+    for (int s = 0; s < stripes; ++s) {
+        int rows = (s + 1) * height / stripes - s * height / stripes;
+        slot[s + 1] = slot[s] + stripeCapacity(rows);
+    }
+    if (stripeData.size() < slot[stripes]) stripeData.resize(slot[stripes]);
+
+    auto encodeOne = [&](int s) {
+        bytes[s] = encodeStripe(frameData, s * height / stripes, (s + 1) * height / stripes,
+                                stripeData.data() + slot[s], scratch[s]);
+    };
+    std::vector<std::thread> helpers;
+    for (int s = 1; s < stripes; ++s) helpers.emplace_back(encodeOne, s);
+    encodeOne(0);
+    for (auto& t : helpers) t.join();
+
+    size_t total = kHeaderBytes + (size_t)stripes * 4;
+    for (size_t b : bytes) total += b;
+    outputBuffer.resize(total);
+    uint8_t* out = outputBuffer.data();
+
+    uint8_t header[kHeaderBytes];
+    memcpy(header, "LRL1", 4);
+    store16(header + 4, (uint32_t)width);
+    store16(header + 6, (uint32_t)height);
+    store16(header + 8, (uint32_t)stripes);
+    store16(header + 10, 0);
+    memcpy(out, header, kHeaderBytes);
+    size_t pos = kHeaderBytes + (size_t)stripes * 4;
+    for (int s = 0; s < stripes; ++s) {
+        store32(out + kHeaderBytes + (size_t)s * 4, (uint32_t)bytes[s]);
+        memcpy(out + pos, stripeData.data() + slot[s], bytes[s]);
+        pos += bytes[s];
+    }
+    return total;
+}
+
+// ---------------------------------------------------------------------------------------------
+
+LosslessDecoder::LosslessDecoder() : width(0), height(0) {}
+
+bool LosslessDecoder::decodeFrame(const uint8_t* data, size_t size) {
+    if (size < (size_t)kHeaderBytes || memcmp(data, "LRL1", 4) != 0) return false;
+    int w = (int)get16(data + 4);
+    int h = (int)get16(data + 6);
+    int stripes = (int)get16(data + 8);
+    if (w == 0 || h == 0 || stripes == 0 || stripes > h) return false;
+    size_t pos = kHeaderBytes + (size_t)stripes * 4;
+    if (size < pos) return false;
+
+    if (w != width || h != height) {
+        width = w;
+        height = h;
+        frame.assign((size_t)w * (size_t)h * 4, 0);
+    }
+    for (int s = 0; s < stripes; ++s) {
+        size_t bytes = get32(data + kHeaderBytes + (size_t)s * 4);
+        if (bytes > size - pos) return false;
+        if (!decodeStripe(data + pos, bytes, s * h / stripes, (s + 1) * h / stripes)) return false;
+        pos += bytes;
+    }
+    return true;
+}
+
+bool LosslessDecoder::decodeStripe(const uint8_t* data, size_t size, int firstRow, int lastRow) {
+    const size_t stride = (size_t)width * 4;
+    const uint8_t* p = data;
+    const uint8_t* end = data + size;
+    uint32_t prev = 0xFF000000u;
+    for (int y = firstRow; y < lastRow; ++y) {
+        uint32_t* row = reinterpret_cast<uint32_t*>(frame.data() + (size_t)y * stride);
+        const uint32_t* up = y > firstRow ? row - width : nullptr;
+        int x = 0;
+        while (x < width) {
+            if (p >= end) return false;
+            uint32_t tag = *p++;
+            switch (tag >> 6) {
+            case 0: {
+                int n = (int)(tag & 63) + 1;
+                if (!up || n > width - x) return false;
+                memcpy(row + x, up + x, (size_t)n * 4);
+                x += n;
+                prev = row[x - 1];
+                continue;
+            }
+            case 1: {
+                uint32_t b = (prev + ((tag >> 4) & 3) - 2) & 0xFF;
+                uint32_t g = ((prev >> 8) + ((tag >> 2) & 3) - 2) & 0xFF;
+                uint32_t r = ((prev >> 16) + (tag & 3) - 2) & 0xFF;
+                prev = 0xFF000000u | r << 16 | g << 8 | b;
+                break;
+            }
+            case 2: {
+                if (p >= end) return false;
+                uint32_t rb = *p++;
+                int dg = (int)(tag & 63) - 32;
+                uint32_t b = (prev + dg + (rb & 15) - 8) & 0xFF;
+                uint32_t g = ((prev >> 8) + dg) & 0xFF;
+                uint32_t r = ((prev >> 16) + dg + (rb >> 4) - 8) & 0xFF;
+                prev = 0xFF000000u | r << 16 | g << 8 | b;
+                break;
+            }
+            default: {
+                if (tag == kOpRgb) {
+                    if (end - p < 3) return false;
+                    prev = 0xFF000000u | (uint32_t)p[2] << 16 | (uint32_t)p[1] << 8 | p[0];
+                    p += 3;
+                    break;
+                }
+                int n = (int)(tag & 63) + 1;
+                if (tag == 0xFF || n > width - x) return false;
+                std::fill(row + x, row + x + n, prev);
+                x += n;
+                continue;
+            }
+            }
+            row[x++] = prev;
+        }
+    }
+    return p == end;
+}
@@ -0,0 +1,87 @@
+#ifndef LOSSLESS_CODEC_H
+#define LOSSLESS_CODEC_H
+
+#include <cstdint>
+#include <vector>
+
+#include "../io/packets.h"
+#include "../util/cpu_features.h"
+
+// Fast lossless intermediate codec, for recordings where JPEG cannot keep up. Byte-oriented
+// QOI-style ops against the previous pixel and the row above, no entropy coding: a SIMD
+// pass works out per row which pixels repeat their left or upper neighbour and the op for
+// every other pixel, so the serial part only measures runs and copies op bytes.
+//
+// One encoded frame (little-endian):
+//   header   "LRL1", u16 width, u16 height, u16 stripe count, u16 reserved,
+//            u32 stripe bytes[stripe count]
+//   stripes  stripe s holds rows [s * height / count, (s + 1) * height / count), coded
+//            independently of the others
+// Pixels are BGR; alpha is not stored and decodes as 255. Ops predict from the previous
+// pixel in scan order (the last pixel of the row before at a row start, black at the start
+// of a stripe), never crossing a row end:
+//   00nnnnnn             UP    n + 1 pixels copied from the row above (not in a stripe's first row)
+//   01bbggrr             DIFF  previous + (b, g, r) - 2 per channel
+//   10gggggg rrrrbbbb    LUMA  dg = g - 32, previous + (b + dg - 8, dg, r + dg - 8)
+//   11nnnnnn (n < 62)    RUN   the previous pixel n + 1 times
+//   11111110 b g r       RGB   literal
+// Channel arithmetic wraps modulo 256.
+class LosslessEncoder {
+public:
+    // level: prediction kernels to use (output is the same for every level)
+    LosslessEncoder(int width, int height, SimdLevel level = simdLevel());
+
+    // Encode one BGRA frame into outputBuffer (resized to the frame) and return its length.
+    // Stripes are coded into a worst-case scratch buffer kept by the encoder, so recycled
+    // output buffers only ever grow to real frame sizes.
+    size_t encodeFrame(const uint8_t* frameData, PacketBuffer& outputBuffer);
+
+    // Code each frame as this many stripes, encoded on as many threads (the caller plus
+    // short-lived helpers). More stripes cost a little ratio; default 1.
+    void setStripes(int stripes);
+    int getStripes() const;
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+private:
+    // Per-stripe row state: op word per pixel and run masks (bit x: pixel x repeats its
+    // left / upper neighbour)
+    struct RowScratch {
+        std::vector<uint32_t> ops;
+        std::vector<uint64_t> leftMask;
+        std::vector<uint64_t> upMask;
+    };
+
+    size_t encodeStripe(const uint8_t* frame, int firstRow, int lastRow, uint8_t* out, RowScratch& scratch) const;
+    size_t stripeCapacity(int rows) const;
+
+    int width;
+    int height;
+    int stripes;
+    SimdLevel level;
+    std::vector<RowScratch> scratch; // one per stripe
+    PacketBuffer stripeData;         // stripe s codes into its worst-case slot here
+};
+
+// Rebuilds BGRA frames from LosslessEncoder output
+class LosslessDecoder {
+public:
+    LosslessDecoder();
+
+    // Decode one frame; false for malformed data. The size may change between frames.
+    bool decodeFrame(const uint8_t* data, size_t size);
+
+    const std::vector<uint8_t>& getFrame() const { return frame; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+private:
+    bool decodeStripe(const uint8_t* data, size_t size, int firstRow, int lastRow);
+
+    int width;
+    int height;
+    std::vector<uint8_t> frame;
+};
+
+#endif // LOSSLESS_CODEC_H
@@ -1,225 +1,187 @@
 #include "mjpeg.h"
-#include <windows.h>
-#include <gdiplus.h>
+#include <algorithm>
 #include <vector>
-#include <memory>
-#include <mutex>
-
-#pragma comment(lib, "gdiplus.lib")
-
-using namespace Gdiplus;
-
-static std::once_flag gdiPlusInitFlag;
-static ULONG_PTR gdiPlusToken = 0;
-
-static void ensureGdiplusInit() {
-    std::call_once(gdiPlusInitFlag, []() {
-        GdiplusStartupInput gdiplusStartupInput;
-        GdiplusStartup(&gdiPlusToken, &gdiplusStartupInput, NULL);
-    });
-}
+#include <cstring>
 
 #ifdef HAVE_TURBOJPEG
 #include <turbojpeg.h>
 #endif
 
-// Helper to find encoder CLSID for JPEG
-static int getEncoderClsid(const WCHAR* format, CLSID* pClsid) {
-    UINT num = 0;          // number of image encoders
-    UINT size = 0;         // size of the image encoder array in bytes
-
-    ImageCodecInfo* pImageCodecInfo = NULL;
-    GetImageEncodersSize(&num, &size);
-    if (size == 0) return -1;  // Failure
-
-    pImageCodecInfo = (ImageCodecInfo*)(malloc(size));
-    if (!pImageCodecInfo) return -1;
-
-    GetImageEncoders(num, size, pImageCodecInfo);
-
-    for (UINT j = 0; j < num; ++j) {
-        if (wcscmp(pImageCodecInfo[j].MimeType, format) == 0 || wcscmp(pImageCodecInfo[j].FormatDescription, format) == 0) {
-            *pClsid = pImageCodecInfo[j].Clsid;
-            free(pImageCodecInfo);
-            return j; // success
-        }
-    }
-
-    free(pImageCodecInfo);
-    return -1; // not found
-}
-
 MJPEGEncoder::MJPEGEncoder(int width, int height)
-    : width(width), height(height), quality(75)
+    : width(width), height(height), quality(75), slices(1), sliceGeneration(0), slicesPending(0),
+      sliceExit(false), sliceFrame(nullptr), stripeRows(0), stripeCount(0), firstStripeOut(nullptr)
 #ifdef HAVE_TURBOJPEG
-    , turboHandle(nullptr)
+    , turboHandle(nullptr), turboBufSize(0)
 #endif
 {
 #ifdef HAVE_TURBOJPEG
     // initialize turbojpeg handle
     turboHandle = tjInitCompress();
+    turboBufSize = tjBufSize(width, height, TJSAMP_420);
     if (!turboHandle) {
-        // fallback to GDI+ if init fails
+        // fall back to the built-in encoder if init fails
         turboHandle = nullptr;
     }
 #endif
-    ensureGdiplusInit();
+    baseline.setQuality(quality);
 }
 
 MJPEGEncoder::~MJPEGEncoder() {
+    stopSliceThreads();
 #ifdef HAVE_TURBOJPEG
     if (turboHandle) {
         tjDestroy((tjhandle)turboHandle);
         turboHandle = nullptr;
     }
 #endif
-    // Intentionally do not shutdown GDI+ here; let process exit handle it
 }
 
 void MJPEGEncoder::setQuality(int q) {
     if (q < 1) q = 1;
     if (q > 100) q = 100;
     quality = q;
+    baseline.setQuality(q);
 }
 
-void MJPEGEncoder::encodeFrame(const uint8_t* frameData, std::vector<uint8_t>& outputBuffer) {
-#ifdef HAVE_TURBOJPEG
-    if (turboHandle) {
-        // TurboJPEG expects RGB or BGR input. Our frames are BGRA (32bpp), so provide pitch and pixel format.
-        int pixelSize = 3; // we'll pass BGRX by using TJPF_BGRX when available
-        unsigned char* compressedBuf = nullptr;
-        unsigned long compressedSize = 0;
-
-        // Use tjCompress2 with TJPF_BGRX if available; else convert to BGR buffer
-#ifdef TJPF_BGRX
-        int pixelFormat = TJPF_BGRX;
-        // tjCompress2 supports padded formats; pass width*4 as pitch
-        int pad = 0; // let lib handle
-        int flags = 0;
-        int subsamp = TJSAMP_420; // MJPEG typical subsampling
-        int err = tjCompress2((tjhandle)turboHandle,
-                              frameData, // srcBuf
-                              width,
-                              width * 4, // pitch
-                              height,
-                              pixelFormat,
-                              &compressedBuf,
-                              &compressedSize,
-                              subsamp,
-                              quality,
-                              flags);
-        if (err == 0 && compressedBuf && compressedSize > 0) {
-            outputBuffer.resize(compressedSize);
-            memcpy(outputBuffer.data(), compressedBuf, compressedSize);
-            tjFree(compressedBuf);
-            return;
-        }
-        // else fall through to GDI+ fallback
-#else
-        // No TJPF_BGRX defined; convert BGRA->BGR temporary buffer
-        std::vector<uint8_t> bgrbuf(width * height * 3);
-        uint8_t* dst = bgrbuf.data();
-        const uint8_t* src = frameData;
-        for (int y = 0; y < height; ++y) {
-            const uint8_t* row = src + y * width * 4;
-            for (int x = 0; x < width; ++x) {
-                // BGRA -> BGR
-                dst[0] = row[0];
-                dst[1] = row[1];
-                dst[2] = row[2];
-                dst += 3;
-                row += 4;
-            }
-        }
-        int err = tjCompress2((tjhandle)turboHandle,
-                              bgrbuf.data(),
-                              width,
-                              0,
-                              height,
-                              TJPF_BGR,
-                              &compressedBuf,
-                              &compressedSize,
-                              TJSAMP_420,
-                              quality,
-                              0);
-        if (err == 0 && compressedBuf && compressedSize > 0) {
-            outputBuffer.resize(compressedSize);
-            memcpy(outputBuffer.data(), compressedBuf, compressedSize);
-            tjFree(compressedBuf);
-            return;
-        }
-        // else fall through
-#endif
+void MJPEGEncoder::setSlices(int n) {
+    if (n < 1) n = 1;
+    if (n > 64) n = 64;
+    if (n == slices) return;
+    stopSliceThreads();
+    slices = n;
+    sliceExit = false;
+    for (int i = 1; i < slices; ++i) {
+        sliceThreads.emplace_back(&MJPEGEncoder::sliceWorker, this, i, sliceGeneration);
     }
-#endif
+}
 
-    // Fallback to GDI+ encoder if turbojpeg not present or failed
-    ensureGdiplusInit();
+int MJPEGEncoder::getSlices() const { return slices; }
 
-    // Create Gdiplus Bitmap from raw BGRA data
-    Bitmap bitmap(width, height, PixelFormat32bppARGB);
+void MJPEGEncoder::setAbbreviated(bool abbreviated) {
+    baseline.setAbbreviated(abbreviated);
+}
 
-    BitmapData bd;
-    Rect lockRect(0, 0, width, height);
-    if (bitmap.LockBits(&lockRect, ImageLockModeWrite, PixelFormat32bppARGB, &bd) != Ok) {
-        return;
+bool MJPEGEncoder::getAbbreviated() const { return baseline.getAbbreviated(); }
+
+void MJPEGEncoder::stopSliceThreads() {
+    {
+        std::lock_guard<std::mutex> lock(sliceMutex);
+        sliceExit = true;
+    }
+    sliceWake.notify_all();
+    for (auto& t : sliceThreads) {
+        if (t.joinable()) t.join();
     }
+    sliceThreads.clear();
+}
 
-    // bd.Stride may be padded; copy per-line
-    uint8_t* dest = static_cast<uint8_t*>(bd.Scan0);
-    int destStride = bd.Stride;
-    const uint8_t* src = frameData;
-    int srcStride = width * 4;
-    for (int y = 0; y < height; ++y) {
-        memcpy(dest + y * destStride, src + y * srcStride, srcStride);
+void MJPEGEncoder::sliceWorker(int index, uint64_t seen) {
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(sliceMutex);
+            sliceWake.wait(lock, [this, seen]() { return sliceExit || sliceGeneration != seen; });
+            if (sliceExit) return;
+            seen = sliceGeneration;
+        }
+        encodeStripes(index);
+        std::lock_guard<std::mutex> lock(sliceMutex);
+        if (--slicesPending == 0) sliceDone.notify_one();
     }
+}
 
-    bitmap.UnlockBits(&bd);
-
-    // Prepare encoder CLSID for JPEG
-    CLSID clsid;
-    // Use MIME-type "image/jpeg" for lookup
-    if (getEncoderClsid(L"image/jpeg", &clsid) < 0) return;
-
-    // Create an in-memory IStream
-    IStream* stream = nullptr;
-    if (CreateStreamOnHGlobal(NULL, TRUE, &stream) != S_OK) return;
-
-    // Set quality parameter
-    ULONG qualityVal = (ULONG)quality;
-    EncoderParameters encoderParams;
-    encoderParams.Count = 1;
-    EncoderParameter param;
-    param.Guid = EncoderQuality;
-    param.NumberOfValues = 1;
-    param.Type = EncoderParameterValueTypeLong;
-    param.Value = &qualityVal;
-    encoderParams.Parameter[0] = param;
-
-    Status st = bitmap.Save(stream, &clsid, &encoderParams);
-    if (st != Ok) {
-        stream->Release();
-        return;
+void MJPEGEncoder::encodeStripes(int first) {
+    const int mcuRows = planes.paddedHeight / 16;
+    for (int s = first; s < stripeCount; s += slices) {
+        int firstRow = s * stripeRows;
+        int lastRow = std::min(mcuRows, firstRow + stripeRows);
+        convertBGRAToYUV420Rows(sliceFrame, width * 4, planes, firstRow * 16, lastRow * 16, simdLevel());
+        padYUV420ToMCU(planes, firstRow * 16, lastRow * 16);
+        PacketBuffer& out = s == 0 ? *firstStripeOut : stripeOut[s];
+        if (s != 0) out.clear();
+        baseline.encodeRows(planes, firstRow, lastRow, out);
     }
+}
 
-    // Get HGLOBAL and size
-    HGLOBAL hGlobal = NULL;
-    if (GetHGlobalFromStream(stream, &hGlobal) != S_OK) {
-        stream->Release();
-        return;
+void MJPEGEncoder::encodeSliced(const uint8_t* frameData, PacketBuffer& outputBuffer) {
+    planes.allocate(width, height);
+    const int mcuRows = planes.paddedHeight / 16;
+    const int mcuCols = planes.paddedWidth / 16;
+    // one restart interval per stripe; DRI counts MCUs in 16 bits, so very wide frames
+    // get more (shorter) stripes than threads
+    int rows = (mcuRows + slices - 1) / slices;
+    if (rows * mcuCols > 65535) rows = std::max(1, 65535 / mcuCols);
+    stripeRows = rows;
+    stripeCount = (mcuRows + rows - 1) / rows;
+    if ((int)stripeOut.size() < stripeCount) stripeOut.resize(stripeCount);
+
+    baseline.setRestartRows(stripeRows);
+    baseline.writeHeader(planes, outputBuffer);
+    sliceFrame = frameData;
+    firstStripeOut = &outputBuffer;
+    {
+        std::lock_guard<std::mutex> lock(sliceMutex);
+        slicesPending = (int)sliceThreads.size();
+        ++sliceGeneration;
+    }
+    sliceWake.notify_all();
+    encodeStripes(0);
+    {
+        std::unique_lock<std::mutex> lock(sliceMutex);
+        sliceDone.wait(lock, [this]() { return slicesPending == 0; });
     }
 
-    SIZE_T size = GlobalSize(hGlobal);
-    void* data = GlobalLock(hGlobal);
-    if (!data) {
-        GlobalUnlock(hGlobal);
-        stream->Release();
-        return;
+    for (int s = 1; s < stripeCount; ++s) {
+        JpegBaselineEncoder::appendRestartMarker(outputBuffer, s - 1);
+        outputBuffer.insert(outputBuffer.end(), stripeOut[s].begin(), stripeOut[s].end());
     }
+    JpegBaselineEncoder::appendEOI(outputBuffer);
+}
+
+void MJPEGEncoder::convertToYUV420(const uint8_t* bgra) {
+    planes.allocate(width, height);
+    convertBGRAToYUV420(bgra, width * 4, planes);
+}
 
-    outputBuffer.resize(size);
-    memcpy(outputBuffer.data(), data, size);
+size_t MJPEGEncoder::encodeFrame(const uint8_t* frameData, PacketBuffer& outputBuffer) {
+    if (slices > 1) {
+        encodeSliced(frameData, outputBuffer);
+        return outputBuffer.size();
+    }
+#ifdef HAVE_TURBOJPEG
+    if (turboHandle) {
+        // Colour conversion and chroma subsampling happen in our kernels; TurboJPEG only
+        // does DCT, quantization and entropy coding on the planes
+        convertToYUV420(frameData);
+        const unsigned char* srcPlanes[3] = {planes.y, planes.cb, planes.cr};
+        int strides[3] = {planes.yStride, planes.cStride, planes.cStride};
+        // Compress in place into the worst-case size; a recycled buffer is already that
+        // long, so this only grows a buffer the first time it is used (PacketBuffer
+        // default-initializes, so the new bytes are not zeroed)
+        if (outputBuffer.size() < turboBufSize) outputBuffer.resize(turboBufSize);
+        unsigned char* compressedBuf = outputBuffer.data();
+        unsigned long compressedSize = (unsigned long)outputBuffer.size();
+        int err = tjCompressFromYUVPlanes((tjhandle)turboHandle,
+                                          srcPlanes,
+                                          width,
+                                          strides,
+                                          height,
+                                          TJSAMP_420,
+                                          &compressedBuf,
+                                          &compressedSize,
+                                          quality,
+                                          TJFLAG_NOREALLOC);
+        if (err == 0 && compressedBuf == outputBuffer.data() && compressedSize > 0) {
+            // TurboJPEG always writes full JFIF; drop its (standard) tables afterwards
+            if (baseline.getAbbreviated()) return abbreviateJpeg(compressedBuf, compressedSize);
+            return compressedSize;
+        }
+        // else fall through to the built-in encoder
+    }
+#endif
 
-    GlobalUnlock(hGlobal);
-    stream->Release();
-}
\ No newline at end of file
+    convertToYUV420(frameData);
+    padYUV420ToMCU(planes);
+    baseline.setRestartRows(0);
+    baseline.encode(planes, outputBuffer);
+    return outputBuffer.size();
+}
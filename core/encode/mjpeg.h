@@ -3,31 +3,77 @@
 
 #include <cstdint>
 #include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "color_convert.h"
+#include "jpeg_baseline.h"
+#include "../io/packets.h"
 
 class MJPEGEncoder {
 public:
     MJPEGEncoder(int width, int height);
     ~MJPEGEncoder();
 
-    void encodeFrame(const uint8_t* frameData, std::vector<uint8_t>& outputBuffer);
+    // Encode one BGRA frame and return the JPEG length. The JPEG is at the front of
+    // outputBuffer, which may be longer: TurboJPEG compresses in place into a buffer grown
+    // once to tjBufSize() (no allocation, copy or zero-fill per frame), so keep passing
+    // the same or a recycled buffer.
+    size_t encodeFrame(const uint8_t* frameData, PacketBuffer& outputBuffer);
     void setQuality(int quality);
-    
+
+    // Encode each frame as this many horizontal stripes on as many threads (the caller plus
+    // slices - 1 helpers owned by the encoder). Stripes are restart intervals of one JPEG,
+    // so the output is still a single baseline image. Slicing needs the built-in encoder;
+    // with slices > 1 TurboJPEG is not used. 1 (default) encodes on the calling thread.
+    void setSlices(int slices);
+    int getSlices() const;
+
+    // Write abbreviated AVI1 frames without the standard Huffman tables (see
+    // JpegBaselineEncoder::setAbbreviated); default off
+    void setAbbreviated(bool abbreviated);
+    bool getAbbreviated() const;
+
 private:
     void initialize();
     void cleanup();
-    void convertToYUV420(const uint8_t* bgra, uint8_t* yuv);
-    void performDCT(const uint8_t* block, uint8_t* output);
-    void quantize(const uint8_t* dctBlock, uint8_t* output);
-    void huffmanEncode(const uint8_t* quantizedBlock, std::vector<uint8_t>& outputBuffer);
+    // BGRA frame into the planes member (SIMD, see color_convert.h)
+    void convertToYUV420(const uint8_t* bgra);
+    void encodeSliced(const uint8_t* frameData, PacketBuffer& outputBuffer);
+    // Convert, pad and entropy-code stripes first, first + slices, ... of the current frame
+    void encodeStripes(int first);
+    // seen: generation when the helper was created (a frame may be posted before it runs)
+    void sliceWorker(int index, uint64_t seen);
+    void stopSliceThreads();
 
     int width;
     int height;
     int quality;
+    YUV420Planes planes; // reused every frame
+    JpegBaselineEncoder baseline; // built-in encoder, used when TurboJPEG is unavailable
+
+    // slice-parallel encoding: helpers wait for sliceGeneration to move, encode their
+    // stripes and count slicesPending down
+    int slices;
+    std::vector<std::thread> sliceThreads;
+    std::mutex sliceMutex;
+    std::condition_variable sliceWake;
+    std::condition_variable sliceDone;
+    uint64_t sliceGeneration;
+    int slicesPending;
+    bool sliceExit;
+    const uint8_t* sliceFrame;
+    int stripeRows;                               // MCU rows per stripe
+    int stripeCount;
+    PacketBuffer* firstStripeOut;                 // stripe 0 goes straight after the header
+    std::vector<PacketBuffer> stripeOut;          // stripes 1..n-1, reused
 
 #ifdef HAVE_TURBOJPEG
     // turbojpeg handle for fast encoding
     struct tjhandle_struct; // forward decl (opaque)
     void* turboHandle;
+    size_t turboBufSize; // tjBufSize() for this frame size
 #endif
     // Additional private members for internal state management
 };
@@ -0,0 +1,90 @@
+#include "rate_control.h"
+#include <algorithm>
+
+// JPEG size against quality 0, 5, ..., 100 relative to quality 50; the mean of the
+// built-in encoder's output on scrolling, noise and game frames
+static const double sizeCurve[21] = {
+    0.15, 0.21, 0.33, 0.40, 0.50, 0.60, 0.69, 0.80, 0.87, 0.95, 1.00,
+    1.06, 1.12, 1.19, 1.28, 1.38, 1.57, 1.77, 2.17, 2.84, 4.77,
+};
+
+double RateController::relativeSize(int quality) {
+    if (quality <= 0) return sizeCurve[0];
+    if (quality >= 100) return sizeCurve[20];
+    int i = quality / 5;
+    double t = (double)(quality - i * 5) / 5.0;
+    return sizeCurve[i] + (sizeCurve[i + 1] - sizeCurve[i]) * t;
+}
+
+RateController::RateController(const RateControlOptions& options)
+    : options(options), fps(30), quality(75), complexity(-1.0), debt(0.0), frames(0), bytes(0),
+      firstUs(0), lastUs(0), windowStartUs(0), windowBytes(0), recentBytesPerSec(0.0) {
+    RateControlOptions& o = this->options;
+    o.minQuality = std::min(std::max(o.minQuality, 1), 100);
+    o.maxQuality = std::min(std::max(o.maxQuality, o.minQuality), 100);
+    if (o.smoothing <= 0.0 || o.smoothing > 1.0) o.smoothing = 0.2;
+    if (o.maxStep < 1) o.maxStep = 1;
+    if (o.windowSec <= 0.0) o.windowSec = 2.0;
+    quality = std::min(std::max(quality, o.minQuality), o.maxQuality);
+}
+
+void RateController::setFrameRate(int fps) {
+    this->fps = fps > 0 ? fps : 1;
+}
+
+int RateController::update(size_t frameBytes, int frameQuality, uint64_t nowUs) {
+    const double target = (double)options.targetBytesPerSec;
+    if (frames == 0) {
+        // the first frame covers one frame period
+        uint64_t periodUs = 1000000 / (uint64_t)fps;
+        firstUs = nowUs > periodUs ? nowUs - periodUs : 0;
+        lastUs = firstUs;
+        windowStartUs = firstUs;
+    }
+    // workers finish out of order; time only moves forward
+    if (nowUs < lastUs) nowUs = lastUs;
+    uint64_t elapsedUs = nowUs - lastUs;
+    lastUs = nowUs;
+
+    ++frames;
+    bytes += frameBytes;
+    windowBytes += frameBytes;
+    if (nowUs - windowStartUs >= 1000000) {
+        recentBytesPerSec = (double)windowBytes * 1e6 / (double)(nowUs - windowStartUs);
+        windowStartUs = nowUs;
+        windowBytes = 0;
+    }
+    if (target <= 0.0) return quality;
+
+    double window = target * options.windowSec;
+    debt += (double)frameBytes - target * (double)elapsedUs / 1e6;
+    debt = std::min(std::max(debt, -window), window);
+
+    double sample = (double)frameBytes / relativeSize(frameQuality);
+    complexity = complexity < 0.0 ? sample : complexity + options.smoothing * (sample - complexity);
+
+    double budget = target / (double)fps * std::min(std::max(1.0 - debt / window, 0.5), 1.5);
+    int best = options.minQuality;
+    for (int q = options.maxQuality; q > options.minQuality; --q) {
+        if (complexity * relativeSize(q) <= budget) {
+            best = q;
+            break;
+        }
+    }
+    if (frames > 1) {
+        best = std::min(std::max(best, quality - options.maxStep), quality + options.maxStep);
+    }
+    quality = best;
+    return quality;
+}
+
+RateControlStats RateController::getStats() const {
+    RateControlStats s = RateControlStats();
+    s.targetBytesPerSec = options.targetBytesPerSec;
+    s.quality = quality;
+    s.frames = frames;
+    s.bytes = bytes;
+    if (frames > 0 && lastUs > firstUs) s.achievedBytesPerSec = (double)bytes * 1e6 / (double)(lastUs - firstUs);
+    s.recentBytesPerSec = recentBytesPerSec;
+    return s;
+}
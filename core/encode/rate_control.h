@@ -0,0 +1,70 @@
+#ifndef RATE_CONTROL_H
+#define RATE_CONTROL_H
+
+#include <cstdint>
+#include <cstddef>
+
+struct RateControlOptions {
+    uint64_t targetBytesPerSec = 0; // 0 disables rate control
+    int minQuality = 20;
+    int maxQuality = 95;
+    double smoothing = 0.2;         // weight of the newest frame in the complexity estimate
+    int maxStep = 4;                // largest quality change per frame
+    double windowSec = 2.0;         // over- or undershoot is paid back over this long
+};
+
+struct RateControlStats {
+    uint64_t targetBytesPerSec;
+    int quality;                    // quality the next frame is encoded at
+    uint64_t frames;
+    uint64_t bytes;
+    double achievedBytesPerSec;     // since the first frame
+    double recentBytesPerSec;       // over the last completed second
+};
+
+// Picks the JPEG quality of the next frame so encoded output stays near a target byte
+// rate whatever the content.
+//
+// Frame size is modelled as complexity * relativeSize(quality), where relativeSize() is a
+// fixed curve of JPEG size against IJG quality (1.0 at quality 50) measured on synthetic
+// and game content. Each encoded frame updates an exponentially smoothed complexity, and
+// the next quality is the highest whose predicted size fits the per-frame budget
+// (target / fps), moved at most maxStep per frame. Whatever the curve gets wrong only slows
+// convergence: at the fixed point the measured size itself meets the budget. The budget is
+// scaled by the byte debt against the target over wall time, clamped to one window, so
+// integer quality steps and dropped frames even out without idle stretches banking a burst.
+//
+// Not thread-safe; EncoderPool serializes update() calls.
+class RateController {
+public:
+    explicit RateController(const RateControlOptions& options);
+
+    // Frames per second the budget is split over (default 30)
+    void setFrameRate(int fps);
+
+    // Record one encoded frame (bytes at the quality it was encoded with, nowUs when it
+    // finished) and return the quality for the next one
+    int update(size_t bytes, int quality, uint64_t nowUs);
+
+    int getQuality() const { return quality; }
+    RateControlStats getStats() const;
+
+    // Expected JPEG size at quality relative to quality 50
+    static double relativeSize(int quality);
+
+private:
+    RateControlOptions options;
+    int fps;
+    int quality;
+    double complexity;      // smoothed bytes at quality 50, < 0 before the first frame
+    double debt;            // bytes written beyond the target rate so far, clamped
+    uint64_t frames;
+    uint64_t bytes;
+    uint64_t firstUs;
+    uint64_t lastUs;
+    uint64_t windowStartUs; // recentBytesPerSec accounting
+    uint64_t windowBytes;
+    double recentBytesPerSec;
+};
+
+#endif // RATE_CONTROL_H
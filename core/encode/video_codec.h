@@ -0,0 +1,16 @@
+#ifndef VIDEO_CODEC_H
+#define VIDEO_CODEC_H
+
+// Video codecs a recording can be made with
+enum class VideoCodec {
+    Mjpeg,   // one baseline JPEG per frame (FourCC MJPG); plays everywhere
+    Lossless // LosslessEncoder frames (FourCC LRLS): a fraction of the CPU of JPEG for
+             // several times the disk bandwidth; convert with recorder_transcode
+};
+
+// AVI FourCC (fccHandler / biCompression) of a codec's frames
+inline const char* videoCodecFourCC(VideoCodec codec) {
+    return codec == VideoCodec::Lossless ? "LRLS" : "MJPG";
+}
+
+#endif // VIDEO_CODEC_H
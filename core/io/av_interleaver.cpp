@@ -0,0 +1,179 @@
+#include "av_interleaver.h"
+
+AVInterleaver::AVInterleaver(Muxer* mux, PacketBufferPool* videoPool, PacketBufferPool* audioPool,
+                             bool hasAudio, size_t lookahead)
+    : mux(mux), videoPool(videoPool), audioPool(audioPool), hasAudio(hasAudio),
+      videoQueue(lookahead), audioQueue(lookahead),
+      latencyWindowMs(250), granularityMs(0), lastWrittenPts(0),
+      frameRate(0), videoStarted(false), firstVideoPts(0), videoSlots(0), writeFailed(false),
+      videoChunks(0), audioChunks(0), lateChunks(0), forcedChunks(0), gapChunks(0) {
+}
+
+void AVInterleaver::setLatencyWindowMs(uint32_t ms) { latencyWindowMs = ms; }
+
+void AVInterleaver::setGranularityMs(uint32_t ms) { granularityMs = ms; }
+
+void AVInterleaver::setFrameRate(uint32_t fps) { frameRate = fps; }
+
+// Counters only ever grow and are written by one thread; a +1 store is enough
+static void bump(std::atomic<uint64_t>& counter) {
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+AVInterleaverStats AVInterleaver::getStats() const {
+    AVInterleaverStats s;
+    s.videoChunks = videoChunks.load(std::memory_order_relaxed);
+    s.audioChunks = audioChunks.load(std::memory_order_relaxed);
+    s.lateChunks = lateChunks.load(std::memory_order_relaxed);
+    s.forcedChunks = forcedChunks.load(std::memory_order_relaxed);
+    s.gapChunks = gapChunks.load(std::memory_order_relaxed);
+    return s;
+}
+
+const LatencyHistogram& AVInterleaver::getMuxWriteHistogram() const { return muxWriteTime; }
+
+const LatencyHistogram& AVInterleaver::getEndToEndHistogram() const { return endToEnd; }
+
+bool AVInterleaver::before(uint64_t audioPts, uint64_t videoPts) const {
+    if (granularityMs > 0) {
+        uint64_t audioBucket = audioPts / granularityMs;
+        uint64_t videoBucket = videoPts / granularityMs;
+        if (audioBucket != videoBucket) return audioBucket < videoBucket;
+        return true; // audio leads within a bucket
+    }
+    return audioPts <= videoPts;
+}
+
+AVInterleaver::Stream AVInterleaver::nextStream() const {
+    bool haveV = !videoQueue.empty();
+    bool haveA = !audioQueue.empty();
+    if (haveV && haveA) {
+        return before(audioQueue.front().pts_ms, videoQueue.front().pts_ms) ? Stream::Audio : Stream::Video;
+    }
+    if (haveV) return Stream::Video;
+    if (haveA) return Stream::Audio;
+    return Stream::None;
+}
+
+void AVInterleaver::noteWritten(uint64_t pts) {
+    if (pts < lastWrittenPts) bump(lateChunks);
+    else lastWrittenPts = pts;
+}
+
+// Pad with empty chunks up to the frame slot pts falls in. Capture jitter can put a pts
+// a little before its slot; such a frame just follows on, so the stream is never behind.
+// Returns false if the muxer refused one of them.
+bool AVInterleaver::fillVideoGap(uint64_t pts) {
+    if (!videoStarted) {
+        videoStarted = true;
+        firstVideoPts = pts;
+        return true;
+    }
+    if (pts <= firstVideoPts) return true;
+    uint64_t slot = ((pts - firstVideoPts) * frameRate + 500) / 1000;
+    while (videoSlots < slot) {
+        if (!mux->writeVideoFrame(nullptr, 0)) return false;
+        ++videoSlots;
+        bump(gapChunks);
+    }
+    return true;
+}
+
+// After a failed write the head chunk is still released and popped, so the queues keep
+// their room and the payload buffers go back to the pools
+void AVInterleaver::writeVideo() {
+    VideoPacket& v = videoQueue.front();
+    if (!writeFailed) {
+        uint64_t startUs = telemetry_now_us();
+        bool ok = (frameRate == 0 || fillVideoGap(v.pts_ms)) && mux->writeVideoFrame(v.data.data(), v.length);
+        if (ok) {
+            ++videoSlots;
+            uint64_t doneUs = telemetry_now_us();
+            muxWriteTime.record(doneUs - startUs);
+            endToEnd.record(doneUs > v.capture_us ? doneUs - v.capture_us : 0);
+            noteWritten(v.pts_ms);
+            bump(videoChunks);
+        } else {
+            writeFailed = true;
+        }
+    }
+    if (videoPool) videoPool->release(std::move(v.data));
+    videoQueue.popFront();
+}
+
+void AVInterleaver::writeAudio() {
+    AudioPacket& a = audioQueue.front();
+    if (!writeFailed) {
+        uint64_t startUs = telemetry_now_us();
+        if (mux->writeAudioSamples(a.data.data(), a.data.size())) {
+            muxWriteTime.record(telemetry_now_us() - startUs);
+            noteWritten(a.pts_ms);
+            bump(audioChunks);
+        } else {
+            writeFailed = true;
+        }
+    }
+    if (audioPool) audioPool->release(std::move(a.data));
+    audioQueue.popFront();
+}
+
+bool AVInterleaver::pull(SPSC_Ring<VideoPacket>& videoRing, SPSC_Ring<AudioPacket>* audioRing) {
+    bool got = false;
+
+    while (!videoRing.is_empty()) {
+        if (videoQueue.full()) {
+            // the other stream is far behind; write the oldest queued chunk to make room
+            if (nextStream() == Stream::Video) writeVideo(); else writeAudio();
+            bump(forcedChunks);
+        }
+        if (!videoRing.pop(videoQueue.backSlot())) break;
+        videoQueue.commitBack();
+        got = true;
+    }
+
+    while (audioRing && !audioRing->is_empty()) {
+        if (audioQueue.full()) {
+            if (nextStream() == Stream::Audio) writeAudio(); else writeVideo();
+            bump(forcedChunks);
+        }
+        if (!audioRing->pop(audioQueue.backSlot())) break;
+        audioQueue.commitBack();
+        got = true;
+    }
+
+    return got;
+}
+
+void AVInterleaver::emit(uint64_t nowMs) {
+    while (!writeFailed) {
+        bool haveV = !videoQueue.empty();
+        bool haveA = !audioQueue.empty();
+
+        // Both heads known: each stream arrives in order, so the earlier head is final
+        if (haveV && haveA) {
+            if (nextStream() == Stream::Audio) writeAudio(); else writeVideo();
+            continue;
+        }
+
+        // One stream only: the other may still deliver an earlier chunk, so hold the head
+        // for up to the latency window (video pts lag behind by the encode time)
+        if (haveV && (!hasAudio || nowMs >= videoQueue.front().pts_ms + latencyWindowMs)) {
+            writeVideo();
+            continue;
+        }
+        if (haveA && nowMs >= audioQueue.front().pts_ms + latencyWindowMs) {
+            writeAudio();
+            continue;
+        }
+        break;
+    }
+}
+
+void AVInterleaver::flush() {
+    while (!writeFailed) {
+        Stream s = nextStream();
+        if (s == Stream::Video) writeVideo();
+        else if (s == Stream::Audio) writeAudio();
+        else break;
+    }
+}
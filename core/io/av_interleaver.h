@@ -0,0 +1,128 @@
+#ifndef AV_INTERLEAVER_H
+#define AV_INTERLEAVER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <utility>
+#include <atomic>
+
+#include "muxer.h"
+#include "packets.h"
+#include "../util/spsc_ring.h"
+#include "../util/telemetry.h"
+
+// Fixed-capacity FIFO of packets; slots are reused so payload vectors are only moved
+template<typename P>
+class PacketQueue {
+public:
+    explicit PacketQueue(size_t capacity) : items(capacity), head(0), count(0) {}
+
+    bool empty() const { return count == 0; }
+    bool full() const { return count == items.size(); }
+    size_t size() const { return count; }
+
+    P& front() { return items[head]; }
+    const P& front() const { return items[head]; }
+    // Slot the next pushed packet goes into (valid while !full())
+    P& backSlot() { return items[(head + count) % items.size()]; }
+    void commitBack() { ++count; }
+    void popFront() {
+        head = (head + 1) % items.size();
+        --count;
+    }
+
+private:
+    std::vector<P> items;
+    size_t head;
+    size_t count;
+};
+
+struct AVInterleaverStats {
+    uint64_t videoChunks;
+    uint64_t audioChunks;
+    uint64_t lateChunks;   // arrived after a later-timestamped chunk was already written
+    uint64_t forcedChunks; // written early because a lookahead queue was full
+    uint64_t gapChunks;    // empty video chunks filling pts gaps (see setFrameRate)
+};
+
+// Merge stage between the writer rings and the Muxer. Each stream gets a small lookahead
+// queue; chunks go to the muxer in pts order. A chunk is held until the other stream has
+// caught up to it, or for at most the latency window when the other stream is silent.
+//
+// Interleave granularity groups chunks into pts buckets of that many ms (audio first,
+// then video within each bucket) so players read fewer, larger runs per stream; the
+// chunks themselves are written as they are, without copying them together. 0 writes
+// strictly per chunk.
+class AVInterleaver {
+public:
+    AVInterleaver(Muxer* mux, PacketBufferPool* videoPool, PacketBufferPool* audioPool,
+                  bool hasAudio, size_t lookahead = 64);
+
+    void setLatencyWindowMs(uint32_t ms);
+    void setGranularityMs(uint32_t ms);
+
+    // Frame rate the video stream is declared with. Each chunk is a 1/fps step, so
+    // pts gaps (dropped frames, capture running below that rate) are filled with empty
+    // chunks, which repeat the previous frame, to keep video in real time. 0 (default)
+    // writes packets back to back.
+    void setFrameRate(uint32_t fps);
+
+    // Move whatever the rings hold into the lookahead queues; returns true if anything arrived
+    bool pull(SPSC_Ring<VideoPacket>& videoRing, SPSC_Ring<AudioPacket>* audioRing);
+
+    // Write every chunk that is safe to write at nowMs (steady clock ms)
+    void emit(uint64_t nowMs);
+
+    // Write everything still queued, in order (end of recording)
+    void flush();
+
+    // True once the muxer refused a chunk (disk full, I/O error). Nothing is written after
+    // that: queued chunks are only released, and emit()/flush() do nothing.
+    bool failed() const { return writeFailed; }
+
+    // Safe to call from other threads while the writer runs
+    AVInterleaverStats getStats() const;
+    // Muxer write time per chunk and capture -> written latency of video chunks (us)
+    const LatencyHistogram& getMuxWriteHistogram() const;
+    const LatencyHistogram& getEndToEndHistogram() const;
+
+private:
+    enum class Stream { Video, Audio, None };
+
+    Stream nextStream() const;
+    bool before(uint64_t audioPts, uint64_t videoPts) const;
+    void writeVideo();
+    void writeAudio();
+    void noteWritten(uint64_t pts);
+    bool fillVideoGap(uint64_t pts);
+
+    Muxer* mux;
+    PacketBufferPool* videoPool;
+    PacketBufferPool* audioPool;
+    bool hasAudio;
+
+    PacketQueue<VideoPacket> videoQueue;
+    PacketQueue<AudioPacket> audioQueue;
+
+    uint32_t latencyWindowMs;
+    uint32_t granularityMs;
+    uint64_t lastWrittenPts;
+    uint32_t frameRate;
+    bool videoStarted;
+    uint64_t firstVideoPts;
+    uint64_t videoSlots; // video chunks written, empty ones included
+    bool writeFailed;
+
+    // written by the writer thread only; atomics so getStats() can read them live. Chunks
+    // the muxer refused are not counted.
+    std::atomic<uint64_t> videoChunks;
+    std::atomic<uint64_t> audioChunks;
+    std::atomic<uint64_t> lateChunks;
+    std::atomic<uint64_t> forcedChunks;
+    std::atomic<uint64_t> gapChunks;
+    LatencyHistogram muxWriteTime;
+    LatencyHistogram endToEnd;
+};
+
+#endif // AV_INTERLEAVER_H
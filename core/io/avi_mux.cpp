@@ -1,79 +1,202 @@
 #include "avi_mux.h"
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 #include <vector>
 #include <iostream>
 
-static inline void write_u32_le(FILE* f, uint32_t v) {
-    uint8_t b[4];
-    b[0] = v & 0xFF;
-    b[1] = (v >> 8) & 0xFF;
-    b[2] = (v >> 16) & 0xFF;
-    b[3] = (v >> 24) & 0xFF;
-    fwrite(b, 1, 4, f);
+#include "../util/telemetry.h"
+
+static inline void store16(uint8_t* p, uint32_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+}
+
+static inline void store32(uint8_t* p, uint32_t v) {
+    store16(p, v & 0xFFFF);
+    store16(p + 2, v >> 16);
+}
+
+static inline void store64(uint8_t* p, uint64_t v) {
+    store32(p, (uint32_t)v);
+    store32(p + 4, (uint32_t)(v >> 32));
+}
+
+static inline uint32_t load32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t load64(const uint8_t* p) {
+    return (uint64_t)load32(p) | ((uint64_t)load32(p + 4) << 32);
 }
 
-static inline void write_u16_le(FILE* f, uint16_t v) {
-    uint8_t b[2];
-    b[0] = v & 0xFF;
-    b[1] = (v >> 8) & 0xFF;
-    fwrite(b, 1, 2, f);
+// 64-bit seek (long is 32 bits on Windows)
+static bool seekTo(FILE* f, uint64_t offset) {
+#ifdef _WIN32
+    return _fseeki64(f, (long long)offset, SEEK_SET) == 0;
+#else
+    return fseeko(f, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+static inline void put_u32_le(std::vector<uint8_t>& h, uint32_t v) {
+    size_t at = h.size();
+    h.resize(at + 4);
+    store32(h.data() + at, v);
+}
+
+static inline void put_fourcc(std::vector<uint8_t>& h, const char* fourcc) {
+    h.insert(h.end(), fourcc, fourcc + 4);
+}
+
+static const uint64_t kDefaultSegmentSize = 1ull << 30;
+static const uint32_t kSuperIndexEntries = 256;
+static const uint32_t kNotKeyframe = 0x80000000u; // standard index dwSize flag
+static const char kJournalMagic[8] = {'A', 'V', 'I', 'J', 'R', 'N', 'L', '1'};
+static const size_t kJournalRecord = 16;
+static const size_t kJournalBlockRecords = 4096;
+
+// Header chunk: fourcc, size, data; returns the offset of the data in h
+static size_t put_chunk(std::vector<uint8_t>& h, const char* fourcc, const void* data, uint32_t size) {
+    put_fourcc(h, fourcc);
+    put_u32_le(h, size);
+    size_t at = h.size();
+    const uint8_t* bytes = (const uint8_t*)data;
+    h.insert(h.end(), bytes, bytes + size);
+    if (size % 2 == 1) h.push_back(0);
+    return at;
 }
 
 AVIMux::AVIMux(const std::string& filename)
-    : filename_(filename), out_(nullptr), width_(0), height_(0), fps_(30),
-      sampleRate_(0), channels_(0), blockAlign_(0), bitsPerSample_(16),
-      riffSizePos_(0), hdrlListPos_(0), moviListPos_(0) {
+    : filename_(filename), out_(filename), width_(0), height_(0), fps_(30),
+      sampleRate_(0), channels_(0), blockAlign_(0), bitsPerSample_(16), segmentSize_(kDefaultSegmentSize),
+      riffPos_(0), moviListPos_(0), firstMoviPos_(0), totalFramesPos_(0), videoLengthPos_(0), audioLengthPos_(0),
+      dmlhPos_(0), videoFrames_(0), firstRiffFrames_(0), audioBytes_(0), firstRiff_(true), indexFull_(false),
+      journalName_(journalPath(filename)), journal_(nullptr), journalRecords_(0), segmentFirstRecord_(0),
+      checkpointMs_(2000), lastCheckpointUs_(0) {
+    memcpy(videoFourCC_, "MJPG", 4);
+    memcpy(streams_[VideoStream].chunkId, "00dc", 4);
+    memcpy(streams_[VideoStream].indexId, "ix00", 4);
+    memcpy(streams_[AudioStream].chunkId, "01wb", 4);
+    memcpy(streams_[AudioStream].indexId, "ix01", 4);
+    for (StreamIndex& st : streams_) {
+        st.indxPos = 0;
+        st.segmentChunks = 0;
+        st.segmentDuration = 0;
+    }
+    out_.setBackend(WriterBackend::Threaded);
 }
 
 AVIMux::~AVIMux() {
     close();
 }
 
+std::string AVIMux::journalPath(const std::string& filename) {
+    return filename + ".journal";
+}
+
 bool AVIMux::open() {
-    out_ = fopen(filename_.c_str(), "wb");
-    if (!out_) return false;
-    writeHeadersPlaceholder();
+    if (out_.isOpen()) return false;
+    // read back at the end of every segment
+    journal_ = fopen(journalName_.c_str(), "w+b");
+    if (!journal_) return false;
+    if (fwrite(kJournalMagic, 1, sizeof(kJournalMagic), journal_) != sizeof(kJournalMagic) || !out_.open()) {
+        fclose(journal_);
+        journal_ = nullptr;
+        remove(journalName_.c_str());
+        return false;
+    }
+    videoFrames_ = 0;
+    firstRiffFrames_ = 0;
+    audioBytes_ = 0;
+    firstRiff_ = true;
+    indexFull_ = false;
+    journalRecords_ = 0;
+    segmentFirstRecord_ = 0;
+    for (StreamIndex& st : streams_) {
+        st.segmentChunks = 0;
+        st.segments.clear();
+        st.segmentDuration = 0;
+    }
+    writeHeaders();
+    lastCheckpointUs_ = telemetry_now_us();
     return true;
 }
 
-void AVIMux::close() {
-    if (!out_) return;
+bool AVIMux::close() {
+    if (!out_.isOpen()) return true;
     finalizeHeaders();
-    fclose(out_);
-    out_ = nullptr;
+    bool ok = out_.close();
+    if (fclose(journal_) != 0) ok = false;
+    journal_ = nullptr;
+    // the journal stays for recoverAVI() if anything went wrong
+    if (ok) remove(journalName_.c_str());
+    else std::cerr << "AVIMux: writing " << filename_ << " failed" << std::endl;
+    return ok;
 }
 
-void AVIMux::setVideoParameters(uint32_t width, uint32_t height, uint32_t fps) {
+void AVIMux::setVideoParameters(uint32_t width, uint32_t height, uint32_t fps, const char* fourcc) {
     width_ = width; height_ = height; fps_ = fps;
+    if (fourcc && strlen(fourcc) == 4) memcpy(videoFourCC_, fourcc, 4);
 }
 
 void AVIMux::setAudioParameters(uint32_t sampleRate, uint32_t channels, uint16_t blockAlign, uint16_t bitsPerSample) {
     sampleRate_ = sampleRate; channels_ = channels; blockAlign_ = blockAlign; bitsPerSample_ = bitsPerSample;
 }
 
-uint32_t AVIMux::writeChunk(const char fourcc[4], const void* data, uint32_t size) {
-    // Align to WORD boundary
-    uint32_t start = (uint32_t)ftell(out_);
-    fwrite(fourcc, 1, 4, out_);
-    write_u32_le(out_, size);
-    if (size > 0 && data) fwrite(data, 1, size, out_);
-    if (size % 2 == 1) fputc(0, out_);
-    return start;
+void AVIMux::setWriteBufferSize(size_t bytes) {
+    out_.setBufferSize(bytes);
 }
 
-void AVIMux::writeHeadersPlaceholder() {
+void AVIMux::setWriterBackend(WriterBackend backend, int bufferCount) {
+    out_.setBackend(backend, bufferCount);
+}
+
+void AVIMux::setCheckpointInterval(uint32_t ms) {
+    checkpointMs_ = ms;
+}
+
+void AVIMux::setSegmentSize(uint64_t bytes) {
+    // a RIFF's sizes are 32-bit; leave room for its indexes
+    const uint64_t maxSize = 0xF0000000ull;
+    segmentSize_ = bytes < (1u << 20) ? (1u << 20) : (bytes > maxSize ? maxSize : bytes);
+}
+
+uint32_t AVIMux::moviOffsetBase() const {
+    // idx1 offsets count from the first movi list's 'movi' FourCC
+    return (uint32_t)firstMoviPos_ + 4;
+}
+
+bool AVIMux::writeChunk(const char fourcc[4], const void* data, uint32_t size) {
+    // Header, payload and WORD-alignment padding are staged back to back
+    uint8_t header[8];
+    memcpy(header, fourcc, 4);
+    store32(header + 4, size);
+    bool ok = out_.write(header, sizeof(header));
+    if (size > 0 && data) ok = out_.write(data, size);
+    if (size % 2 == 1) {
+        static const uint8_t pad = 0;
+        ok = out_.write(&pad, 1);
+    }
+    return ok;
+}
+
+void AVIMux::writeHeaders() {
+    // Built in memory, each list's size filled in once it is complete, and written in one
+    // go; the RIFF and movi sizes and the frame counts are patched at close()
+    std::vector<uint8_t> h;
+    h.reserve(16 * 1024);
+
     // RIFF header
-    fwrite("RIFF", 1, 4, out_);
-    riffSizePos_ = ftell(out_);
-    write_u32_le(out_, 0); // placeholder for RIFF size
-    fwrite("AVI ", 1, 4, out_);
+    put_fourcc(h, "RIFF");
+    put_u32_le(h, 0); // placeholder for RIFF size
+    put_fourcc(h, "AVI ");
 
     // LIST hdrl
-    fwrite("LIST", 1, 4, out_);
-    hdrlListPos_ = ftell(out_);
-    write_u32_le(out_, 0); // hdrl size placeholder
-    fwrite("hdrl", 1, 4, out_);
+    put_fourcc(h, "LIST");
+    size_t hdrlSizePos = h.size();
+    put_u32_le(h, 0);
+    put_fourcc(h, "hdrl");
 
     // avih: main AVI header (56 bytes)
     uint8_t avih[56]; memset(avih, 0, sizeof(avih));
@@ -81,190 +204,354 @@ void AVIMux::writeHeadersPlaceholder() {
     uint32_t streams = (sampleRate_ > 0) ? 2u : 1u;
     uint32_t suggestedBuf = (width_ && height_) ? (width_ * height_ * 3 / 2) : 0u;
 
-    // dwMicroSecPerFrame
-    memcpy(avih + 0, &microSecPerFrame, 4);
+    store32(avih + 0, microSecPerFrame); // dwMicroSecPerFrame
     // dwMaxBytesPerSec (leave 0)
     // dwPaddingGranularity (leave 0)
     // dwFlags (leave 0)
-    // dwTotalFrames (0 - unknown)
+    // dwTotalFrames (patched at close)
     // dwInitialFrames (0)
-    memcpy(avih + 24, &streams, 4); // dwStreams
-    memcpy(avih + 28, &suggestedBuf, 4); // dwSuggestedBufferSize
-    if (width_) memcpy(avih + 32, &width_, 4);
-    if (height_) memcpy(avih + 36, &height_, 4);
-
-    const char avihFourcc[4] = {'a','v','i','h'};
-    writeChunk(avihFourcc, avih, sizeof(avih));
-
-    // Write video stream LIST 'strl'
-    // We'll create strl, write strh and strf, then backpatch the strl size immediately.
-    long strlPos = ftell(out_);
-    fwrite("LIST", 1, 4, out_);
-    long strlSizePos = ftell(out_);
-    write_u32_le(out_, 0);
-    fwrite("strl", 1, 4, out_);
+    store32(avih + 24, streams);      // dwStreams
+    store32(avih + 28, suggestedBuf); // dwSuggestedBufferSize
+    store32(avih + 32, width_);
+    store32(avih + 36, height_);
+
+    totalFramesPos_ = put_chunk(h, "avih", avih, sizeof(avih)) + 16;
+
+    // Video stream LIST 'strl'
+    size_t strlPos = h.size();
+    put_fourcc(h, "LIST");
+    put_u32_le(h, 0);
+    put_fourcc(h, "strl");
 
     // strh for video
     uint8_t strh_vid[56]; memset(strh_vid, 0, sizeof(strh_vid));
-    // fccType 'vids'
-    strh_vid[0] = 'v'; strh_vid[1] = 'i'; strh_vid[2] = 'd'; strh_vid[3] = 's';
-    // fccHandler 'MJPG'
-    strh_vid[4] = 'M'; strh_vid[5] = 'J'; strh_vid[6] = 'P'; strh_vid[7] = 'G';
-    // dwFlags = 0
-    uint16_t wPriority = 0; memcpy(strh_vid + 12, &wPriority, 2);
-    uint16_t wLanguage = 0; memcpy(strh_vid + 14, &wLanguage, 2);
-    uint32_t dwInitialFrames = 0; memcpy(strh_vid + 16, &dwInitialFrames, 4);
-    uint32_t dwScale = 1; memcpy(strh_vid + 20, &dwScale, 4);
-    uint32_t dwRate = fps_; memcpy(strh_vid + 24, &dwRate, 4);
-    uint32_t dwStart = 0; memcpy(strh_vid + 28, &dwStart, 4);
-    uint32_t dwLength = 0; memcpy(strh_vid + 32, &dwLength, 4);
-    uint32_t dwSuggested = suggestedBuf; memcpy(strh_vid + 36, &dwSuggested, 4);
-    uint32_t dwQuality = 0xFFFFFFFF; memcpy(strh_vid + 40, &dwQuality, 4);
-    uint32_t dwSampleSize = 0; memcpy(strh_vid + 44, &dwSampleSize, 4);
+    memcpy(strh_vid + 0, "vids", 4);         // fccType
+    memcpy(strh_vid + 4, videoFourCC_, 4);   // fccHandler: the video codec
+    // dwFlags, wPriority, wLanguage, dwInitialFrames = 0
+    store32(strh_vid + 20, 1);               // dwScale
+    store32(strh_vid + 24, fps_);            // dwRate
+    // dwStart = 0; dwLength patched at close
+    store32(strh_vid + 36, suggestedBuf);    // dwSuggestedBufferSize
+    store32(strh_vid + 40, 0xFFFFFFFF);      // dwQuality
+    // dwSampleSize = 0
     // rcFrame (left, top, right, bottom)
-    int16_t left = 0, top = 0, right = (int16_t)width_, bottom = (int16_t)height_;
-    memcpy(strh_vid + 48, &left, 2); memcpy(strh_vid + 50, &top, 2);
-    memcpy(strh_vid + 52, &right, 2); memcpy(strh_vid + 54, &bottom, 2);
+    store16(strh_vid + 52, (uint16_t)width_);
+    store16(strh_vid + 54, (uint16_t)height_);
 
-    const char strhFourcc[4] = {'s','t','r','h'};
-    writeChunk(strhFourcc, strh_vid, sizeof(strh_vid));
+    videoLengthPos_ = put_chunk(h, "strh", strh_vid, sizeof(strh_vid)) + 32;
 
     // strf for video (BITMAPINFOHEADER)
     uint8_t bi[40]; memset(bi, 0, sizeof(bi));
-    uint32_t biSize = 40; memcpy(bi + 0, &biSize, 4);
-    uint32_t biWidth = width_; memcpy(bi + 4, &biWidth, 4);
-    uint32_t biHeight = height_; memcpy(bi + 8, &biHeight, 4);
-    uint16_t biPlanes = 1; memcpy(bi + 12, &biPlanes, 2);
-    uint16_t biBitCount = 24; memcpy(bi + 14, &biBitCount, 2);
-    // biCompression 'MJPG'
-    bi[16] = 'M'; bi[17] = 'J'; bi[18] = 'P'; bi[19] = 'G';
-    uint32_t biSizeImage = 0; memcpy(bi + 20, &biSizeImage, 4);
-    uint32_t biXPelsPerMeter = 0; memcpy(bi + 24, &biXPelsPerMeter, 4);
-    uint32_t biYPelsPerMeter = 0; memcpy(bi + 28, &biYPelsPerMeter, 4);
-    uint32_t biClrUsed = 0; memcpy(bi + 32, &biClrUsed, 4);
-    uint32_t biClrImportant = 0; memcpy(bi + 36, &biClrImportant, 4);
-
-    const char strfFourcc[4] = {'s','t','r','f'};
-    writeChunk(strfFourcc, bi, sizeof(bi));
-
-    // Backpatch this strl size
-    long afterStrl = ftell(out_);
-    fseek(out_, strlSizePos, SEEK_SET);
-    write_u32_le(out_, (uint32_t)((afterStrl - strlPos) - 8));
-    fseek(out_, afterStrl, SEEK_SET);
+    store32(bi + 0, 40);                     // biSize
+    store32(bi + 4, width_);
+    store32(bi + 8, height_);
+    store16(bi + 12, 1);                     // biPlanes
+    store16(bi + 14, 24);                    // biBitCount
+    memcpy(bi + 16, videoFourCC_, 4);        // biCompression: the video codec
+    // biSizeImage, biXPelsPerMeter, biYPelsPerMeter, biClrUsed, biClrImportant = 0
+
+    put_chunk(h, "strf", bi, sizeof(bi));
+
+    // indx: super index with room for every segment, filled in at close
+    std::vector<uint8_t> indx(24 + 16 * kSuperIndexEntries, 0);
+    store16(indx.data(), 4);                 // wLongsPerEntry; bIndexSubType, bIndexType (of indexes) 0
+    memcpy(indx.data() + 8, streams_[VideoStream].chunkId, 4);
+    streams_[VideoStream].indxPos = put_chunk(h, "indx", indx.data(), (uint32_t)indx.size());
+    store32(h.data() + strlPos + 4, (uint32_t)(h.size() - strlPos - 8));
 
     // If audio parameters are set, write audio stream
+    audioLengthPos_ = 0;
     if (sampleRate_ > 0 && channels_ > 0 && blockAlign_ > 0) {
-        long astrlPos = ftell(out_);
-        fwrite("LIST", 1, 4, out_);
-        long astrlSizePos = ftell(out_);
-        write_u32_le(out_, 0);
-        fwrite("strl", 1, 4, out_);
+        size_t astrlPos = h.size();
+        put_fourcc(h, "LIST");
+        put_u32_le(h, 0);
+        put_fourcc(h, "strl");
 
         // strh for audio
         uint8_t strh_aud[56]; memset(strh_aud, 0, sizeof(strh_aud));
-        // fccType 'auds'
-        strh_aud[0] = 'a'; strh_aud[1] = 'u'; strh_aud[2] = 'd'; strh_aud[3] = 's';
-        // fccHandler zeros
-        uint32_t aud_dwFlags = 0; memcpy(strh_aud + 8, &aud_dwFlags, 4);
-        uint16_t aud_wPriority = 0; memcpy(strh_aud + 12, &aud_wPriority, 2);
-        uint16_t aud_wLanguage = 0; memcpy(strh_aud + 14, &aud_wLanguage, 2);
-        uint32_t aud_dwInitialFrames = 0; memcpy(strh_aud + 16, &aud_dwInitialFrames, 4);
-        uint32_t aud_dwScale = blockAlign_; memcpy(strh_aud + 20, &aud_dwScale, 4);
-        uint32_t aud_dwRate = (uint32_t)sampleRate_ * (uint32_t)blockAlign_; memcpy(strh_aud + 24, &aud_dwRate, 4);
-        uint32_t aud_dwStart = 0; memcpy(strh_aud + 28, &aud_dwStart, 4);
-        uint32_t aud_dwLength = 0; memcpy(strh_aud + 32, &aud_dwLength, 4);
-        uint32_t aud_dwSuggested = (sampleRate_ * blockAlign_) / 10; memcpy(strh_aud + 36, &aud_dwSuggested, 4);
-        uint32_t aud_dwQuality = 0xFFFFFFFF; memcpy(strh_aud + 40, &aud_dwQuality, 4);
-        uint32_t aud_dwSampleSize = blockAlign_; memcpy(strh_aud + 44, &aud_dwSampleSize, 4);
+        memcpy(strh_aud + 0, "auds", 4);     // fccType; fccHandler zeros
+        // dwFlags, wPriority, wLanguage, dwInitialFrames = 0
+        store32(strh_aud + 20, blockAlign_);                      // dwScale
+        store32(strh_aud + 24, sampleRate_ * blockAlign_);        // dwRate
+        // dwStart = 0; dwLength patched at close
+        store32(strh_aud + 36, (sampleRate_ * blockAlign_) / 10); // dwSuggestedBufferSize
+        store32(strh_aud + 40, 0xFFFFFFFF);                       // dwQuality
+        store32(strh_aud + 44, blockAlign_);                      // dwSampleSize
         // rcFrame unused for audio
 
-        writeChunk(strhFourcc, strh_aud, sizeof(strh_aud));
+        audioLengthPos_ = put_chunk(h, "strh", strh_aud, sizeof(strh_aud)) + 32;
 
         // strf for audio (WAVEFORMATEX)
         // wFormatTag(2), nChannels(2), nSamplesPerSec(4), nAvgBytesPerSec(4), nBlockAlign(2), wBitsPerSample(2), cbSize(2)
         uint8_t wf[18]; memset(wf, 0, sizeof(wf));
-        uint16_t wFormatTag = 1; // PCM
-        memcpy(wf + 0, &wFormatTag, 2);
-        memcpy(wf + 2, &channels_, 2);
-        memcpy(wf + 4, &sampleRate_, 4);
-        uint32_t avgBytes = sampleRate_ * blockAlign_; memcpy(wf + 8, &avgBytes, 4);
-        memcpy(wf + 12, &blockAlign_, 2);
-        memcpy(wf + 14, &bitsPerSample_, 2);
-        uint16_t cbSize = 0; memcpy(wf + 16, &cbSize, 2);
-
-        writeChunk(strfFourcc, wf, sizeof(wf));
-
-        long afterAStrl = ftell(out_);
-        fseek(out_, astrlSizePos, SEEK_SET);
-        write_u32_le(out_, (uint32_t)((afterAStrl - astrlPos) - 8));
-        fseek(out_, afterAStrl, SEEK_SET);
+        store16(wf + 0, 1); // PCM
+        store16(wf + 2, channels_);
+        store32(wf + 4, sampleRate_);
+        store32(wf + 8, sampleRate_ * blockAlign_);
+        store16(wf + 12, blockAlign_);
+        store16(wf + 14, bitsPerSample_);
+        // cbSize = 0
+
+        put_chunk(h, "strf", wf, sizeof(wf));
+
+        memcpy(indx.data() + 8, streams_[AudioStream].chunkId, 4);
+        streams_[AudioStream].indxPos = put_chunk(h, "indx", indx.data(), (uint32_t)indx.size());
+        store32(h.data() + astrlPos + 4, (uint32_t)(h.size() - astrlPos - 8));
+    } else {
+        streams_[AudioStream].indxPos = 0;
     }
 
+    // LIST odml: dmlh with the frame count of the whole file
+    put_fourcc(h, "LIST");
+    put_u32_le(h, 4 + 8 + 248);
+    put_fourcc(h, "odml");
+    uint8_t dmlh[248]; memset(dmlh, 0, sizeof(dmlh));
+    dmlhPos_ = put_chunk(h, "dmlh", dmlh, sizeof(dmlh));
+
+    store32(h.data() + hdrlSizePos, (uint32_t)(h.size() - hdrlSizePos - 4));
+
     // Start movi list
-    fwrite("LIST", 1, 4, out_);
-    moviListPos_ = ftell(out_);
-    write_u32_le(out_, 0); // movi size placeholder
-    fwrite("movi", 1, 4, out_);
+    put_fourcc(h, "LIST");
+    riffPos_ = 0;
+    moviListPos_ = firstMoviPos_ = h.size();
+    put_u32_le(h, 0); // movi size placeholder
+    put_fourcc(h, "movi");
+
+    out_.write(h.data(), h.size());
 }
 
-void AVIMux::finalizeHeaders() {
-    long fileEnd = ftell(out_);
-
-    // write idx1
-    long idx1Pos = ftell(out_);
-    fwrite("idx1", 1, 4, out_);
-    uint32_t idx1Size = (uint32_t)(indexEntries_.size() * 16);
-    write_u32_le(out_, idx1Size);
-    for (auto &e : indexEntries_) {
-        write_u32_le(out_, e.ckid);
-        write_u32_le(out_, e.flags);
-        write_u32_le(out_, e.offset);
-        write_u32_le(out_, e.size);
+size_t AVIMux::readJournal(uint64_t first, uint64_t last) {
+    size_t n = (size_t)std::min<uint64_t>(last - first, kJournalBlockRecords);
+    journalBlock_.resize(n * kJournalRecord);
+    if (n == 0 || !seekTo(journal_, sizeof(kJournalMagic) + first * kJournalRecord)) return 0;
+    return fread(journalBlock_.data(), kJournalRecord, n, journal_);
+}
+
+void AVIMux::writeStandardIndex(int stream) {
+    // ix##: offsets are relative to the RIFF the chunks are in, so they fit 32 bits
+    StreamIndex& st = streams_[stream];
+    uint64_t pos = out_.getPosition();
+    uint32_t size = 24 + 8 * st.segmentChunks;
+    uint8_t h[32];
+    memcpy(h, st.indexId, 4);
+    store32(h + 4, size);
+    store16(h + 8, 2);                       // wLongsPerEntry
+    h[10] = 0;                               // bIndexSubType
+    h[11] = 1;                               // bIndexType: index of chunks
+    store32(h + 12, st.segmentChunks);
+    memcpy(h + 16, st.chunkId, 4);
+    store64(h + 20, riffPos_);               // qwBaseOffset
+    store32(h + 28, 0);
+    out_.write(h, sizeof(h));
+
+    // the entries, a journal block at a time
+    std::vector<uint8_t> entries;
+    entries.reserve(8 * kJournalBlockRecords);
+    uint32_t written = 0;
+    for (uint64_t r = segmentFirstRecord_; r < journalRecords_;) {
+        size_t n = readJournal(r, journalRecords_);
+        if (n == 0) break;
+        entries.clear();
+        for (size_t i = 0; i < n; ++i) {
+            const uint8_t* rec = journalBlock_.data() + i * kJournalRecord;
+            if (load32(rec + 12) != (uint32_t)stream) continue;
+            uint8_t e[8];
+            store32(e, (uint32_t)(load64(rec) - riffPos_));
+            store32(e + 4, load32(rec + 8));
+            entries.insert(entries.end(), e, e + 8);
+        }
+        out_.write(entries.data(), entries.size());
+        written += (uint32_t)(entries.size() / 8);
+        r += n;
+    }
+    if (written < st.segmentChunks) {
+        // unreadable journal: keep the layout, the entries are lost
+        std::cerr << "AVIMux: reading " << journalName_ << " failed" << std::endl;
+        entries.assign(8 * (size_t)(st.segmentChunks - written), 0);
+        out_.write(entries.data(), entries.size());
+    }
+
+    SegmentIndex seg;
+    seg.offset = pos;
+    seg.size = 8 + size;
+    seg.duration = (uint32_t)st.segmentDuration;
+    st.segments.push_back(seg);
+    st.segmentDuration = 0;
+}
+
+void AVIMux::writeLegacyIndex() {
+    // idx1 over every chunk of the first RIFF, from the journal
+    uint64_t count = journalRecords_ - segmentFirstRecord_;
+    uint8_t h[8];
+    memcpy(h, "idx1", 4);
+    store32(h + 4, (uint32_t)(count * 16));
+    out_.write(h, sizeof(h));
+
+    std::vector<uint8_t> entries;
+    entries.reserve(16 * kJournalBlockRecords);
+    uint64_t written = 0;
+    for (uint64_t r = segmentFirstRecord_; r < journalRecords_;) {
+        size_t n = readJournal(r, journalRecords_);
+        if (n == 0) break;
+        entries.resize(16 * n);
+        uint8_t* p = entries.data();
+        for (size_t i = 0; i < n; ++i) {
+            const uint8_t* rec = journalBlock_.data() + i * kJournalRecord;
+            uint32_t size = load32(rec + 8);
+            memcpy(p, streams_[load32(rec + 12) == AudioStream ? AudioStream : VideoStream].chunkId, 4);
+            store32(p + 4, (size & kNotKeyframe) ? 0 : 0x10); // AVIIF_KEYFRAME
+            store32(p + 8, (uint32_t)(load64(rec) - 8 - moviOffsetBase()));
+            store32(p + 12, size & ~kNotKeyframe);
+            p += 16;
+        }
+        out_.write(entries.data(), entries.size());
+        written += n;
+        r += n;
+    }
+    if (written < count) {
+        std::cerr << "AVIMux: reading " << journalName_ << " failed" << std::endl;
+        entries.assign(16 * (size_t)(count - written), 0);
+        out_.write(entries.data(), entries.size());
+    }
+}
+
+void AVIMux::finishSegment() {
+    // standard indexes go at the end of the segment's movi list
+    for (int s = VideoStream; s <= AudioStream; ++s) {
+        if (streams_[s].indxPos != 0 && streams_[s].segmentChunks > 0) writeStandardIndex(s);
+    }
+
+    uint8_t v[4];
+    uint64_t moviEnd = out_.getPosition();
+    store32(v, (uint32_t)(moviEnd - moviListPos_ - 4)); // 'movi' through the last chunk
+    out_.patch(moviListPos_, v, 4);
+
+    if (firstRiff_) {
+        writeLegacyIndex();
+        firstRiffFrames_ = videoFrames_;
+        firstRiff_ = false;
     }
 
-    long finalPos = ftell(out_);
+    store32(v, (uint32_t)(out_.getPosition() - riffPos_ - 8));
+    out_.patch(riffPos_ + 4, v, 4);
 
-    // Backpatch RIFF size
-    fseek(out_, riffSizePos_, SEEK_SET);
-    write_u32_le(out_, (uint32_t)(finalPos - 8));
+    // back to appending
+    fseek(journal_, 0, SEEK_END);
+    segmentFirstRecord_ = journalRecords_;
+    for (StreamIndex& st : streams_) st.segmentChunks = 0;
+}
 
-    // Backpatch hdrl list size
-    fseek(out_, hdrlListPos_, SEEK_SET);
-    write_u32_le(out_, (uint32_t)((moviListPos_ - hdrlListPos_) - 8));
+bool AVIMux::startSegment() {
+    // segments lists finished segments only: the one still open and the new one need a
+    // super index entry each, so the last free entry goes to the open segment
+    size_t finished = std::max(streams_[VideoStream].segments.size(), streams_[AudioStream].segments.size());
+    if (finished + 2 > kSuperIndexEntries) {
+        if (!indexFull_) std::cerr << "AVIMux: " << filename_ << " has no room for more segments" << std::endl;
+        indexFull_ = true;
+        return false;
+    }
+    finishSegment();
+
+    riffPos_ = out_.getPosition();
+    uint8_t h[24];
+    memcpy(h, "RIFF", 4);
+    store32(h + 4, 0);                       // patched when the segment is finished
+    memcpy(h + 8, "AVIX", 4);
+    memcpy(h + 12, "LIST", 4);
+    store32(h + 16, 0);
+    memcpy(h + 20, "movi", 4);
+    out_.write(h, sizeof(h));
+    moviListPos_ = riffPos_ + 16;
+    return true;
+}
 
-    // Backpatch movi list size
-    uint32_t moviSize = (uint32_t)(idx1Pos - (moviListPos_));
-    fseek(out_, moviListPos_ - 4, SEEK_SET);
-    write_u32_le(out_, moviSize);
+void AVIMux::patchLengths() {
+    uint8_t v[4];
+    // frame counts: avih dwTotalFrames covers the first RIFF; the streams' dwLength and
+    // dmlh the whole file
+    store32(v, firstRiff_ ? videoFrames_ : firstRiffFrames_);
+    out_.patch(totalFramesPos_, v, 4);
+    store32(v, videoFrames_);
+    out_.patch(videoLengthPos_, v, 4);
+    out_.patch(dmlhPos_, v, 4);
+    if (audioLengthPos_ != 0) {
+        store32(v, (uint32_t)(audioBytes_ / blockAlign_)); // in dwScale (block) units
+        out_.patch(audioLengthPos_, v, 4);
+    }
 
-    fseek(out_, finalPos, SEEK_SET);
+    // super indexes: nEntriesInUse and the entries
+    for (StreamIndex& st : streams_) {
+        if (st.indxPos == 0) continue;
+        store32(v, (uint32_t)st.segments.size());
+        out_.patch(st.indxPos + 4, v, 4);
+        std::vector<uint8_t> entries(16 * st.segments.size());
+        uint8_t* p = entries.data();
+        for (const SegmentIndex& seg : st.segments) {
+            store64(p, seg.offset);
+            store32(p + 8, seg.size);
+            store32(p + 12, seg.duration);
+            p += 16;
+        }
+        if (!entries.empty()) out_.patch(st.indxPos + 24, entries.data(), entries.size());
+    }
+}
+
+void AVIMux::finalizeHeaders() {
+    finishSegment();
+    patchLengths();
+}
+
+void AVIMux::checkpoint() {
+    if (!out_.isOpen()) return;
+    // the current RIFF and movi list end at the last chunk for now
+    uint8_t v[4];
+    uint64_t end = out_.getPosition();
+    store32(v, (uint32_t)(end - moviListPos_ - 4));
+    out_.patch(moviListPos_, v, 4);
+    store32(v, (uint32_t)(end - riffPos_ - 8));
+    out_.patch(riffPos_ + 4, v, 4);
+    patchLengths();
+    fflush(journal_);
+    out_.flush(false);
+    lastCheckpointUs_ = telemetry_now_us();
+}
+
+bool AVIMux::writeStreamChunk(int stream, const uint8_t* data, size_t size, bool keyframe) {
+    if (!out_.isOpen() || indexFull_) return false;
+    StreamIndex& st = streams_[stream];
+    uint64_t chunkBytes = 8 + size + (size & 1);
+    bool segmentHasChunks = journalRecords_ > segmentFirstRecord_;
+    if (segmentHasChunks && out_.getPosition() + chunkBytes - riffPos_ > segmentSize_) {
+        if (!startSegment()) return false;
+    }
+
+    // journaled first: a chunk is only written once it can be indexed
+    uint8_t rec[kJournalRecord];
+    store64(rec, out_.getPosition() + 8);
+    store32(rec + 8, (uint32_t)size | (keyframe ? 0 : kNotKeyframe));
+    store32(rec + 12, (uint32_t)stream);
+    if (fwrite(rec, 1, sizeof(rec), journal_) != sizeof(rec)) return false;
+    ++journalRecords_;
+    ++st.segmentChunks;
+    if (!writeChunk(st.chunkId, data, (uint32_t)size)) return false;
+
+    if (checkpointMs_ > 0 && telemetry_now_us() - lastCheckpointUs_ >= (uint64_t)checkpointMs_ * 1000) checkpoint();
+    return true;
 }
 
 bool AVIMux::writeVideoFrame(const uint8_t* frameData, size_t frameSize) {
-    if (!out_) return false;
-    const char fourcc[4] = {'0','0','d','c'};
-    uint32_t pos = writeChunk(fourcc, frameData, (uint32_t)frameSize);
-
-    IndexEntry ie;
-    ie.ckid = 0x63646F30; // '00dc' little-endian
-    ie.flags = 0x10; // keyframe
-    ie.offset = pos - moviListPos_;
-    ie.size = (uint32_t)frameSize;
-    indexEntries_.push_back(ie);
+    if (!out_.isOpen()) return false;
+    // an empty chunk repeats the frame before
+    if (!writeStreamChunk(VideoStream, frameData, frameSize, frameSize > 0)) return false;
+    ++videoFrames_;
+    ++streams_[VideoStream].segmentDuration;
     return true;
 }
 
 bool AVIMux::writeAudioSamples(const uint8_t* audioData, size_t audioSize) {
-    if (!out_) return false;
-    const char fourcc[4] = {'0','1','w','b'};
-    uint32_t pos = writeChunk(fourcc, audioData, (uint32_t)audioSize);
-
-    IndexEntry ie;
-    ie.ckid = 0x62773130; // '01wb'
-    ie.flags = 0;
-    ie.offset = pos - moviListPos_;
-    ie.size = (uint32_t)audioSize;
-    indexEntries_.push_back(ie);
+    if (!out_.isOpen()) return false;
+    if (!writeStreamChunk(AudioStream, audioData, audioSize, true)) return false;
+    audioBytes_ += audioSize;
+    if (blockAlign_ > 0) streams_[AudioStream].segmentDuration += audioSize / blockAlign_;
     return true;
-}
\ No newline at end of file
+}
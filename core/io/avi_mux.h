@@ -6,44 +6,141 @@
 #include <string>
 #include <vector>
 
-class AVIMux {
+#include "muxer.h"
+#include "writer.h"
+
+// OpenDML (AVI 2.0) writer, so one recording can run for hours.
+//
+// The file is a chain of RIFF segments of about setSegmentSize() bytes: 'AVI ' with the
+// headers, its movi list and a legacy idx1 (which old players read, covering only this
+// first segment), then 'AVIX' segments holding just a movi list. Each movi list ends with
+// a standard index per stream ('ix00' video, 'ix01' audio) of the chunks in it; the
+// 'indx' super index in each stream header points at those, and 'dmlh' carries the total
+// frame count. Every size field then stays within 32 bits while file offsets are 64-bit.
+//
+// Chunks are staged in a Writer buffer (header, payload and padding copied back to back,
+// one OS write per buffer, by default on the Writer's I/O thread) and the file offset is
+// tracked in memory; close() patches the sizes and frame counts into the headers.
+//
+// The index is not kept in memory: every chunk is appended to a sidecar journal
+// (journalPath()) as it is written, and the ix## and idx1 indexes of a segment are
+// serialized from it when the segment ends, so memory use stays the same however long the
+// recording runs. Every setCheckpointInterval() the sizes and counts in the headers are
+// patched to cover what has been written so far and both files are handed to the OS. A
+// recording cut short by a crash therefore has valid headers up to the last checkpoint,
+// and recoverAVI() (avi_recovery.h) rebuilds a complete file from it and its journal. A
+// clean close() deletes the journal.
+class AVIMux : public Muxer {
 public:
     AVIMux(const std::string& filename);
-    ~AVIMux();
+    ~AVIMux() override;
+
+    bool open() override;
+    bool close() override;
+    bool writeVideoFrame(const uint8_t* frameData, size_t frameSize) override;
+    bool writeAudioSamples(const uint8_t* audioData, size_t audioSize) override;
+    // fourcc: the video codec (fccHandler / biCompression), e.g. videoCodecFourCC().
+    // Stream parameters go into the headers open() writes, so set them before it.
+    void setVideoParameters(uint32_t width, uint32_t height, uint32_t fps, const char* fourcc = "MJPG") override;
+    void setAudioParameters(uint32_t sampleRate, uint32_t channels, uint16_t blockAlign, uint16_t bitsPerSample) override;
+
+    // Staging buffer size, per buffer with the I/O thread; call before open() (default 4 MB,
+    // 8 MB with WriterBackend::Stdio)
+    void setWriteBufferSize(size_t bytes);
+
+    // How the file is written (see Writer); call before open(). The default, Threaded with
+    // three buffers, leaves disk latency to an I/O thread so a slow write does not hold up
+    // the caller until all of them are queued.
+    void setWriterBackend(WriterBackend backend, int bufferCount = 3) override;
+    WriterBackend getWriterBackend() const { return out_.getBackend(); }
+    // Callable from any thread while open
+    WriterStats getWriterStats() const override { return out_.getStats(); }
+
+    // How often the headers are brought up to date while recording (default 2000 ms, 0: only
+    // at close())
+    void setCheckpointInterval(uint32_t ms) override;
+    // Patch the headers to cover every chunk written so far and hand the file and the
+    // journal to the OS (without waiting for the disk)
+    void checkpoint();
 
-    bool open();
-    void close();
-    bool writeVideoFrame(const uint8_t* frameData, size_t frameSize);
-    bool writeAudioSamples(const uint8_t* audioData, size_t audioSize);
-    void setVideoParameters(uint32_t width, uint32_t height, uint32_t fps);
-    void setAudioParameters(uint32_t sampleRate, uint32_t channels, uint16_t blockAlign, uint16_t bitsPerSample);
+    // The index journal kept next to filename while it is recorded: "AVIJRNL1", then 16
+    // little-endian bytes per chunk in file order: u64 file offset of the chunk data, u32
+    // size (bit 31 set: not a key frame), u32 stream (0 video, 1 audio)
+    static std::string journalPath(const std::string& filename);
+
+    // RIFF segment size before the next chunk starts a new AVIX segment (default 1 GB, the
+    // size players expect of the first one). The super index has room for 256 segments;
+    // writes fail once they are used up. Call before open().
+    void setSegmentSize(uint64_t bytes) override;
 
 private:
-    struct IndexEntry {
-        uint32_t ckid; // FourCC
-        uint32_t flags;
-        uint32_t offset; // from 'movi' chunk start
-        uint32_t size;
+    // One standard index in a super index
+    struct SegmentIndex {
+        uint64_t offset;   // file offset of the ix## chunk
+        uint32_t size;     // of the ix## chunk, header included
+        uint32_t duration; // frames (video) or blocks (audio) it covers
+    };
+
+    struct StreamIndex {
+        char chunkId[4];                   // '00dc' / '01wb'
+        char indexId[4];                   // 'ix00' / 'ix01'
+        uint64_t indxPos;                  // file offset of the indx chunk data, 0: no stream
+        uint32_t segmentChunks;            // in the current segment
+        uint64_t segmentDuration;
+        std::vector<SegmentIndex> segments;
     };
 
+    enum { VideoStream = 0, AudioStream = 1 };
+
     std::string filename_;
-    FILE* out_;
+    Writer out_;
     uint32_t width_;
     uint32_t height_;
     uint32_t fps_;
+    char videoFourCC_[4];
     uint32_t sampleRate_;
     uint16_t channels_;
     uint16_t blockAlign_;
     uint16_t bitsPerSample_;
+    uint64_t segmentSize_;
+
+    uint64_t riffPos_;         // file offset of the current RIFF
+    uint64_t moviListPos_;     // file offset of the current movi list size field
+    uint64_t firstMoviPos_;    // the first RIFF's movi list size field (idx1 offsets)
+    uint64_t totalFramesPos_;  // avih dwTotalFrames
+    uint64_t videoLengthPos_;  // video strh dwLength
+    uint64_t audioLengthPos_;  // audio strh dwLength, 0 without audio
+    uint64_t dmlhPos_;         // dmlh dwTotalFrames
+    uint32_t videoFrames_;
+    uint32_t firstRiffFrames_; // video frames in the first RIFF (avih dwTotalFrames)
+    uint64_t audioBytes_;
+    bool firstRiff_;
+    bool indexFull_;
+    StreamIndex streams_[2];
 
-    long riffSizePos_;
-    long hdrlListPos_;
-    long moviListPos_; // file offset where 'movi' data begins
-    std::vector<IndexEntry> indexEntries_;
+    std::string journalName_;
+    FILE* journal_;
+    uint64_t journalRecords_;     // chunks journaled
+    uint64_t segmentFirstRecord_; // journal record of the current segment's first chunk
+    std::vector<uint8_t> journalBlock_;
+    uint32_t checkpointMs_;
+    uint64_t lastCheckpointUs_;
 
-    void writeHeadersPlaceholder();
+    void writeHeaders();
     void finalizeHeaders();
-    uint32_t writeChunk(const char fourcc[4], const void* data, uint32_t size);
+    uint32_t moviOffsetBase() const;
+    // False once a write to the file has failed
+    bool writeChunk(const char fourcc[4], const void* data, uint32_t size);
+    bool writeStreamChunk(int stream, const uint8_t* data, size_t size, bool keyframe);
+    // Close the current RIFF (standard indexes, idx1 for the first, sizes) and open an AVIX
+    bool startSegment();
+    void finishSegment();
+    void writeStandardIndex(int stream);
+    void writeLegacyIndex();
+    // Frame counts and super indexes
+    void patchLengths();
+    // Read up to a block of journal records from first on into journalBlock_; returns how many
+    size_t readJournal(uint64_t first, uint64_t last);
 };
 
-#endif // AVI_MUX_H
\ No newline at end of file
+#endif // AVI_MUX_H
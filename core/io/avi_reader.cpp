@@ -0,0 +1,147 @@
+#include "avi_reader.h"
+#include <cstring>
+
+static uint32_t get16(const uint8_t* p) { return (uint32_t)p[0] | ((uint32_t)p[1] << 8); }
+static uint32_t get32(const uint8_t* p) { return get16(p) | (get16(p + 2) << 16); }
+
+uint32_t AVIReader::fourcc(const char id[4]) {
+    return get32(reinterpret_cast<const uint8_t*>(id));
+}
+
+AVIReader::AVIReader(const std::string& filename) : filename_(filename), in_(nullptr), fileSize_(0) {
+    memset(&info_, 0, sizeof(info_));
+}
+
+AVIReader::~AVIReader() {
+    close();
+}
+
+void AVIReader::close() {
+    if (in_) fclose(in_);
+    in_ = nullptr;
+}
+
+bool AVIReader::skip(uint64_t bytes) {
+    // fseek takes a long, which is 32 bits on Windows
+    while (bytes > 0) {
+        long step = (long)(bytes < (1u << 30) ? bytes : (1u << 30));
+        if (fseek(in_, step, SEEK_CUR) != 0) return false;
+        bytes -= (uint64_t)step;
+    }
+    return true;
+}
+
+bool AVIReader::open() {
+    in_ = fopen(filename_.c_str(), "rb");
+    if (!in_) return false;
+#ifdef _WIN32
+    if (_fseeki64(in_, 0, SEEK_END) == 0) fileSize_ = (uint64_t)_ftelli64(in_);
+#else
+    if (fseeko(in_, 0, SEEK_END) == 0) fileSize_ = (uint64_t)ftello(in_);
+#endif
+    rewind(in_);
+    uint8_t riff[12];
+    if (fread(riff, 1, 12, in_) != 12 || memcmp(riff, "RIFF", 4) != 0 || memcmp(riff + 8, "AVI ", 4) != 0) {
+        close();
+        return false;
+    }
+
+    // Walk the header chunks flat (list sizes are only patched when a recording is closed)
+    // until the movi list; strf is read in the context of the strh before it
+    char streamType[4] = {0, 0, 0, 0};
+    std::vector<uint8_t> body;
+    for (;;) {
+        uint8_t h[12];
+        if (fread(h, 1, 8, in_) != 8) break;
+        uint32_t size = get32(h + 4);
+        if (memcmp(h, "LIST", 4) == 0) {
+            if (fread(h + 8, 1, 4, in_) != 4) break;
+            if (memcmp(h + 8, "movi", 4) == 0) {
+                if (info_.fpsDen == 0) { info_.fpsNum = 30; info_.fpsDen = 1; }
+                return true;
+            }
+            if (memcmp(h + 8, "hdrl", 4) == 0 || memcmp(h + 8, "strl", 4) == 0 || memcmp(h + 8, "odml", 4) == 0) continue;
+            if (size < 4 || !skip((uint64_t)size - 4 + (size & 1))) break;
+            continue;
+        }
+
+        bool wanted = memcmp(h, "avih", 4) == 0 || memcmp(h, "strh", 4) == 0 || memcmp(h, "strf", 4) == 0;
+        if (!wanted) {
+            if (!skip((uint64_t)size + (size & 1))) break;
+            continue;
+        }
+        if (size > (1u << 20)) break;
+        body.resize(size);
+        if (size > 0 && fread(body.data(), 1, size, in_) != size) break;
+        if ((size & 1) && !skip(1)) break;
+        const uint8_t* b = body.data();
+
+        if (memcmp(h, "avih", 4) == 0 && size >= 40) {
+            info_.width = get32(b + 32);
+            info_.height = get32(b + 36);
+        } else if (memcmp(h, "strh", 4) == 0 && size >= 28) {
+            memcpy(streamType, b, 4);
+            if (memcmp(streamType, "vids", 4) == 0 && get32(b + 20) > 0) {
+                info_.fpsDen = get32(b + 20);
+                info_.fpsNum = get32(b + 24);
+            }
+        } else if (memcmp(streamType, "vids", 4) == 0 && size >= 20) {
+            info_.width = get32(b + 4);
+            info_.height = get32(b + 8);
+            memcpy(info_.videoFourCC, b + 16, 4);
+            info_.videoFourCC[4] = 0;
+        } else if (memcmp(streamType, "auds", 4) == 0 && size >= 16) {
+            info_.hasAudio = true;
+            info_.audioFormat = (uint16_t)get16(b);
+            info_.channels = (uint16_t)get16(b + 2);
+            info_.sampleRate = get32(b + 4);
+            info_.blockAlign = (uint16_t)get16(b + 12);
+            info_.bitsPerSample = (uint16_t)get16(b + 14);
+        }
+    }
+    close();
+    return false;
+}
+
+bool AVIReader::readChunkAt(uint64_t pos, uint32_t& id, std::vector<uint8_t>& data) {
+    if (!in_) return false;
+    rewind(in_);
+    uint8_t h[8];
+    if (!skip(pos) || fread(h, 1, 8, in_) != 8) return false;
+    id = get32(h);
+    uint32_t size = get32(h + 4);
+    if (pos + 8 + size > fileSize_) return false;
+    data.resize(size);
+    if (size > 0 && fread(data.data(), 1, size, in_) != size) return false;
+    if (size & 1) fgetc(in_);
+    return true;
+}
+
+bool AVIReader::readChunk(uint32_t& id, std::vector<uint8_t>& data) {
+    if (!in_) return false;
+    for (;;) {
+        uint8_t h[8];
+        if (fread(h, 1, 8, in_) != 8) return false;
+        id = get32(h);
+        uint32_t size = get32(h + 4);
+        // zero-filled space past the last chunk (preallocated or never written)
+        if (id == 0) return false;
+
+        if (memcmp(h, "LIST", 4) == 0 || memcmp(h, "RIFF", 4) == 0) {
+            // movi, 'rec ' and AVIX lists: their chunks follow
+            uint8_t type[4];
+            if (fread(type, 1, 4, in_) != 4) return false;
+            continue;
+        }
+        if (memcmp(h, "idx1", 4) == 0 || memcmp(h, "indx", 4) == 0 || memcmp(h, "JUNK", 4) == 0 ||
+            (h[0] == 'i' && h[1] == 'x')) {
+            if (!skip((uint64_t)size + (size & 1))) return false;
+            continue;
+        }
+
+        data.resize(size);
+        if (size > 0 && fread(data.data(), 1, size, in_) != size) return false;
+        if (size & 1) fgetc(in_);
+        return true;
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef AVI_READER_H
+#define AVI_READER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Stream parameters from an AVI's hdrl (zero where the file does not say)
+struct AVIStreamInfo {
+    char videoFourCC[5];  // biCompression, NUL-terminated
+    uint32_t width;
+    uint32_t height;
+    uint32_t fpsNum;      // strh dwRate / dwScale
+    uint32_t fpsDen;
+    bool hasAudio;
+    uint16_t audioFormat; // WAVEFORMATEX
+    uint16_t channels;
+    uint32_t sampleRate;
+    uint16_t blockAlign;
+    uint16_t bitsPerSample;
+};
+
+// Sequential reader for the AVI files AVIMux writes. open() parses the headers; readChunk()
+// then returns the data chunks ('00dc', '01wb', ...) of every movi list in file order,
+// descending into 'rec ' lists and following RIFF-AVIX extensions. Index chunks are
+// skipped and idx1 is not needed, so files whose sizes were never patched (an interrupted
+// recording) read up to their last complete chunk.
+class AVIReader {
+public:
+    AVIReader(const std::string& filename);
+    ~AVIReader();
+
+    bool open();
+    void close();
+
+    const AVIStreamInfo& getInfo() const { return info_; }
+
+    // Next data chunk; false at the end of the file or at a truncated chunk
+    bool readChunk(uint32_t& fourcc, std::vector<uint8_t>& data);
+
+    // The chunk whose header is at file offset pos, whatever it is (e.g. one found through
+    // an index); readChunk() then carries on after it. False if it does not fit the file.
+    bool readChunkAt(uint64_t pos, uint32_t& fourcc, std::vector<uint8_t>& data);
+
+    // FourCC as the little-endian uint32 readChunk() reports
+    static uint32_t fourcc(const char id[4]);
+
+private:
+    bool skip(uint64_t bytes);
+
+    std::string filename_;
+    FILE* in_;
+    uint64_t fileSize_;
+    AVIStreamInfo info_;
+};
+
+#endif // AVI_READER_H
@@ -0,0 +1,90 @@
+#include "avi_recovery.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "avi_mux.h"
+#include "avi_reader.h"
+
+static uint32_t get32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t get64(const uint8_t* p) {
+    return (uint64_t)get32(p) | ((uint64_t)get32(p + 4) << 32);
+}
+
+bool recoverAVI(const std::string& damaged, const std::string& out, AVIRecoveryStats& stats) {
+    memset(&stats, 0, sizeof(stats));
+    AVIReader reader(damaged);
+    if (!reader.open()) return false;
+    const AVIStreamInfo& info = reader.getInfo();
+    const uint32_t ids[2] = {AVIReader::fourcc("00dc"), AVIReader::fourcc("01wb")};
+
+    AVIMux mux(out);
+    uint32_t fps = info.fpsDen ? (info.fpsNum + info.fpsDen / 2) / info.fpsDen : 30;
+    mux.setVideoParameters(info.width, info.height, fps, info.videoFourCC[0] ? info.videoFourCC : "MJPG");
+    if (info.hasAudio) mux.setAudioParameters(info.sampleRate, info.channels, info.blockAlign, info.bitsPerSample);
+    if (!mux.open()) return false;
+
+    uint32_t id;
+    std::vector<uint8_t> data;
+    bool written = true; // every chunk copied so far reached out
+    auto copy = [&](uint32_t chunkId) {
+        if (chunkId == ids[0]) {
+            written = written && mux.writeVideoFrame(data.data(), data.size());
+            ++stats.videoFrames;
+        } else if (chunkId == ids[1]) {
+            written = written && mux.writeAudioSamples(data.data(), data.size());
+            ++stats.audioChunks;
+        } else {
+            return false;
+        }
+        return true;
+    };
+
+    // Chunks the journal knows about; each is checked against the header in the file, since
+    // the journal may have reached the disk ahead of the data it describes
+    uint64_t lastChunk = 0; // header offset of the last chunk found through the journal
+    if (FILE* journal = fopen(AVIMux::journalPath(damaged).c_str(), "rb")) {
+        uint8_t magic[8];
+        if (fread(magic, 1, 8, journal) == 8 && memcmp(magic, "AVIJRNL1", 8) == 0) {
+            std::vector<uint8_t> block(16 * 4096);
+            size_t n;
+            while ((n = fread(block.data(), 16, 4096, journal)) > 0) {
+                for (size_t i = 0; i < n; ++i) {
+                    const uint8_t* rec = block.data() + 16 * i;
+                    uint64_t dataPos = get64(rec);
+                    uint32_t size = get32(rec + 8) & 0x7FFFFFFFu;
+                    uint32_t stream = get32(rec + 12);
+                    if (stream > 1 || dataPos < 8 || !reader.readChunkAt(dataPos - 8, id, data) ||
+                        id != ids[stream] || data.size() != size) {
+                        ++stats.journalMisses;
+                        continue;
+                    }
+                    copy(id);
+                    if (!written) break;
+                    ++stats.journaledChunks;
+                    lastChunk = dataPos - 8;
+                }
+                if (!written) break;
+            }
+        }
+        fclose(journal);
+    }
+
+    // Walk on from the last journaled chunk, or from the start of the movi list
+    bool scan;
+    if (lastChunk > 0) {
+        scan = reader.readChunkAt(lastChunk, id, data);
+    } else {
+        reader.close();
+        scan = reader.open();
+    }
+    while (scan && written && reader.readChunk(id, data)) {
+        if (copy(id)) ++stats.scannedChunks;
+    }
+
+    bool closed = mux.close();
+    return written && closed;
+}
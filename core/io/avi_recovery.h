@@ -0,0 +1,24 @@
+#ifndef AVI_RECOVERY_H
+#define AVI_RECOVERY_H
+
+#include <cstdint>
+#include <string>
+
+struct AVIRecoveryStats {
+    uint64_t videoFrames;
+    uint64_t audioChunks;
+    uint64_t journaledChunks; // found through the journal
+    uint64_t journalMisses;   // journal records whose chunk is not (fully) in the file
+    uint64_t scannedChunks;   // found by walking the movi lists past the journal
+};
+
+// Rebuild a complete AVI from a recording AVIMux did not close (crash, power loss, full
+// disk): its headers give the stream parameters, the chunks are located through the index
+// journal AVIMux kept next to it (AVIMux::journalPath()), if there is one, and then by
+// walking the movi lists on from the last journaled chunk, so chunks written after the
+// last journal flush or without any journal are found too. Every complete chunk is copied
+// into out, which AVIMux writes with fresh indexes. Also works on intact files. False if
+// damaged has no readable AVI header or out cannot be written.
+bool recoverAVI(const std::string& damaged, const std::string& out, AVIRecoveryStats& stats);
+
+#endif // AVI_RECOVERY_H
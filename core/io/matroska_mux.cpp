@@ -0,0 +1,275 @@
+#include "matroska_mux.h"
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// EBML element IDs (with their length marker bits, as written)
+static const uint32_t kEBML = 0x1A45DFA3;
+static const uint32_t kEBMLVersion = 0x4286;
+static const uint32_t kEBMLReadVersion = 0x42F7;
+static const uint32_t kEBMLMaxIDLength = 0x42F2;
+static const uint32_t kEBMLMaxSizeLength = 0x42F3;
+static const uint32_t kDocType = 0x4282;
+static const uint32_t kDocTypeVersion = 0x4287;
+static const uint32_t kDocTypeReadVersion = 0x4285;
+static const uint32_t kSegment = 0x18538067;
+static const uint32_t kInfo = 0x1549A966;
+static const uint32_t kTimestampScale = 0x2AD7B1;
+static const uint32_t kMuxingApp = 0x4D80;
+static const uint32_t kWritingApp = 0x5741;
+static const uint32_t kTracks = 0x1654AE6B;
+static const uint32_t kTrackEntry = 0xAE;
+static const uint32_t kTrackNumber = 0xD7;
+static const uint32_t kTrackUID = 0x73C5;
+static const uint32_t kTrackType = 0x83;
+static const uint32_t kFlagLacing = 0x9C;
+static const uint32_t kCodecID = 0x86;
+static const uint32_t kCodecPrivate = 0x63A2;
+static const uint32_t kDefaultDuration = 0x23E383;
+static const uint32_t kVideo = 0xE0;
+static const uint32_t kPixelWidth = 0xB0;
+static const uint32_t kPixelHeight = 0xBA;
+static const uint32_t kAudio = 0xE1;
+static const uint32_t kSamplingFrequency = 0xB5;
+static const uint32_t kChannels = 0x9F;
+static const uint32_t kBitDepth = 0x6264;
+static const uint32_t kCluster = 0x1F43B675;
+static const uint32_t kTimestamp = 0xE7;
+static const uint32_t kSimpleBlock = 0xA3;
+
+// Size field of a Segment or Cluster that runs until the next element that cannot be its child
+static const uint64_t kUnknownSize = 0x01FFFFFFFFFFFFFFull;
+
+static const char* kAppName = "Ultra-Light Game Screen Recorder";
+
+static inline void store16(uint8_t* p, uint32_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+}
+
+static inline void store32(uint8_t* p, uint32_t v) {
+    store16(p, v & 0xFFFF);
+    store16(p + 2, v >> 16);
+}
+
+static void put_id(std::vector<uint8_t>& h, uint32_t id) {
+    int bytes = id > 0xFFFFFF ? 4 : id > 0xFFFF ? 3 : id > 0xFF ? 2 : 1;
+    for (int i = bytes - 1; i >= 0; --i) h.push_back((uint8_t)(id >> (8 * i)));
+}
+
+// Shortest EBML variable-size integer for v (all-ones values are reserved for "unknown");
+// returns its length
+static size_t store_vint(uint8_t* p, uint64_t v) {
+    int bytes = 1;
+    while (bytes < 8 && v >= (1ull << (7 * bytes)) - 1) ++bytes;
+    uint64_t coded = v | (1ull << (7 * bytes));
+    for (int i = 0; i < bytes; ++i) p[i] = (uint8_t)(coded >> (8 * (bytes - 1 - i)));
+    return (size_t)bytes;
+}
+
+static void put_vint(std::vector<uint8_t>& h, uint64_t v) {
+    uint8_t b[8];
+    size_t n = store_vint(b, v);
+    h.insert(h.end(), b, b + n);
+}
+
+static void put_element(std::vector<uint8_t>& h, uint32_t id, const void* data, size_t size) {
+    put_id(h, id);
+    put_vint(h, size);
+    const uint8_t* bytes = (const uint8_t*)data;
+    h.insert(h.end(), bytes, bytes + size);
+}
+
+static void put_uint(std::vector<uint8_t>& h, uint32_t id, uint64_t v) {
+    uint8_t b[8];
+    int bytes = 1;
+    while (bytes < 8 && (v >> (8 * bytes)) != 0) ++bytes;
+    for (int i = 0; i < bytes; ++i) b[i] = (uint8_t)(v >> (8 * (bytes - 1 - i)));
+    put_element(h, id, b, bytes);
+}
+
+static void put_string(std::vector<uint8_t>& h, uint32_t id, const char* s) {
+    put_element(h, id, s, strlen(s));
+}
+
+static void put_float(std::vector<uint8_t>& h, uint32_t id, double v) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    uint8_t b[8];
+    for (int i = 0; i < 8; ++i) b[i] = (uint8_t)(bits >> (8 * (7 - i)));
+    put_element(h, id, b, sizeof(b));
+}
+
+static void put_master(std::vector<uint8_t>& h, uint32_t id, const std::vector<uint8_t>& body) {
+    put_element(h, id, body.data(), body.size());
+}
+
+MatroskaMux::MatroskaMux(const std::string& filename)
+    : filename_(filename), out_(filename), width_(0), height_(0), fps_(30),
+      sampleRate_(0), channels_(0), blockAlign_(0), bitsPerSample_(16), clusterMs_(1000),
+      clusterOpen_(false), clusterTimestamp_(0), videoFrames_(0), audioBytes_(0) {
+    memcpy(videoFourCC_, "MJPG", 4);
+    out_.setBackend(WriterBackend::Threaded);
+}
+
+MatroskaMux::~MatroskaMux() {
+    close();
+}
+
+void MatroskaMux::setVideoParameters(uint32_t width, uint32_t height, uint32_t fps, const char* fourcc) {
+    width_ = width; height_ = height; fps_ = fps > 0 ? fps : 30;
+    if (fourcc && strlen(fourcc) == 4) memcpy(videoFourCC_, fourcc, 4);
+}
+
+void MatroskaMux::setAudioParameters(uint32_t sampleRate, uint32_t channels, uint16_t blockAlign, uint16_t bitsPerSample) {
+    sampleRate_ = sampleRate; channels_ = (uint16_t)channels; blockAlign_ = blockAlign; bitsPerSample_ = bitsPerSample;
+}
+
+void MatroskaMux::setWriteBufferSize(size_t bytes) {
+    out_.setBufferSize(bytes);
+}
+
+void MatroskaMux::setWriterBackend(WriterBackend backend, int bufferCount) {
+    out_.setBackend(backend, bufferCount);
+}
+
+void MatroskaMux::setClusterDuration(uint32_t ms) {
+    // block timestamps are 16-bit offsets from the cluster's
+    clusterMs_ = ms < 1 ? 1 : (ms > 30000 ? 30000 : ms);
+}
+
+bool MatroskaMux::open() {
+    if (!out_.open()) return false;
+    clusterOpen_ = false;
+    clusterTimestamp_ = 0;
+    videoFrames_ = 0;
+    audioBytes_ = 0;
+    writeHeaders();
+    return true;
+}
+
+bool MatroskaMux::close() {
+    if (!out_.isOpen()) return true;
+    // nothing to finalize: the last cluster ends with the file
+    if (out_.close()) return true;
+    std::cerr << "MatroskaMux: writing " << filename_ << " failed" << std::endl;
+    return false;
+}
+
+void MatroskaMux::writeHeaders() {
+    std::vector<uint8_t> h;
+    h.reserve(1024);
+
+    std::vector<uint8_t> ebml;
+    put_uint(ebml, kEBMLVersion, 1);
+    put_uint(ebml, kEBMLReadVersion, 1);
+    put_uint(ebml, kEBMLMaxIDLength, 4);
+    put_uint(ebml, kEBMLMaxSizeLength, 8);
+    put_string(ebml, kDocType, "matroska");
+    put_uint(ebml, kDocTypeVersion, 4);
+    put_uint(ebml, kDocTypeReadVersion, 2);
+    put_master(h, kEBML, ebml);
+
+    // Segment of unknown size: its end is the end of the file
+    put_id(h, kSegment);
+    uint8_t unknown[8];
+    for (int i = 0; i < 8; ++i) unknown[i] = (uint8_t)(kUnknownSize >> (8 * (7 - i)));
+    h.insert(h.end(), unknown, unknown + 8);
+
+    // Info without Duration, which is only known at the end
+    std::vector<uint8_t> info;
+    put_uint(info, kTimestampScale, 1000000); // ms
+    put_string(info, kMuxingApp, kAppName);
+    put_string(info, kWritingApp, kAppName);
+    put_master(h, kInfo, info);
+
+    std::vector<uint8_t> tracks;
+    std::vector<uint8_t> track;
+    put_uint(track, kTrackNumber, VideoTrack);
+    put_uint(track, kTrackUID, VideoTrack);
+    put_uint(track, kTrackType, 1); // video
+    put_uint(track, kFlagLacing, 0);
+    if (memcmp(videoFourCC_, "MJPG", 4) == 0) {
+        put_string(track, kCodecID, "V_MJPEG");
+    } else {
+        // other codecs the way AVI stores them
+        put_string(track, kCodecID, "V_MS/VFW/FOURCC");
+        uint8_t bi[40]; memset(bi, 0, sizeof(bi));
+        store32(bi + 0, 40);                 // biSize
+        store32(bi + 4, width_);
+        store32(bi + 8, height_);
+        store16(bi + 12, 1);                 // biPlanes
+        store16(bi + 14, 24);                // biBitCount
+        memcpy(bi + 16, videoFourCC_, 4);    // biCompression
+        put_element(track, kCodecPrivate, bi, sizeof(bi));
+    }
+    put_uint(track, kDefaultDuration, 1000000000ull / fps_); // ns per frame
+    std::vector<uint8_t> video;
+    put_uint(video, kPixelWidth, width_);
+    put_uint(video, kPixelHeight, height_);
+    put_master(track, kVideo, video);
+    put_master(tracks, kTrackEntry, track);
+
+    if (sampleRate_ > 0 && channels_ > 0 && blockAlign_ > 0) {
+        track.clear();
+        put_uint(track, kTrackNumber, AudioTrack);
+        put_uint(track, kTrackUID, AudioTrack);
+        put_uint(track, kTrackType, 2); // audio
+        put_uint(track, kFlagLacing, 0);
+        put_string(track, kCodecID, "A_PCM/INT/LIT");
+        std::vector<uint8_t> audio;
+        put_float(audio, kSamplingFrequency, (double)sampleRate_);
+        put_uint(audio, kChannels, channels_);
+        put_uint(audio, kBitDepth, bitsPerSample_);
+        put_master(track, kAudio, audio);
+        put_master(tracks, kTrackEntry, track);
+    }
+    put_master(h, kTracks, tracks);
+
+    out_.write(h.data(), h.size());
+}
+
+bool MatroskaMux::writeBlock(int track, uint64_t timestampMs, const uint8_t* data, size_t size) {
+    // A new cluster once this one has run its duration (every block is a key frame), or
+    // when the block would not fit the 16-bit relative timestamp
+    int64_t relative = (int64_t)timestampMs - (int64_t)clusterTimestamp_;
+    if (!clusterOpen_ || relative >= (int64_t)clusterMs_ || relative < -32768) {
+        std::vector<uint8_t> c;
+        put_id(c, kCluster);
+        for (int i = 0; i < 8; ++i) c.push_back((uint8_t)(kUnknownSize >> (8 * (7 - i))));
+        put_uint(c, kTimestamp, timestampMs);
+        out_.write(c.data(), c.size());
+        clusterOpen_ = true;
+        clusterTimestamp_ = timestampMs;
+        relative = 0;
+    }
+
+    // SimpleBlock: track number, int16 timestamp offset, flags, then the frame as it is
+    uint8_t b[16];
+    size_t n = 0;
+    b[n++] = (uint8_t)kSimpleBlock;
+    n += store_vint(b + n, size + 4);
+    n += store_vint(b + n, (uint64_t)track);
+    uint16_t offset = (uint16_t)(int16_t)relative;
+    b[n++] = (uint8_t)(offset >> 8);
+    b[n++] = (uint8_t)(offset & 0xFF);
+    b[n++] = 0x80; // key frame
+    if (!out_.write(b, n)) return false;
+    return size == 0 || out_.write(data, size);
+}
+
+bool MatroskaMux::writeVideoFrame(const uint8_t* frameData, size_t frameSize) {
+    if (!out_.isOpen()) return false;
+    uint64_t timestampMs = videoFrames_ * 1000 / fps_;
+    ++videoFrames_;
+    // an empty frame repeats the one before: leave it on screen
+    if (frameSize == 0) return true;
+    return writeBlock(VideoTrack, timestampMs, frameData, frameSize);
+}
+
+bool MatroskaMux::writeAudioSamples(const uint8_t* audioData, size_t audioSize) {
+    if (!out_.isOpen() || sampleRate_ == 0 || blockAlign_ == 0) return false;
+    uint64_t timestampMs = audioBytes_ * 1000 / ((uint64_t)sampleRate_ * blockAlign_);
+    audioBytes_ += audioSize;
+    return writeBlock(AudioTrack, timestampMs, audioData, audioSize);
+}
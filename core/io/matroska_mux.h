@@ -0,0 +1,67 @@
+#ifndef MATROSKA_MUX_H
+#define MATROSKA_MUX_H
+
+#include <cstdint>
+#include <string>
+
+#include "muxer.h"
+#include "writer.h"
+
+// Matroska writer for live recording: the file is written strictly front to back and never
+// patched or finalized. The EBML header, Info and Tracks come first, in a Segment of
+// unknown size. Media follows in Clusters, also of unknown size: every setClusterDuration()
+// a new one starts with its timestamp, and each video frame or audio chunk becomes one
+// SimpleBlock the moment it arrives, so nothing is held back in memory. There is no Cues
+// index; players find the clusters by reading on, a file cut off anywhere plays up to its
+// last complete block, and the output can be a pipe.
+//
+// Video is V_MJPEG for MJPG frames, otherwise V_MS/VFW/FOURCC with a BITMAPINFOHEADER;
+// audio is A_PCM/INT/LIT. Timestamps are in ms: video frame n at n / fps, audio at the
+// samples written before it. Empty video frames (repeats) are not written; the frame
+// before stays on screen until the next block.
+class MatroskaMux : public Muxer {
+public:
+    MatroskaMux(const std::string& filename);
+    ~MatroskaMux() override;
+
+    bool open() override;
+    bool close() override;
+    bool writeVideoFrame(const uint8_t* frameData, size_t frameSize) override;
+    bool writeAudioSamples(const uint8_t* audioData, size_t audioSize) override;
+    void setVideoParameters(uint32_t width, uint32_t height, uint32_t fps, const char* fourcc = "MJPG") override;
+    void setAudioParameters(uint32_t sampleRate, uint32_t channels, uint16_t blockAlign, uint16_t bitsPerSample) override;
+
+    // Staging buffer size, per buffer with the I/O thread; call before open()
+    void setWriteBufferSize(size_t bytes);
+    // See AVIMux::setWriterBackend(); call before open()
+    void setWriterBackend(WriterBackend backend, int bufferCount = 3) override;
+    WriterStats getWriterStats() const override { return out_.getStats(); }
+
+    // Time after which the next block starts a new cluster (default 1000 ms, at most 30 s)
+    void setClusterDuration(uint32_t ms);
+
+private:
+    enum { VideoTrack = 1, AudioTrack = 2 };
+
+    void writeHeaders();
+    bool writeBlock(int track, uint64_t timestampMs, const uint8_t* data, size_t size);
+
+    std::string filename_;
+    Writer out_;
+    uint32_t width_;
+    uint32_t height_;
+    uint32_t fps_;
+    char videoFourCC_[4];
+    uint32_t sampleRate_;
+    uint16_t channels_;
+    uint16_t blockAlign_;
+    uint16_t bitsPerSample_;
+    uint32_t clusterMs_;
+
+    bool clusterOpen_;
+    uint64_t clusterTimestamp_; // ms
+    uint64_t videoFrames_;      // repeats included
+    uint64_t audioBytes_;
+};
+
+#endif // MATROSKA_MUX_H
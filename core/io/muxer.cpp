@@ -0,0 +1,8 @@
+#include "muxer.h"
+#include "avi_mux.h"
+#include "matroska_mux.h"
+
+Muxer* createMuxer(ContainerFormat format, const std::string& filename) {
+    if (format == ContainerFormat::Matroska) return new MatroskaMux(filename);
+    return new AVIMux(filename);
+}
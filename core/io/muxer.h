@@ -0,0 +1,57 @@
+#ifndef MUXER_H
+#define MUXER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+#include "writer.h"
+
+// Container formats a recording can be written in
+enum class ContainerFormat {
+    Avi,     // OpenDML AVI (AVIMux): indexed and seekable; headers are patched while
+             // recording and at close, so it needs a seekable file
+    Matroska // Matroska (MatroskaMux) in self-contained clusters, written strictly front
+             // to back: no index, playable at any truncation point, works on pipes
+};
+
+// Conventional file extension, without the dot
+inline const char* containerExtension(ContainerFormat format) {
+    return format == ContainerFormat::Matroska ? "mkv" : "avi";
+}
+
+// Output stage of the pipeline: one video stream of frames at a fixed rate (an empty frame
+// repeats the one before) and optionally one PCM audio stream, fed in interleaved order by
+// AVInterleaver. Implementations do their I/O through a Writer.
+class Muxer {
+public:
+    virtual ~Muxer() {}
+
+    virtual bool open() = 0;
+    // Flush and close; false if any write failed
+    virtual bool close() = 0;
+    virtual bool writeVideoFrame(const uint8_t* frameData, size_t frameSize) = 0;
+    virtual bool writeAudioSamples(const uint8_t* audioData, size_t audioSize) = 0;
+
+    // fourcc: the video codec, e.g. videoCodecFourCC(). Stream parameters go into the
+    // headers open() writes, so set them before it.
+    virtual void setVideoParameters(uint32_t width, uint32_t height, uint32_t fps, const char* fourcc) = 0;
+    virtual void setAudioParameters(uint32_t sampleRate, uint32_t channels, uint16_t blockAlign, uint16_t bitsPerSample) = 0;
+
+    // Disk backend (see Writer); call before open()
+    virtual void setWriterBackend(WriterBackend backend, int bufferCount) = 0;
+    // Callable from any thread while open
+    virtual WriterStats getWriterStats() const = 0;
+
+    // How often a format that patches its headers brings them up to date while recording;
+    // formats that never patch ignore it
+    virtual void setCheckpointInterval(uint32_t ms) { (void)ms; }
+    // Size at which a format split into segments starts the next one; call before open().
+    // Formats without segments ignore it.
+    virtual void setSegmentSize(uint64_t bytes) { (void)bytes; }
+};
+
+// New, unopened muxer for format writing to filename
+Muxer* createMuxer(ContainerFormat format, const std::string& filename);
+
+#endif // MUXER_H
@@ -3,15 +3,98 @@
 
 #include <vector>
 #include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+
+// std::allocator that default-initializes instead of value-initializing, so resize() on a
+// byte vector leaves the new bytes as they are. Growing a payload buffer to a worst-case
+// size then costs nothing until the pages are actually written.
+template <typename T>
+struct DefaultInitAllocator : std::allocator<T> {
+    template <typename U> struct rebind { using other = DefaultInitAllocator<U>; };
+
+    DefaultInitAllocator() noexcept = default;
+    template <typename U> DefaultInitAllocator(const DefaultInitAllocator<U>&) noexcept {}
+
+    template <typename U> void construct(U* p) { ::new (static_cast<void*>(p)) U; }
+    template <typename U, typename... Args> void construct(U* p, Args&&... args) {
+        ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+    }
+};
+
+// Encoded payload buffer passed from producers through the rings to the muxer
+using PacketBuffer = std::vector<uint8_t, DefaultInitAllocator<uint8_t>>;
 
 struct VideoPacket {
-    std::vector<uint8_t> data;
-    uint64_t pts_ms; // presentation timestamp in milliseconds
+    // data is the encoder's output buffer and may be longer than the frame: TurboJPEG
+    // compresses straight into a worst-case sized buffer, so length is the payload size
+    PacketBuffer data;
+    size_t length;
+    uint64_t pts_ms;     // presentation timestamp in milliseconds
+    uint64_t capture_us; // capture time (steady clock us), for end-to-end latency
 };
 
 struct AudioPacket {
-    std::vector<uint8_t> data;
+    PacketBuffer data;
     uint64_t pts_ms; // timestamp when captured (ms since epoch)
 };
 
+struct PacketBufferPoolStats {
+    uint64_t reused;    // acquire() served from the pool
+    uint64_t allocated; // acquire() that had to grow or create a buffer
+    uint64_t discarded; // release() with the pool already full
+};
+
+// Recycles packet payload vectors. Producers (encoder workers, audio capture) acquire a
+// buffer, fill it and move it through the rings; the writer releases it once muxed.
+// Buffers keep their capacity, so once warmed up the hot path does no heap allocation.
+class PacketBufferPool {
+public:
+    explicit PacketBufferPool(size_t maxPooled = 64) : maxPooled(maxPooled), stats() {
+        freeList.reserve(maxPooled);
+    }
+
+    // Returns a buffer with capacity of at least reserveBytes when possible. Its size is left
+    // as it was released (the contents are stale): producers that write into the whole
+    // buffer then skip zero-filling it again every time, the others assign() or clear().
+    PacketBuffer acquire(size_t reserveBytes = 0) {
+        PacketBuffer buf;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!freeList.empty()) {
+                buf = std::move(freeList.back());
+                freeList.pop_back();
+            }
+            if (buf.capacity() == 0 || buf.capacity() < reserveBytes) stats.allocated++;
+            else stats.reused++;
+        }
+        if (buf.capacity() < reserveBytes) buf.reserve(reserveBytes);
+        return buf;
+    }
+
+    void release(PacketBuffer&& buf) {
+        if (buf.capacity() == 0) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (freeList.size() < maxPooled) {
+            freeList.push_back(std::move(buf));
+        } else {
+            stats.discarded++;
+        }
+    }
+
+    PacketBufferPoolStats getStats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+
+private:
+    mutable std::mutex mutex;
+    std::vector<PacketBuffer> freeList;
+    size_t maxPooled;
+    PacketBufferPoolStats stats;
+};
+
 #endif // PACKETS_H
@@ -3,6 +3,17 @@
 #include <vector>
 #include <mutex>
 #include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 class DiskWriter {
 public:
@@ -59,54 +70,411 @@ void DiskWriter::flushBuffer() {
     }
 }
 
+static const size_t pageSize = 4096;
+// Mmap window; the file grows by this much at a time
+static const size_t mapWindowSize = 64 * 1024 * 1024;
+
+// 64-bit seek (long is 32 bits on Windows)
+static bool seekTo(FILE* f, uint64_t offset) {
+#ifdef _WIN32
+    return _fseeki64(f, (long long)offset, SEEK_SET) == 0;
+#else
+    return fseeko(f, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+static uint8_t* alignedAlloc(size_t size) {
+#ifdef _WIN32
+    return (uint8_t*)_aligned_malloc(size, pageSize);
+#else
+    void* p = nullptr;
+    return posix_memalign(&p, pageSize, size) == 0 ? (uint8_t*)p : nullptr;
+#endif
+}
+
+static void alignedFree(uint8_t* p) {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
 Writer::Writer(const std::string& filename)
-    : filename(filename), fileHandle(nullptr), bufferSize(8 * 1024 * 1024), buffer(nullptr), bufferPos(0) {
-    buffer = (uint8_t*)malloc(bufferSize);
+    : filename(filename), fileHandle(nullptr), backend(WriterBackend::Stdio), activeBackend(WriterBackend::Stdio),
+      bufferCount(3), bufferSize(8 * 1024 * 1024), bufferSizeSet(false), buffer(nullptr), capacity(0), current(0),
+      bufferPos(0), flushedBytes(0), failed(false), directFd(-1), busy(false), stopping(false), prefixQueued(false),
+      fileSize(0), bytesWritten(0), stalls(0), stallUs(0) {
 }
 
 Writer::~Writer() {
     close();
-    if (buffer) free(buffer);
+}
+
+void Writer::setBufferSize(size_t size) {
+    if (fileHandle || size == 0) return;
+    bufferSize = (size + pageSize - 1) / pageSize * pageSize;
+    bufferSizeSet = true;
+}
+
+void Writer::setBackend(WriterBackend backend, int bufferCount) {
+    if (fileHandle) return;
+    this->backend = backend;
+    this->bufferCount = std::max(bufferCount, 2);
+}
+
+bool Writer::allocateBuffers() {
+    int count = activeBackend == WriterBackend::Stdio ? 1 : bufferCount;
+    capacity = bufferSizeSet || activeBackend == WriterBackend::Stdio ? bufferSize : 4 * 1024 * 1024;
+    for (int i = 0; i < count; ++i) {
+        uint8_t* p = alignedAlloc(capacity);
+        if (!p) {
+            freeBuffers();
+            return false;
+        }
+        buffers.push_back(p);
+    }
+    current = 0;
+    buffer = buffers[0];
+    freeList.clear();
+    for (int i = 1; i < count; ++i) freeList.push_back(i);
+    return true;
+}
+
+void Writer::freeBuffers() {
+    for (uint8_t* p : buffers) alignedFree(p);
+    buffers.clear();
+    buffer = nullptr;
+    capacity = 0;
 }
 
 bool Writer::open() {
-    fileHandle = fopen(filename.c_str(), "wb");
-    return fileHandle != nullptr;
+    if (fileHandle) return false;
+    activeBackend = backend;
+#ifdef _WIN32
+    if (activeBackend == WriterBackend::Direct || activeBackend == WriterBackend::Mmap) activeBackend = WriterBackend::Threaded;
+#elif !defined(O_DIRECT)
+    if (activeBackend == WriterBackend::Direct) activeBackend = WriterBackend::Threaded;
+#endif
+    // mapping a file for writing needs read access too
+    fileHandle = fopen(filename.c_str(), activeBackend == WriterBackend::Mmap ? "w+b" : "wb");
+    if (!fileHandle) return false;
+    // our buffer is the only one
+    setvbuf(fileHandle, nullptr, _IONBF, 0);
+    bufferPos = 0;
+    flushedBytes = 0;
+    failed = false;
+    bytesWritten = 0;
+    stalls = 0;
+    stallUs = 0;
+
+#ifndef _WIN32
+    if (activeBackend == WriterBackend::Mmap) {
+        fileSize = 0;
+        if (mapWindow(0)) return true;
+        activeBackend = WriterBackend::Threaded;
+        failed = false;
+    }
+#ifdef O_DIRECT
+    if (activeBackend == WriterBackend::Direct) {
+        // a second descriptor for the aligned buffer writes; filesystems without O_DIRECT
+        // (tmpfs) refuse it
+        directFd = ::open(filename.c_str(), O_WRONLY | O_DIRECT);
+        if (directFd < 0) activeBackend = WriterBackend::Threaded;
+    }
+#endif
+#endif
+
+    if (!allocateBuffers()) {
+        close();
+        return false;
+    }
+    if (activeBackend != WriterBackend::Stdio) {
+        jobs.clear();
+        busy = false;
+        stopping = false;
+        prefixQueued = false;
+        ioThread = std::thread(&Writer::ioLoop, this);
+    }
+    return true;
 }
 
-void Writer::close() {
-    if (!fileHandle) return;
-    if (bufferPos > 0) fwrite(buffer, 1, bufferPos, fileHandle);
-    fclose(fileHandle);
-    fileHandle = nullptr;
+bool Writer::close() {
+    if (!fileHandle) return !failed;
+    switch (activeBackend) {
+    case WriterBackend::Stdio:
+        flushStdio();
+        break;
+    case WriterBackend::Mmap:
+#ifndef _WIN32
+        unmapWindow();
+        // drop the unused end of the last window
+        if (ftruncate(fileno(fileHandle), (off_t)flushedBytes) != 0) failed = true;
+#endif
+        break;
+    default:
+        if (ioThread.joinable()) {
+            if (bufferPos > 0) enqueue({current, flushedBytes, bufferPos, false, {}});
+            {
+                std::lock_guard<std::mutex> lock(ioMutex);
+                stopping = true;
+            }
+            jobReady.notify_all();
+            ioThread.join();
+        }
+        break;
+    }
+#ifndef _WIN32
+    if (directFd >= 0) ::close(directFd);
+#endif
+    directFd = -1;
+    flushedBytes += bufferPos;
     bufferPos = 0;
+    if (fclose(fileHandle) != 0) failed = true;
+    fileHandle = nullptr;
+    freeBuffers();
+    return !failed;
+}
+
+bool Writer::flushStdio() {
+    if (bufferPos > 0) {
+        uint64_t t0 = telemetry_now_us();
+        if (fwrite(buffer, 1, bufferPos, fileHandle) != bufferPos) failed = true;
+        writeUs.record(telemetry_now_us() - t0);
+        bytesWritten += bufferPos;
+        flushedBytes += bufferPos;
+        bufferPos = 0;
+    }
+    return !failed;
 }
 
-bool Writer::writeFrame(const uint8_t* frameData, size_t size) {
+bool Writer::flush(bool wait) {
     if (!fileHandle) return false;
-    if (size > bufferSize) {
-        // write directly if single frame larger than buffer
-        if (bufferPos > 0) {
-            fwrite(buffer, 1, bufferPos, fileHandle);
-            bufferPos = 0;
+    switch (activeBackend) {
+    case WriterBackend::Stdio:
+        return flushStdio();
+    case WriterBackend::Mmap:
+        // the mapping is the page cache already
+        return !failed;
+    default:
+        // the buffer stays current; its first bufferPos bytes are written again with the
+        // rest of it, keeping full-buffer writes aligned
+        if (bufferPos > 0) enqueue({current, flushedBytes, bufferPos, false, {}});
+        if (wait) {
+            waitIdle();
+            prefixQueued = false;
+        } else {
+            prefixQueued = bufferPos > 0;
         }
-        fwrite(frameData, 1, size, fileHandle);
-        return true;
+        return !failed;
     }
+}
 
-    if (bufferPos + size > bufferSize) {
-        fwrite(buffer, 1, bufferPos, fileHandle);
-        bufferPos = 0;
+bool Writer::write(const void* data, size_t size) {
+    if (!fileHandle) return false;
+    if (activeBackend == WriterBackend::Stdio) {
+        if (bufferPos + size > capacity) {
+            flushStdio();
+            if (size > capacity) {
+                // write directly if larger than the whole buffer
+                uint64_t t0 = telemetry_now_us();
+                if (fwrite(data, 1, size, fileHandle) != size) failed = true;
+                writeUs.record(telemetry_now_us() - t0);
+                bytesWritten += size;
+                flushedBytes += size;
+                return !failed;
+            }
+        }
+        memcpy(buffer + bufferPos, data, size);
+        bufferPos += size;
+        return !failed;
+    }
+
+    // spread over as many buffers as it takes, so every full one is aligned
+    const uint8_t* bytes = (const uint8_t*)data;
+    while (size > 0) {
+        if (bufferPos == capacity && !nextBuffer()) return false;
+        size_t n = std::min(size, capacity - bufferPos);
+        memcpy(buffer + bufferPos, bytes, n);
+        bufferPos += n;
+        bytes += n;
+        size -= n;
+    }
+    return !failed;
+}
+
+bool Writer::nextBuffer() {
+    if (activeBackend == WriterBackend::Mmap) {
+        unmapWindow();
+        return mapWindow(flushedBytes);
     }
+    enqueue({current, flushedBytes, bufferPos, true, {}});
+    flushedBytes += bufferPos;
+    bufferPos = 0;
+    prefixQueued = false;
 
-    memcpy(buffer + bufferPos, frameData, size);
-    bufferPos += size;
+    std::unique_lock<std::mutex> lock(ioMutex);
+    if (freeList.empty()) {
+        // every buffer is queued: the disk is behind by all of them
+        uint64_t t0 = telemetry_now_us();
+        jobDone.wait(lock, [this] { return !freeList.empty(); });
+        ++stalls;
+        stallUs += telemetry_now_us() - t0;
+    }
+    current = freeList.front();
+    freeList.pop_front();
+    buffer = buffers[current];
     return true;
 }
 
-void Writer::setBufferSize(size_t size) {
-    if (buffer) free(buffer);
-    buffer = (uint8_t*)malloc(size);
-    bufferSize = size;
+bool Writer::patch(uint64_t offset, const void* data, size_t size) {
+    if (!fileHandle || offset + size > getPosition()) return false;
+    const uint8_t* bytes = (const uint8_t*)data;
+    // the part that is still in the current buffer
+    if (offset + size > flushedBytes) {
+        size_t skip = offset < flushedBytes ? (size_t)(flushedBytes - offset) : 0;
+        // the I/O thread may still be reading the start of the buffer for flush(false)
+        if (prefixQueued) {
+            waitIdle();
+            prefixQueued = false;
+        }
+        memcpy(buffer + (offset + skip - flushedBytes), bytes + skip, size - skip);
+        size = skip;
+    }
+    if (size == 0) return !failed;
+    switch (activeBackend) {
+    case WriterBackend::Stdio:
+        // the part already in the file; the file position stays at flushedBytes
+        if (!seekTo(fileHandle, offset) || fwrite(bytes, 1, size, fileHandle) != size) failed = true;
+        if (!seekTo(fileHandle, flushedBytes)) failed = true;
+        break;
+    case WriterBackend::Mmap:
+        // earlier windows are unmapped; pwrite goes to the same page cache
+        if (!writeAt(offset, bytes, size, false)) failed = true;
+        break;
+    default:
+        // behind the writes of the bytes it replaces
+        enqueue({-1, offset, size, false, std::vector<uint8_t>(bytes, bytes + size)});
+        break;
+    }
+    return !failed;
+}
+
+void Writer::enqueue(Job job) {
+    {
+        std::lock_guard<std::mutex> lock(ioMutex);
+        jobs.push_back(std::move(job));
+    }
+    jobReady.notify_one();
+}
+
+void Writer::waitIdle() {
+    std::unique_lock<std::mutex> lock(ioMutex);
+    jobDone.wait(lock, [this] { return jobs.empty() && !busy; });
+}
+
+void Writer::ioLoop() {
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(ioMutex);
+            jobReady.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (jobs.empty()) return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+            busy = true;
+        }
+        const void* src = job.buffer >= 0 ? (const void*)buffers[job.buffer] : (const void*)job.data.data();
+        uint64_t t0 = telemetry_now_us();
+        if (!writeAt(job.offset, src, job.size, job.full)) failed = true;
+        writeUs.record(telemetry_now_us() - t0);
+        {
+            std::lock_guard<std::mutex> lock(ioMutex);
+            busy = false;
+            if (job.full) freeList.push_back(job.buffer);
+        }
+        jobDone.notify_all();
+    }
+}
+
+bool Writer::writeAt(uint64_t offset, const void* data, size_t size, bool full) {
+    bytesWritten += size;
+#ifdef _WIN32
+    (void)full;
+    // only the I/O thread touches the file once it runs
+    return seekTo(fileHandle, offset) && fwrite(data, 1, size, fileHandle) == size;
+#else
+    int fd = full && directFd >= 0 ? directFd : fileno(fileHandle);
+    const uint8_t* p = (const uint8_t*)data;
+    while (size > 0) {
+        ssize_t n = pwrite(fd, p, size, (off_t)offset);
+        if (n < 0 && errno == ESPIPE) {
+            // a pipe: jobs run in file order, so without patches this is the next offset
+            n = ::write(fd, p, size);
+        }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += n;
+        offset += (uint64_t)n;
+        size -= (size_t)n;
+    }
+    return true;
+#endif
+}
+
+bool Writer::mapWindow(uint64_t offset) {
+#ifdef _WIN32
+    (void)offset;
+    return false;
+#else
+    uint64_t t0 = telemetry_now_us();
+    int fd = fileno(fileHandle);
+    if (offset + mapWindowSize > fileSize) {
+        // reserve the blocks, so a full disk fails here instead of faulting in memcpy
+#ifdef __linux__
+        if (posix_fallocate(fd, (off_t)offset, (off_t)mapWindowSize) != 0) {
+#else
+        if (ftruncate(fd, (off_t)(offset + mapWindowSize)) != 0) {
+#endif
+            failed = true;
+            return false;
+        }
+        fileSize = offset + mapWindowSize;
+    }
+    void* p = mmap(nullptr, mapWindowSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, (off_t)offset);
+    if (p == MAP_FAILED) {
+        failed = true;
+        return false;
+    }
+    buffer = (uint8_t*)p;
+    capacity = mapWindowSize;
+    flushedBytes = offset;
+    bufferPos = 0;
+    writeUs.record(telemetry_now_us() - t0);
+    return true;
+#endif
+}
+
+void Writer::unmapWindow() {
+#ifndef _WIN32
+    if (!buffer) return;
+    // the kernel writes the dirty pages back on its own schedule
+    munmap(buffer, capacity);
+    bytesWritten += bufferPos;
+    flushedBytes += bufferPos;
     bufferPos = 0;
-}
\ No newline at end of file
+    buffer = nullptr;
+    capacity = 0;
+#endif
+}
+
+WriterStats Writer::getStats() const {
+    WriterStats s;
+    s.bytesWritten = bytesWritten;
+    s.stalls = stalls;
+    s.stallUs = stallUs;
+    s.writeUs = writeUs.snapshot();
+    return s;
+}
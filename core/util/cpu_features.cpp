@@ -0,0 +1,65 @@
+#include "cpu_features.h"
+#include <cstdlib>
+#include <cstring>
+
+#if defined(RECORDER_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+static SimdLevel probe() {
+#if defined(RECORDER_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuid(info, 1);
+    bool ssse3 = (info[2] & (1 << 9)) != 0;
+    bool sse41 = (info[2] & (1 << 19)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    bool avx2 = false;
+    if (maxLeaf >= 7 && osxsave && avx) {
+        // the OS must save the YMM registers on context switch
+        bool ymmEnabled = (_xgetbv(0) & 6) == 6;
+        __cpuidex(info, 7, 0);
+        avx2 = ymmEnabled && (info[1] & (1 << 5)) != 0;
+    }
+    if (avx2 && sse41) return SimdLevel::AVX2;
+    if (sse41 && ssse3) return SimdLevel::SSE41;
+    return SimdLevel::Scalar;
+#elif defined(RECORDER_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+    if (__builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("ssse3")) return SimdLevel::SSE41;
+    return SimdLevel::Scalar;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+SimdLevel detectSimdLevel() {
+    static const SimdLevel detected = probe();
+    return detected;
+}
+
+SimdLevel simdLevel() {
+    static const SimdLevel level = []() {
+        SimdLevel best = detectSimdLevel();
+        const char* env = std::getenv("RECORDER_SIMD");
+        if (!env) return best;
+        SimdLevel wanted = best;
+        if (std::strcmp(env, "scalar") == 0) wanted = SimdLevel::Scalar;
+        else if (std::strcmp(env, "sse41") == 0) wanted = SimdLevel::SSE41;
+        else if (std::strcmp(env, "avx2") == 0) wanted = SimdLevel::AVX2;
+        return (int)wanted < (int)best ? wanted : best;
+    }();
+    return level;
+}
+
+const char* simdLevelName(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::AVX2: return "avx2";
+    case SimdLevel::SSE41: return "sse41";
+    default: return "scalar";
+    }
+}
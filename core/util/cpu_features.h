@@ -0,0 +1,36 @@
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+// Runtime SIMD dispatch support. Kernels for several instruction sets live side by side in
+// one translation unit: GCC/Clang compile each with a per-function target attribute (no
+// global -mavx2, so the binary still runs on any x86-64), MSVC accepts the intrinsics
+// anywhere. Callers pick the kernel for simdLevel() once and fall back to scalar code.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define RECORDER_X86 1
+#endif
+
+#if defined(RECORDER_X86) && (defined(__GNUC__) || defined(__clang__))
+#define RECORDER_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define RECORDER_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define RECORDER_TARGET_SSE41
+#define RECORDER_TARGET_AVX2
+#endif
+
+enum class SimdLevel {
+    Scalar,
+    SSE41, // SSE4.1 (implies SSSE3)
+    AVX2
+};
+
+// Best level this CPU and OS support (detected once)
+SimdLevel detectSimdLevel();
+
+// Level kernels should use: detectSimdLevel(), lowered by RECORDER_SIMD=scalar|sse41|avx2
+// in the environment (for comparing kernels on one machine; it never raises the level)
+SimdLevel simdLevel();
+
+const char* simdLevelName(SimdLevel level);
+
+#endif // CPU_FEATURES_H
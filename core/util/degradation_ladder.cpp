@@ -0,0 +1,120 @@
+#include "degradation_ladder.h"
+#include <algorithm>
+#include <cstdio>
+
+std::string DegradationTransition::describe() const {
+    char buf[160];
+    snprintf(buf, sizeof(buf), "%s %zu -> %zu: %d fps, scale 1/%d, %d encoders (encode load %.0f%%, occupancy %.0f%%)",
+             toLevel > fromLevel ? "degrade" : "recover", fromLevel, toLevel,
+             step.fps, step.downscale, step.encoderThreads, utilization * 100.0, occupancy * 100.0);
+    return buf;
+}
+
+DegradationLadder::DegradationLadder(const std::vector<DegradationStep>& steps, const DegradationThresholds& thresholds)
+    : steps(steps), thresholds(thresholds), level(0), encodeMs(-1.0), overSince(0), underSince(0),
+      settleUntil(0), lastRecoverAt(0), recoverHoldMs(thresholds.recoverAfterMs), transitions(0) {
+    for (auto& s : this->steps) {
+        if (s.fps < 1) s.fps = 1;
+        if (s.downscale < 1) s.downscale = 1;
+        if (s.encoderThreads < 1) s.encoderThreads = 1;
+    }
+    if (this->steps.empty()) this->steps.push_back(DegradationStep{30, 1, 1});
+}
+
+std::vector<DegradationStep> DegradationLadder::buildDefault(int fps, int baseThreads, int maxThreads) {
+    std::vector<DegradationStep> ladder;
+    if (fps < 1) fps = 1;
+    if (baseThreads < 1) baseThreads = 1;
+
+    ladder.push_back(DegradationStep{fps, 1, baseThreads});
+    const int fpsSteps[2] = {fps * 3 / 4, fps / 2};
+    for (int f : fpsSteps) {
+        if (f < 10 || f >= ladder.back().fps) continue;
+        ladder.push_back(DegradationStep{f, 1, baseThreads});
+    }
+
+    int lowFps = ladder.back().fps;
+    ladder.push_back(DegradationStep{lowFps, 2, baseThreads});
+    if (maxThreads > baseThreads) ladder.push_back(DegradationStep{lowFps, 2, maxThreads});
+    return ladder;
+}
+
+size_t DegradationLadder::getLevel() const { return level; }
+
+const DegradationStep& DegradationLadder::current() const { return steps[level]; }
+
+const std::vector<DegradationStep>& DegradationLadder::getSteps() const { return steps; }
+
+uint64_t DegradationLadder::getTransitionCount() const { return transitions; }
+
+int DegradationLadder::maxEncoderThreads() const {
+    int n = 1;
+    for (const auto& s : steps) n = std::max(n, s.encoderThreads);
+    return n;
+}
+
+double DegradationLadder::loadAt(size_t target, double ms) const {
+    const DegradationStep& s = steps[target];
+    return (double)s.fps * ms / (1000.0 * (double)s.encoderThreads);
+}
+
+void DegradationLadder::moveTo(size_t target, double load, double occupancy, uint64_t nowMs, DegradationTransition& t) {
+    if (target > level) {
+        // undoing a recent recovery: wait longer before the next attempt
+        if (lastRecoverAt != 0 && nowMs - lastRecoverAt < 2ull * recoverHoldMs) {
+            recoverHoldMs = std::min(recoverHoldMs * 2, thresholds.maxRecoverAfterMs);
+        } else {
+            recoverHoldMs = thresholds.recoverAfterMs;
+        }
+    } else {
+        lastRecoverAt = nowMs;
+    }
+
+    t.fromLevel = level;
+    t.toLevel = target;
+    t.step = steps[target];
+    t.utilization = load;
+    t.occupancy = occupancy;
+    t.atMs = nowMs;
+
+    level = target;
+    overSince = 0;
+    underSince = 0;
+    settleUntil = nowMs + thresholds.settleMs;
+    transitions++;
+}
+
+bool DegradationLadder::update(const DegradationSample& sample, uint64_t nowMs, DegradationTransition& transition) {
+    if (sample.encodeMsPerFrame >= 0.0) {
+        encodeMs = (encodeMs < 0.0) ? sample.encodeMsPerFrame : encodeMs * 0.7 + sample.encodeMsPerFrame * 0.3;
+    }
+    if (nowMs < settleUntil) return false;
+
+    double occupancy = std::max(sample.backlog, sample.writerFill);
+    double load = (encodeMs >= 0.0) ? loadAt(level, encodeMs) : 0.0;
+
+    bool overloaded = load > thresholds.overloadUtilization || occupancy > thresholds.overloadOccupancy;
+    if (overloaded && level + 1 < steps.size()) {
+        if (overSince == 0) overSince = nowMs;
+        underSince = 0;
+        if (nowMs - overSince >= thresholds.degradeAfterMs) {
+            moveTo(level + 1, load, occupancy, nowMs, transition);
+            return true;
+        }
+        return false;
+    }
+    overSince = 0;
+
+    bool headroom = level > 0 && occupancy < thresholds.recoverOccupancy &&
+                    encodeMs >= 0.0 && loadAt(level - 1, encodeMs) < thresholds.recoverUtilization;
+    if (!headroom) {
+        underSince = 0;
+        return false;
+    }
+    if (underSince == 0) underSince = nowMs;
+    if (nowMs - underSince >= recoverHoldMs) {
+        moveTo(level - 1, load, occupancy, nowMs, transition);
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,95 @@
+#ifndef DEGRADATION_LADDER_H
+#define DEGRADATION_LADDER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// One rung of the ladder: what the pipeline runs at on that level
+struct DegradationStep {
+    int fps;
+    int downscale;      // frames are captured at 1/downscale of the capture size and
+                        // resampled back, so the recorded size never changes
+    int encoderThreads; // active encoder workers
+};
+
+struct DegradationThresholds {
+    double overloadUtilization = 0.90; // encode busy fraction (all workers) that counts as overload
+    double recoverUtilization = 0.65;  // predicted busy fraction on the better rung that allows recovery
+    double overloadOccupancy = 0.75;   // frame backlog / writer ring fill that counts as overload
+    double recoverOccupancy = 0.25;
+    uint32_t degradeAfterMs = 800;     // overload must last this long before stepping down
+    uint32_t recoverAfterMs = 5000;    // headroom must last this long before stepping up
+    uint32_t settleMs = 1500;          // measurements right after a transition are ignored
+    uint32_t maxRecoverAfterMs = 60000;
+};
+
+// Measurements for one controller tick
+struct DegradationSample {
+    double encodeMsPerFrame; // mean encode time per frame at the current rung (< 0: unknown)
+    double backlog;          // frame pool backlog, 0..1
+    double writerFill;       // encode -> writer ring fill, 0..1
+};
+
+struct DegradationTransition {
+    size_t fromLevel;
+    size_t toLevel;
+    DegradationStep step;   // the rung now in effect
+    double utilization;     // estimated encode load when the decision was made
+    double occupancy;
+    uint64_t atMs;
+
+    // "degrade 0 -> 1: 45 fps, scale 1/1, 4 encoders (encode load 97%, occupancy 80%)"
+    std::string describe() const;
+};
+
+// Picks a rung of the ladder from measured encode time and queue occupancy.
+//
+// Encode load on a rung is fps * encode time / (1000 ms * workers). Frames are encoded at
+// the output size on every rung, so downscaled capture (which saves capture and resampling
+// work) is not credited in the prediction. The controller steps down one
+// rung once load or occupancy stay above the overload thresholds for degradeAfterMs and
+// steps back up only when the better rung is predicted to stay under the recovery
+// thresholds for recoverAfterMs. After a transition it waits settleMs for the pipeline to
+// drain before measuring again, and a recovery that has to be undone soon after doubles
+// the recovery hold (up to maxRecoverAfterMs), so an overloaded machine settles on a rung
+// instead of oscillating between two.
+class DegradationLadder {
+public:
+    explicit DegradationLadder(const std::vector<DegradationStep>& steps,
+                               const DegradationThresholds& thresholds = DegradationThresholds());
+
+    // Default ladder: full rate, then 3/4 and 1/2 fps (not below 10), then half-size
+    // capture, then maxThreads encoder workers if that is more than baseThreads
+    static std::vector<DegradationStep> buildDefault(int fps, int baseThreads, int maxThreads);
+
+    // Feed one sample; returns true (and fills transition) when the rung changed
+    bool update(const DegradationSample& sample, uint64_t nowMs, DegradationTransition& transition);
+
+    size_t getLevel() const;
+    const DegradationStep& current() const;
+    const std::vector<DegradationStep>& getSteps() const;
+    uint64_t getTransitionCount() const;
+
+    // Highest encoder thread count on any rung (what the encoder pool must be built with)
+    int maxEncoderThreads() const;
+
+private:
+    double loadAt(size_t level, double encodeMs) const;
+    void moveTo(size_t level, double load, double occupancy, uint64_t nowMs, DegradationTransition& t);
+
+    std::vector<DegradationStep> steps;
+    DegradationThresholds thresholds;
+    size_t level;
+
+    double encodeMs;        // smoothed encode time at the current rung
+    uint64_t overSince;     // 0 = not overloaded
+    uint64_t underSince;    // 0 = no recovery headroom
+    uint64_t settleUntil;
+    uint64_t lastRecoverAt;
+    uint32_t recoverHoldMs;
+    uint64_t transitions;
+};
+
+#endif // DEGRADATION_LADDER_H
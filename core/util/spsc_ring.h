@@ -5,12 +5,19 @@
 #include <cstddef>
 #include <vector>
 #include <stdexcept>
+#include <utility>
+#include <chrono>
+#include <cstdint>
 
-template<typename T>
+#include "wait_strategy.h"
+
+// WaitStrategy decides how push_wait/pop_wait block (BlockingWait or SpinYieldWait, see
+// wait_strategy.h). Plain push/pop never block; they only notify the other side.
+template<typename T, typename WaitStrategy = BlockingWait>
 class SPSC_Ring {
 public:
     explicit SPSC_Ring(size_t capacity)
-        : buffer(capacity), head(0), tail(0), mask(capacity - 1) {
+        : buffer(capacity), head(0), tail(0), mask(capacity - 1), fullEvents(0) {
         if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
             throw std::invalid_argument("Capacity must be a power of 2");
         }
@@ -21,14 +28,33 @@ public:
         size_t next_head = (current_head + 1) & mask;
 
         if (next_head == tail.load(std::memory_order_acquire)) {
+            noteFull();
             return false; // Buffer is full
         }
 
         buffer[current_head] = item;
         head.store(next_head, std::memory_order_release);
+        notEmpty.notify();
+        return true;
+    }
+
+    // Move item into the ring; item is left untouched if the ring is full so callers can retry
+    bool push(T&& item) {
+        size_t current_head = head.load(std::memory_order_relaxed);
+        size_t next_head = (current_head + 1) & mask;
+
+        if (next_head == tail.load(std::memory_order_acquire)) {
+            noteFull();
+            return false; // Buffer is full
+        }
+
+        buffer[current_head] = std::move(item);
+        head.store(next_head, std::memory_order_release);
+        notEmpty.notify();
         return true;
     }
 
+    // Moves the item out; the slot keeps a moved-from T, so heap storage travels with the item
     bool pop(T& item) {
         size_t current_tail = tail.load(std::memory_order_relaxed);
 
@@ -36,8 +62,44 @@ public:
             return false; // Buffer is empty
         }
 
-        item = buffer[current_tail];
+        item = std::move(buffer[current_tail]);
         tail.store((current_tail + 1) & mask, std::memory_order_release);
+        notFull.notify();
+        return true;
+    }
+
+    // Block until an item is available or timeout expires; returns false on timeout
+    bool wait_not_empty(std::chrono::microseconds timeout) {
+        return notEmpty.wait([this]() { return !is_empty(); }, WaitClock::now() + timeout);
+    }
+
+    // Block until there is room for an item or timeout expires; returns false on timeout
+    bool wait_not_full(std::chrono::microseconds timeout) {
+        return notFull.wait([this]() { return !is_full(); }, WaitClock::now() + timeout);
+    }
+
+    bool pop_wait(T& item, std::chrono::microseconds timeout) {
+        auto deadline = WaitClock::now() + timeout;
+        while (!pop(item)) {
+            if (!notEmpty.wait([this]() { return !is_empty(); }, deadline)) return false;
+        }
+        return true;
+    }
+
+    // On timeout item is left untouched
+    bool push_wait(T&& item, std::chrono::microseconds timeout) {
+        auto deadline = WaitClock::now() + timeout;
+        while (!push(std::move(item))) {
+            if (!notFull.wait([this]() { return !is_full(); }, deadline)) return false;
+        }
+        return true;
+    }
+
+    bool push_wait(const T& item, std::chrono::microseconds timeout) {
+        auto deadline = WaitClock::now() + timeout;
+        while (!push(item)) {
+            if (!notFull.wait([this]() { return !is_full(); }, deadline)) return false;
+        }
         return true;
     }
 
@@ -70,11 +132,24 @@ public:
         return static_cast<double>(size()) / static_cast<double>(cap);
     }
 
+    // Pushes that found the ring full so far (backpressure or drops, depending on the producer)
+    uint64_t full_events() const {
+        return fullEvents.load(std::memory_order_relaxed);
+    }
+
 private:
+    // only the producer writes the counter, so a plain load/store pair is enough
+    void noteFull() {
+        fullEvents.store(fullEvents.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
     std::vector<T> buffer;
     std::atomic<size_t> head;
     std::atomic<size_t> tail;
     const size_t mask;
+    WaitStrategy notEmpty; // consumer waits, producer notifies
+    WaitStrategy notFull;  // producer waits, consumer notifies
+    std::atomic<uint64_t> fullEvents;
 };
 
 #endif // SPSC_RING_H
\ No newline at end of file
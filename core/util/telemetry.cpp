@@ -0,0 +1,160 @@
+#include "telemetry.h"
+#include <cstdio>
+#include <limits>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static int highestBit(uint64_t v) {
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanReverse64(&idx, v);
+    return (int)idx;
+#else
+    return 63 - __builtin_clzll(v);
+#endif
+}
+
+LatencyHistogram::LatencyHistogram()
+    : total(0), sum(0), minValue(std::numeric_limits<uint64_t>::max()), maxValue(0) {
+    for (auto& c : counts) c.store(0, std::memory_order_relaxed);
+}
+
+int LatencyHistogram::bucketIndex(uint64_t value) {
+    if (value < (uint64_t)subBuckets) return (int)value;
+    int msb = highestBit(value);
+    int shift = msb - subBucketBits;
+    return (shift + 1) * subBuckets + (int)((value >> shift) & (subBuckets - 1));
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(int index) {
+    if (index < subBuckets) return (uint64_t)index;
+    int shift = index / subBuckets - 1;
+    uint64_t sub = (uint64_t)(index % subBuckets);
+    uint64_t lower = ((uint64_t)subBuckets + sub) << shift;
+    return lower + ((uint64_t)1 << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t value) {
+    counts[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(value, std::memory_order_relaxed);
+
+    uint64_t cur = minValue.load(std::memory_order_relaxed);
+    while (value < cur && !minValue.compare_exchange_weak(cur, value, std::memory_order_relaxed)) {}
+    cur = maxValue.load(std::memory_order_relaxed);
+    while (value > cur && !maxValue.compare_exchange_weak(cur, value, std::memory_order_relaxed)) {}
+}
+
+HistogramSnapshot LatencyHistogram::snapshot() const {
+    return merge(std::vector<const LatencyHistogram*>(1, this));
+}
+
+HistogramSnapshot LatencyHistogram::merge(const std::vector<const LatencyHistogram*>& parts) {
+    HistogramSnapshot s = HistogramSnapshot();
+    std::vector<uint64_t> merged(bucketCount, 0);
+    uint64_t count = 0, sum = 0;
+    uint64_t minV = std::numeric_limits<uint64_t>::max(), maxV = 0;
+
+    for (const LatencyHistogram* h : parts) {
+        if (!h) continue;
+        for (int i = 0; i < bucketCount; ++i) {
+            uint64_t c = h->counts[i].load(std::memory_order_relaxed);
+            merged[i] += c;
+            count += c;
+        }
+        sum += h->sum.load(std::memory_order_relaxed);
+        uint64_t hmin = h->minValue.load(std::memory_order_relaxed);
+        uint64_t hmax = h->maxValue.load(std::memory_order_relaxed);
+        if (hmin < minV) minV = hmin;
+        if (hmax > maxV) maxV = hmax;
+    }
+    if (count == 0) return s;
+
+    s.count = count;
+    s.min = minV;
+    s.max = maxV;
+    s.mean = static_cast<double>(sum) / static_cast<double>(count);
+
+    // percentiles from the merged buckets, clamped to the exact observed max
+    const double targets[4] = {0.50, 0.90, 0.99, 0.999};
+    uint64_t* outputs[4] = {&s.p50, &s.p90, &s.p99, &s.p999};
+    uint64_t seen = 0;
+    int t = 0;
+    for (int i = 0; i < bucketCount && t < 4; ++i) {
+        seen += merged[i];
+        while (t < 4 && seen > 0 && (double)seen >= targets[t] * (double)count) {
+            uint64_t v = bucketUpperBound(i);
+            *outputs[t] = v > maxV ? maxV : v;
+            ++t;
+        }
+    }
+    return s;
+}
+
+static void appendHistogram(std::string& out, const char* name, const HistogramSnapshot& h) {
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             "\"%s\":{\"count\":%llu,\"min\":%llu,\"mean\":%.1f,\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"p999\":%llu,\"max\":%llu}",
+             name, (unsigned long long)h.count, (unsigned long long)h.min, h.mean,
+             (unsigned long long)h.p50, (unsigned long long)h.p90, (unsigned long long)h.p99,
+             (unsigned long long)h.p999, (unsigned long long)h.max);
+    out += buf;
+}
+
+static void appendRing(std::string& out, const char* name, const RingStats& r) {
+    char buf[160];
+    snprintf(buf, sizeof(buf), "\"%s\":{\"depth\":%llu,\"capacity\":%llu,\"full_events\":%llu,\"drops\":%llu}",
+             name, (unsigned long long)r.depth, (unsigned long long)r.capacity,
+             (unsigned long long)r.fullEvents, (unsigned long long)r.drops);
+    out += buf;
+}
+
+std::string statsToJson(const PipelineStats& stats) {
+    std::string out;
+    out.reserve(2048);
+    char buf[512];
+    snprintf(buf, sizeof(buf),
+             "{\"uptime_s\":%.3f,\"frames_captured\":%llu,\"frames_dropped\":%llu,\"ticks_missed\":%llu,"
+             "\"frames_encoded\":%llu,\"frames_repeated\":%llu,\"video_chunks\":%llu,\"gap_chunks\":%llu,"
+             "\"audio_chunks\":%llu,\"late_chunks\":%llu,\"audio_packets_dropped\":%llu,",
+             stats.uptimeSec, (unsigned long long)stats.framesCaptured, (unsigned long long)stats.framesDropped,
+             (unsigned long long)stats.ticksMissed, (unsigned long long)stats.framesEncoded,
+             (unsigned long long)stats.framesRepeated, (unsigned long long)stats.videoChunks,
+             (unsigned long long)stats.gapChunks,
+             (unsigned long long)stats.audioChunks, (unsigned long long)stats.lateChunks,
+             (unsigned long long)stats.audioPacketsDropped);
+    out += buf;
+    snprintf(buf, sizeof(buf),
+             "\"degradation\":{\"level\":%u,\"transitions\":%llu,\"fps\":%d,\"downscale\":%d,\"encoder_threads\":%d},",
+             stats.degradationLevel, (unsigned long long)stats.degradationTransitions,
+             stats.fps, stats.downscale, stats.encoderThreads);
+    out += buf;
+    snprintf(buf, sizeof(buf),
+             "\"rate_control\":{\"quality\":%d,\"target_bytes_per_s\":%llu,\"achieved_bytes_per_s\":%.0f,"
+             "\"recent_bytes_per_s\":%.0f},",
+             stats.videoQuality, (unsigned long long)stats.targetBytesPerSec,
+             stats.achievedBytesPerSec, stats.recentBytesPerSec);
+    out += buf;
+    snprintf(buf, sizeof(buf), "\"disk\":{\"bytes_written\":%llu,\"stalls\":%llu,\"stall_us\":%llu},",
+             (unsigned long long)stats.diskBytesWritten, (unsigned long long)stats.diskStalls,
+             (unsigned long long)stats.diskStallUs);
+    out += buf;
+
+    out += "\"latency_us\":{";
+    appendHistogram(out, "capture", stats.captureUs); out += ",";
+    appendHistogram(out, "capture_to_encode", stats.captureToEncodeUs); out += ",";
+    appendHistogram(out, "encode", stats.encodeUs); out += ",";
+    appendHistogram(out, "mux_write", stats.muxWriteUs); out += ",";
+    appendHistogram(out, "end_to_end", stats.endToEndUs); out += ",";
+    appendHistogram(out, "disk_write", stats.diskWriteUs);
+    out += "},";
+    appendHistogram(out, "encoded_bytes", stats.encodedBytes);
+    out += ",\"rings\":{";
+    appendRing(out, "capture_to_encode", stats.captureToEncode); out += ",";
+    appendRing(out, "encode_to_writer", stats.encodeToWriter); out += ",";
+    appendRing(out, "audio", stats.audio);
+    out += "}}";
+    return out;
+}
@@ -0,0 +1,114 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Steady-clock microseconds; the time base for all pipeline latency measurements
+inline uint64_t telemetry_now_us() {
+    using namespace std::chrono;
+    return (uint64_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+struct HistogramSnapshot {
+    uint64_t count;
+    uint64_t min;
+    uint64_t max;
+    double mean;
+    uint64_t p50;
+    uint64_t p90;
+    uint64_t p99;
+    uint64_t p999;
+};
+
+// HDR-style log-linear histogram: every power of two is split into 16 linear sub-buckets,
+// so any recorded value is reported within 1/16 (6.25%) of its true value across the full
+// 64-bit range. record() is a few relaxed atomic adds, safe from any thread and lock-free;
+// hot stages with several threads keep one histogram per thread and merge on query.
+class LatencyHistogram {
+public:
+    static const int subBucketBits = 4;
+    static const int subBuckets = 1 << subBucketBits;
+    static const int bucketCount = (64 - subBucketBits + 1) * subBuckets;
+
+    LatencyHistogram();
+
+    void record(uint64_t value);
+
+    // Summaries over one or several histograms (e.g. one per encoder thread)
+    HistogramSnapshot snapshot() const;
+    static HistogramSnapshot merge(const std::vector<const LatencyHistogram*>& parts);
+
+    static int bucketIndex(uint64_t value);
+    // Highest value that lands in bucket index (what percentiles report)
+    static uint64_t bucketUpperBound(int index);
+
+private:
+    std::atomic<uint64_t> counts[bucketCount];
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> minValue;
+    std::atomic<uint64_t> maxValue;
+};
+
+struct RingStats {
+    size_t depth;        // items queued right now
+    size_t capacity;
+    uint64_t fullEvents; // pushes that found the ring full (backpressure)
+    uint64_t drops;      // items the producer discarded because of it
+};
+
+// Snapshot of the whole capture -> encode -> mux pipeline (Core::getStats())
+struct PipelineStats {
+    double uptimeSec;
+
+    uint64_t framesCaptured;
+    uint64_t framesDropped;
+    uint64_t ticksMissed;     // capture ticks skipped because capture overran the period
+    uint64_t framesEncoded;
+    uint64_t framesRepeated;  // unchanged frames written as empty chunks, not encoded
+    uint64_t videoChunks;
+    uint64_t gapChunks;       // empty video chunks filling pts gaps
+    uint64_t audioChunks;
+    uint64_t lateChunks;
+    uint64_t audioPacketsDropped;
+
+    // degradation ladder: current rung and what it runs at
+    uint32_t degradationLevel;
+    uint64_t degradationTransitions;
+    int fps;
+    int downscale;
+    int encoderThreads;
+
+    // video quality; the bitrate fields are zero unless rate control is on
+    int videoQuality;
+    uint64_t targetBytesPerSec;
+    double achievedBytesPerSec; // encoded video bytes per second since the first frame
+    double recentBytesPerSec;   // over the last second
+
+    // disk writer (see Writer); stalls are mux writes that waited for the I/O thread
+    uint64_t diskBytesWritten;
+    uint64_t diskStalls;
+    uint64_t diskStallUs;
+
+    HistogramSnapshot captureUs;          // CaptureFrame() duration
+    HistogramSnapshot captureToEncodeUs;  // frame published -> leased by an encoder
+    HistogramSnapshot encodeUs;           // encodeFrame() duration
+    HistogramSnapshot encodedBytes;       // encoded frame size
+    HistogramSnapshot muxWriteUs;         // Muxer write per chunk
+    HistogramSnapshot endToEndUs;         // capture -> video chunk written
+    HistogramSnapshot diskWriteUs;        // one OS write of a buffer or patch
+
+    RingStats captureToEncode;
+    RingStats encodeToWriter;
+    RingStats audio;
+};
+
+// One-line JSON object, suitable for appending to a JSON-lines log
+std::string statsToJson(const PipelineStats& stats);
+
+#endif // TELEMETRY_H
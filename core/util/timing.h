@@ -2,6 +2,8 @@
 #define TIMING_H
 
 #include <chrono>
+#include <cstdint>
+#include <thread>
 
 class Timer {
 public:
@@ -19,22 +21,81 @@ private:
     std::chrono::high_resolution_clock::time_point start_time;
 };
 
+// Deadline-based frame pacing. Tick n is due at epoch + n / fps, computed from the epoch
+// every time rather than by adding up periods, so there is no truncation (1000 / 60 = 16 ms
+// would give 62.5 fps) and no accumulated drift: over hours the tick count matches the
+// nominal rate. wait() sleeps until shortly before the deadline and spins (yielding) for
+// the last spinWindow, which absorbs OS sleep overshoot.
+//
+// When the caller falls behind by one or more whole periods, the overdue ticks are not
+// replayed as a burst; they are skipped and counted, and wait() returns how many.
 class FramePacer {
 public:
-    FramePacer(double target_fps) : target_time(1.0 / target_fps) {}
+    using Clock = std::chrono::steady_clock;
 
-    void wait() {
-        auto now = std::chrono::high_resolution_clock::now();
-        double elapsed_time = std::chrono::duration<double>(now - last_time).count();
-        if (elapsed_time < target_time) {
-            std::this_thread::sleep_for(std::chrono::duration<double>(target_time - elapsed_time));
+    explicit FramePacer(double target_fps, std::chrono::microseconds spinWindow = std::chrono::microseconds(1000))
+        : fps(target_fps > 0.0 ? target_fps : 1.0), spinWindow(spinWindow),
+          epoch(Clock::now()), nextTick(0), missedTicks(0) {}
+
+    // Restart the schedule: tick 0 is due now
+    void start() {
+        epoch = Clock::now();
+        nextTick = 0;
+    }
+
+    // Change the rate without a jump: the new schedule continues from the next deadline
+    void setRate(double target_fps) {
+        if (target_fps <= 0.0 || target_fps == fps) return;
+        epoch = deadline(nextTick);
+        nextTick = 0;
+        fps = target_fps;
+    }
+
+    double getRate() const { return fps; }
+
+    // Block until the next tick is due. Returns the number of ticks skipped because the
+    // caller was already a whole period or more behind (0 when on time).
+    uint64_t wait() {
+        Clock::time_point due = deadline(nextTick);
+        Clock::time_point now = Clock::now();
+
+        uint64_t missed = 0;
+        if (now >= deadline(nextTick + 1)) {
+            // late by at least one period: resume at the tick the clock is in now
+            uint64_t current = tickAt(now);
+            if (current > nextTick) {
+                missed = current - nextTick;
+                nextTick = current;
+                missedTicks += missed;
+            }
+        } else if (now < due) {
+            if (due - now > spinWindow) std::this_thread::sleep_for(due - now - spinWindow);
+            while (Clock::now() < due) std::this_thread::yield();
         }
-        last_time = std::chrono::high_resolution_clock::now();
+        ++nextTick;
+        return missed;
+    }
+
+    // Ticks consumed so far (waited for or skipped) and how many of them were skipped
+    uint64_t getTicks() const { return nextTick; }
+    uint64_t getMissedTicks() const { return missedTicks; }
+
+    Clock::time_point deadline(uint64_t tick) const {
+        // double keeps ns precision for ~100 days of ticks at 1000 fps
+        return epoch + std::chrono::nanoseconds((int64_t)((double)tick * 1e9 / fps));
     }
 
 private:
-    double target_time;
-    std::chrono::high_resolution_clock::time_point last_time;
+    uint64_t tickAt(Clock::time_point t) const {
+        double sinceEpoch = std::chrono::duration<double>(t - epoch).count();
+        return sinceEpoch > 0.0 ? (uint64_t)(sinceEpoch * fps) : 0;
+    }
+
+    double fps;
+    std::chrono::microseconds spinWindow;
+    Clock::time_point epoch;
+    uint64_t nextTick;
+    uint64_t missedTicks;
 };
 
 #endif // TIMING_H
\ No newline at end of file
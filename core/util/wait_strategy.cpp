@@ -0,0 +1,73 @@
+#include "wait_strategy.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#pragma comment(lib, "synchronization.lib")
+#elif defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <climits>
+#include <ctime>
+#else
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+#endif
+
+#if defined(_WIN32)
+
+void addressWait(std::atomic<uint32_t>* addr, uint32_t expected, std::chrono::microseconds timeout) {
+    // round up so a sub-millisecond remainder still sleeps instead of spinning
+    DWORD ms = (DWORD)((timeout.count() + 999) / 1000);
+    WaitOnAddress((volatile VOID*)addr, &expected, sizeof(uint32_t), ms);
+}
+
+void addressWakeAll(std::atomic<uint32_t>* addr) {
+    WakeByAddressAll((PVOID)addr);
+}
+
+#elif defined(__linux__)
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex needs a plain 32-bit word");
+
+void addressWait(std::atomic<uint32_t>* addr, uint32_t expected, std::chrono::microseconds timeout) {
+    struct timespec ts;
+    ts.tv_sec = (time_t)(timeout.count() / 1000000);
+    ts.tv_nsec = (long)((timeout.count() % 1000000) * 1000);
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAIT_PRIVATE, expected, &ts, nullptr, 0);
+}
+
+void addressWakeAll(std::atomic<uint32_t>* addr) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+}
+
+#else
+
+// Portable fallback: a small table of condition variables keyed by address
+namespace {
+struct WaitBucket {
+    std::mutex mutex;
+    std::condition_variable cv;
+};
+WaitBucket waitBuckets[16];
+
+WaitBucket& bucketFor(const void* addr) {
+    return waitBuckets[(reinterpret_cast<uintptr_t>(addr) >> 4) & 15];
+}
+}
+
+void addressWait(std::atomic<uint32_t>* addr, uint32_t expected, std::chrono::microseconds timeout) {
+    WaitBucket& b = bucketFor(addr);
+    std::unique_lock<std::mutex> lock(b.mutex);
+    if (addr->load(std::memory_order_acquire) != expected) return;
+    b.cv.wait_for(lock, timeout);
+}
+
+void addressWakeAll(std::atomic<uint32_t>* addr) {
+    WaitBucket& b = bucketFor(addr);
+    { std::lock_guard<std::mutex> lock(b.mutex); }
+    b.cv.notify_all();
+}
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef WAIT_STRATEGY_H
+#define WAIT_STRATEGY_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+using WaitClock = std::chrono::steady_clock;
+
+// Block while *addr == expected, for at most timeout (futex on Linux, WaitOnAddress on
+// Windows, condition variable elsewhere). May return early or spuriously; callers re-check.
+void addressWait(std::atomic<uint32_t>* addr, uint32_t expected, std::chrono::microseconds timeout);
+void addressWakeAll(std::atomic<uint32_t>* addr);
+
+inline void cpuRelax() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_pause();
+#elif defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#else
+    std::this_thread::yield();
+#endif
+}
+
+// Wait strategies for SPSC_Ring. A strategy is used once per direction (not-empty and
+// not-full): waiters call wait(ready, deadline), the other side calls notify() after
+// every push/pop. notify() must stay cheap when nobody is waiting.
+
+// Busy-waits briefly, then yields, then naps in short sleeps. Lowest wake-up latency,
+// but a waiting thread keeps a core busy; meant for benchmarking and dedicated cores.
+class SpinYieldWait {
+public:
+    template<typename Pred>
+    bool wait(Pred ready, WaitClock::time_point deadline) {
+        for (int i = 0; ; ++i) {
+            if (ready()) return true;
+            if (i < 256) {
+                cpuRelax();
+            } else if (i < 1024) {
+                std::this_thread::yield();
+            } else {
+                if (WaitClock::now() >= deadline) return false;
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        }
+    }
+
+    void notify() {}
+};
+
+// Eventcount over a 32-bit epoch: waiters register, re-check the condition and sleep on
+// the epoch in the kernel; notify() only bumps the epoch and issues a wake syscall when
+// someone is registered. Idle threads sleep until work arrives instead of polling.
+class BlockingWait {
+public:
+    BlockingWait() : epoch(0), waiters(0) {}
+
+    template<typename Pred>
+    bool wait(Pred ready, WaitClock::time_point deadline) {
+        // brief spin first: stage handoffs often complete within microseconds
+        for (int i = 0; i < 64; ++i) {
+            if (ready()) return true;
+            cpuRelax();
+        }
+        for (;;) {
+            uint32_t key = epoch.load(std::memory_order_acquire);
+            waiters.fetch_add(1, std::memory_order_seq_cst);
+            // pairs with the fence in notify(): either we see the new item or it sees us
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (ready()) {
+                waiters.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+            auto now = WaitClock::now();
+            if (now >= deadline) {
+                waiters.fetch_sub(1, std::memory_order_relaxed);
+                return false;
+            }
+            addressWait(&epoch, key, std::chrono::duration_cast<std::chrono::microseconds>(deadline - now) + std::chrono::microseconds(1));
+            waiters.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    void notify() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed) != 0) {
+            epoch.fetch_add(1, std::memory_order_release);
+            addressWakeAll(&epoch);
+        }
+    }
+
+private:
+    std::atomic<uint32_t> epoch;
+    std::atomic<uint32_t> waiters;
+};
+
+#endif // WAIT_STRATEGY_H